@@ -0,0 +1,143 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "bench_utils.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<std::size_t> allocs{0};
+
+std::atomic<std::size_t> bytes{0};
+
+void* allocate(std::size_t size) {
+    allocs.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    auto *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+void* allocate(std::size_t size, std::align_val_t align) {
+    allocs.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+
+    auto alignment = static_cast<std::size_t>(align);
+    // aligned_alloc requires the size to be a multiple of the alignment.
+    auto aligned_size = (size + alignment - 1) / alignment * alignment;
+    auto *ptr = std::aligned_alloc(alignment, aligned_size == 0 ? alignment : aligned_size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    return allocate(size, align);
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return allocate(size, align);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+namespace sw::gossip::bench {
+
+std::size_t alloc_count() {
+    return allocs.load(std::memory_order_relaxed);
+}
+
+std::size_t alloc_bytes() {
+    return bytes.load(std::memory_order_relaxed);
+}
+
+Node make_node(std::size_t idx, uint64_t version, NodeStatus status) {
+    char id[NodeId::MAX_SIZE + 1];
+    std::snprintf(id, sizeof(id), "%08zx-0000-4000-8000-%012zx", idx, idx * 2654435761U);
+
+    char ip[IpAddress::MAX_STR_SIZE + 1];
+    std::snprintf(ip, sizeof(ip), "10.%zu.%zu.%zu", (idx >> 16) & 0xff, (idx >> 8) & 0xff, idx & 0xff);
+
+    Node node;
+    node.id.assign(id);
+    node.ip.assign(ip);
+    node.port = static_cast<uint16_t>(7000 + idx % 1000);
+    node.version = version;
+    node.status = status;
+
+    return node;
+}
+
+std::vector<Node> make_nodes(std::size_t num) {
+    std::vector<Node> nodes;
+    nodes.reserve(num);
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        nodes.push_back(make_node(idx));
+    }
+
+    return nodes;
+}
+
+}
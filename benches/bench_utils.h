@@ -0,0 +1,70 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_BENCH_UTILS_H
+#define SW_GOSSIP_NET_BENCH_UTILS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/utils.h>
+
+namespace sw::gossip::bench {
+
+// Number of heap allocations, and allocated bytes, since the process starts.
+// They're counted by the replaced global operator new.
+std::size_t alloc_count();
+
+std::size_t alloc_bytes();
+
+// Report heap allocations per iteration of the benchmark loop run in its scope.
+class AllocScope {
+public:
+    explicit AllocScope(benchmark::State &state) :
+        _state(state), _count(alloc_count()), _bytes(alloc_bytes()) {}
+
+    AllocScope(const AllocScope &) = delete;
+    AllocScope& operator=(const AllocScope &) = delete;
+
+    ~AllocScope() {
+        _state.counters["allocs/op"] = benchmark::Counter(
+                static_cast<double>(alloc_count() - _count),
+                benchmark::Counter::kAvgIterations);
+        _state.counters["alloc_bytes/op"] = benchmark::Counter(
+                static_cast<double>(alloc_bytes() - _bytes),
+                benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &_state;
+
+    std::size_t _count;
+
+    std::size_t _bytes;
+};
+
+// A node with an UUID-sized id, and a unique address, as in a real cluster.
+Node make_node(std::size_t idx, uint64_t version = 0, NodeStatus status = NodeStatus::ALIVE);
+
+std::vector<Node> make_nodes(std::size_t num);
+
+}
+
+// Cluster sizes from 10 to 100k members.
+#define SW_GOSSIP_BENCH_CLUSTER_SIZES RangeMultiplier(10)->Range(10, 100000)
+
+#endif // end SW_GOSSIP_NET_BENCH_UTILS_H
@@ -0,0 +1,70 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <string>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/binary_codec.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+void BM_BinaryEncoder_ping(benchmark::State &state) {
+    auto rumor_num = static_cast<std::size_t>(state.range(0));
+    auto nodes = bench::make_nodes(rumor_num + 1);
+    std::string buf(64 * 1024, '\0');
+    std::size_t size = 0;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        BinaryEncoder encoder(buf.data(), buf.size());
+        encoder.append_header(MessageType::PING).append_node(nodes[0]);
+        encoder.append_varint(rumor_num);
+        for (std::size_t idx = 1; idx != nodes.size(); ++idx) {
+            encoder.append_node(nodes[idx]);
+        }
+
+        size = encoder.size();
+        benchmark::DoNotOptimize(size);
+    }
+
+    state.counters["msg_bytes"] = static_cast<double>(size);
+}
+BENCHMARK(BM_BinaryEncoder_ping)->Arg(1)->Arg(5)->Arg(20)->Arg(60);
+
+void BM_binary_decode_ping(benchmark::State &state) {
+    auto rumor_num = static_cast<std::size_t>(state.range(0));
+    auto nodes = bench::make_nodes(rumor_num + 1);
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::PING).append_node(nodes[0]);
+    encoder.append_varint(rumor_num);
+    for (std::size_t idx = 1; idx != nodes.size(); ++idx) {
+        encoder.append_node(nodes[idx]);
+    }
+    auto msg = encoder.data();
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto decoded = binary::decode(msg);
+        benchmark::DoNotOptimize(decoded.rumors.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * msg.size());
+}
+BENCHMARK(BM_binary_decode_ping)->Arg(1)->Arg(5)->Arg(20)->Arg(60);
+
+}
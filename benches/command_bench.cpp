@@ -0,0 +1,104 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <memory>
+#include <string>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/command.h>
+#include <sw/gossip-net/gossip_net.h>
+#include <sw/gossip-net/resp.h>
+#include <sw/gossip-net/udp_server.h>
+#include "bench_utils.h"
+
+namespace sw::gossip {
+
+// A command doing nothing, so that only the dispatch is measured.
+class NoopCommand final : public Command {
+public:
+    NoopCommand(const std::string &name, GossipNet &net) : Command(name, net) {}
+
+private:
+    virtual void _run(const RespRequest::Args &args, GossipNet &) override {
+        benchmark::DoNotOptimize(args.size());
+    }
+};
+
+// Dispatch requests with an unstarted instance, i.e. without network I/O.
+class UdpServerAccess {
+public:
+    UdpServerAccess() : _net(net_options()), _server(server_options()) {
+        // "ping" takes the slot of the built-in command, and the others are extensions.
+        _server.register_command(std::make_unique<NoopCommand>("ping", _net));
+        _server.register_command(std::make_unique<NoopCommand>("ext", _net));
+        _server.register_command(std::make_unique<NoopCommand>("ext-other", _net));
+    }
+
+    // Look up the command and run it, as UdpServer does for each parsed request.
+    void dispatch(const RespRequest &request) {
+        auto *command = _server._command(request.name);
+        command->run(request.args);
+    }
+
+private:
+    static GossipNetOptions net_options() {
+        GossipNetOptions opts;
+        opts.server_options = server_options();
+        opts.lambda = 3;
+        opts.max_rumor_num = 20;
+
+        return opts;
+    }
+
+    static UdpServerOptions server_options() {
+        UdpServerOptions opts;
+        opts.ip = "127.0.0.1";
+        opts.port = 0;
+        opts.buffer_size = 1472;
+
+        return opts;
+    }
+
+    // Commands are bound to a GossipNet, which noop commands never use.
+    GossipNet _net;
+
+    UdpServer _server;
+};
+
+}
+
+namespace {
+
+using namespace sw::gossip;
+
+// Dispatch a parsed request by name, i.e. from Command lookup to Command::run.
+void BM_UdpServer_dispatch(benchmark::State &state, const char *name) {
+    UdpServerAccess server;
+
+    RespReplyBuilder builder;
+    builder.append_array(1).append_bulk_string(name);
+    auto msg = builder.data();
+    RespRequestParser parser;
+    auto request = parser.parse(msg).first.front();
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        server.dispatch(request);
+    }
+}
+BENCHMARK_CAPTURE(BM_UdpServer_dispatch, builtin, "ping");
+BENCHMARK_CAPTURE(BM_UdpServer_dispatch, extension, "ext");
+
+}
@@ -0,0 +1,77 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <string>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/compression.h>
+#include <sw/gossip-net/resp.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+// Full state encoded as push-pull does.
+std::string make_state(std::size_t num) {
+    RespReplyBuilder builder;
+    builder.append_array(1 + num * 6);
+    builder.append_bulk_string("push-pull");
+    for (const auto &node : bench::make_nodes(num)) {
+        builder.append_node("rumor", node);
+    }
+
+    return builder.data();
+}
+
+void BM_lz_compress(benchmark::State &state) {
+    auto src = make_state(static_cast<std::size_t>(state.range(0)));
+    std::string dst(lz::max_compressed_size(src.size()), '\0');
+    std::size_t size = 0;
+
+    for (auto _ : state) {
+        size = lz::compress(src, dst.data(), dst.size());
+        benchmark::DoNotOptimize(size);
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+    state.counters["state_bytes"] = static_cast<double>(src.size());
+    state.counters["ratio"] = size == 0 ? 1.0 : static_cast<double>(size) / src.size();
+}
+BENCHMARK(BM_lz_compress)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+void BM_lz_decompress(benchmark::State &state) {
+    auto src = make_state(static_cast<std::size_t>(state.range(0)));
+    std::string compressed(lz::max_compressed_size(src.size()), '\0');
+    compressed.resize(lz::compress(src, compressed.data(), compressed.size()));
+    if (compressed.empty()) {
+        state.SkipWithError("state is not compressible");
+        return;
+    }
+
+    std::string out;
+    out.reserve(src.size());
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        lz::decompress(compressed, out, src.size());
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK(BM_lz_decompress)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+}
@@ -0,0 +1,226 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/gossip_net.h>
+#include "bench_utils.h"
+
+namespace sw::gossip {
+
+// Build rumors with an unstarted instance, i.e. without network I/O.
+class GossipNetAccess {
+public:
+    explicit GossipNetAccess(std::size_t member_num) : _net(options()) {
+        auto nodes = bench::make_nodes(member_num + 2);
+        _net._self = nodes[0];
+        _dest = nodes[1];
+        for (std::size_t idx = 1; idx != nodes.size(); ++idx) {
+            _net._members.add(nodes[idx]);
+        }
+    }
+
+    std::vector<Node> build_rumors() {
+        return _net._build_rumors(_dest, MessageType::PING, _net._self, nullptr);
+    }
+
+private:
+    static GossipNetOptions options() {
+        GossipNetOptions opts;
+        opts.server_options.ip = "127.0.0.1";
+        opts.server_options.port = 0;
+        opts.server_options.buffer_size = 1472;
+        opts.lambda = 3;
+        opts.max_rumor_num = 20;
+
+        return opts;
+    }
+
+    GossipNet _net;
+
+    Node _dest;
+};
+
+}
+
+namespace {
+
+using namespace sw::gossip;
+
+// Instances are cached across runs, since each of them binds sockets.
+GossipNetAccess& instance(std::size_t member_num) {
+    static std::map<std::size_t, std::unique_ptr<GossipNetAccess>> instances;
+    auto &net = instances[member_num];
+    if (!net) {
+        net = std::make_unique<GossipNetAccess>(member_num);
+    }
+
+    return *net;
+}
+
+void BM_GossipNet_build_rumors(benchmark::State &state) {
+    auto &net = instance(state.range(0));
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto rumors = net.build_rumors();
+        benchmark::DoNotOptimize(rumors.data());
+    }
+}
+BENCHMARK(BM_GossipNet_build_rumors)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+constexpr int PORT = 47600;
+
+// Number of sockets sending pings. Each of them has its own source port, so that
+// SO_REUSEPORT spreads them among shards.
+constexpr std::size_t SENDER_NUM = 8;
+
+// Pings sent by each sender with a single sendmmsg call. All bursts in flight fit
+// into the receive buffer of a single shard.
+constexpr std::size_t BURST_SIZE = 16;
+
+// Send binary pings on behalf of a member, whose address is the socket itself.
+class PingSender {
+public:
+    explicit PingSender(std::size_t idx) {
+        _fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+
+        socklen_t len = sizeof(addr);
+        ::getsockname(_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+
+        Node self;
+        self.id.assign("sender-" + std::to_string(idx));
+        self.ip.assign("127.0.0.1");
+        self.port = ntohs(addr.sin_port);
+
+        BinaryEncoder encoder;
+        encoder.append_header(MessageType::PING).append_node(self).append_varint(0);
+        _payload = encoder.data();
+
+        _addr.sin_family = AF_INET;
+        _addr.sin_port = htons(PORT);
+        _addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        _iov = {_payload.data(), _payload.size()};
+        _msgs.resize(BURST_SIZE);
+        for (auto &msg : _msgs) {
+            msg.msg_hdr.msg_name = &_addr;
+            msg.msg_hdr.msg_namelen = sizeof(_addr);
+            msg.msg_hdr.msg_iov = &_iov;
+            msg.msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    PingSender(const PingSender &) = delete;
+    PingSender& operator=(const PingSender &) = delete;
+
+    ~PingSender() {
+        ::close(_fd);
+    }
+
+    // @return number of pings sent.
+    std::size_t send_burst() {
+        auto num = ::sendmmsg(_fd, _msgs.data(), _msgs.size(), 0);
+        return num > 0 ? num : 0;
+    }
+
+private:
+    int _fd = -1;
+
+    sockaddr_in _addr{};
+
+    std::string _payload;
+
+    iovec _iov{};
+
+    std::vector<mmsghdr> _msgs;
+};
+
+// Pings per second handled with the given number of shards, i.e. decoded by the
+// receiving shard, handed to the owner shard, and acked. Acks are never read, and
+// dropped by the kernel once sender buffers are full.
+void BM_GossipNet_recv_pings(benchmark::State &state) {
+    GossipNetOptions opts;
+    opts.id = "receiver";
+    opts.server_options.ip = "127.0.0.1";
+    opts.server_options.port = PORT;
+    opts.server_options.buffer_size = 64 * 1024;
+    opts.lambda = 3;
+    opts.max_rumor_num = 20;
+    opts.protocol_period = std::chrono::seconds(3600);
+    opts.push_pull_options.interval = std::chrono::milliseconds(0);
+    opts.shard_num = state.range(0);
+
+    GossipNet net(opts);
+    net.start();
+
+    std::vector<std::unique_ptr<PingSender>> senders;
+    for (std::size_t idx = 0; idx != SENDER_NUM; ++idx) {
+        senders.push_back(std::make_unique<PingSender>(idx));
+    }
+
+    auto acked = [&net]() { return net.stats().messages; };
+    auto base = acked();
+    auto allocs = bench::alloc_count();
+    std::size_t sent = 0;
+    std::size_t lost = 0;
+    for (auto _ : state) {
+        for (auto &sender : senders) {
+            sent += sender->send_burst();
+        }
+
+        // Wait for all pings in flight. If no progress is made for a while,
+        // the rest are lost, e.g. the receive buffer overflows.
+        auto last = acked();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        while (last - base < sent - lost) {
+            std::this_thread::yield();
+            auto cur = acked();
+            if (cur != last) {
+                last = cur;
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            } else if (std::chrono::steady_clock::now() > deadline) {
+                lost = sent - (last - base);
+            }
+        }
+    }
+
+    // Allocations of all shards, since pings are handled in other threads.
+    auto handled = sent - lost;
+    state.counters["allocs/ping"] = handled == 0 ? 0.0 :
+        static_cast<double>(bench::alloc_count() - allocs) / handled;
+
+    net.stop();
+
+    state.SetItemsProcessed(static_cast<int64_t>(handled));
+    state.counters["lost"] = static_cast<double>(lost);
+}
+BENCHMARK(BM_GossipNet_recv_pings)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+}
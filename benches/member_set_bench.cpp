@@ -0,0 +1,125 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <cmath>
+#include <optional>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/member_set.h>
+#include <sw/gossip-net/recently_updated_set.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr std::size_t FETCH_NUM = 6;
+
+std::size_t node_size(const Node &) {
+    return 64;
+}
+
+void BM_MemberSet_try_update(benchmark::State &state) {
+    auto nodes = bench::make_nodes(state.range(0));
+    MemberSet members;
+    for (const auto &node : nodes) {
+        members.add(node);
+    }
+
+    std::size_t idx = 0;
+    uint64_t version = 1;
+    std::optional<NodeStatus> prev;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto node = nodes[idx];
+        node.version = version;
+        benchmark::DoNotOptimize(members.try_update(node, prev));
+
+        if (++idx == nodes.size()) {
+            idx = 0;
+            ++version;
+        }
+    }
+}
+BENCHMARK(BM_MemberSet_try_update)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+void BM_MemberSet_fetch(benchmark::State &state) {
+    MemberSet members;
+    for (const auto &node : bench::make_nodes(state.range(0))) {
+        members.add(node);
+    }
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        std::size_t budget = 1400;
+        auto nodes = members.fetch(FETCH_NUM, budget, node_size);
+        benchmark::DoNotOptimize(nodes.data());
+    }
+}
+BENCHMARK(BM_MemberSet_fetch)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+void BM_RecentlyUpdatedSet_add(benchmark::State &state) {
+    auto nodes = bench::make_nodes(state.range(0));
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    for (const auto &node : nodes) {
+        recent.add(node, prev);
+    }
+
+    std::size_t idx = 0;
+    uint64_t version = 1;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto node = nodes[idx];
+        node.version = version;
+        benchmark::DoNotOptimize(recent.add(node, prev));
+
+        if (++idx == nodes.size()) {
+            idx = 0;
+            ++version;
+        }
+    }
+}
+BENCHMARK(BM_RecentlyUpdatedSet_add)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+void BM_RecentlyUpdatedSet_fetch(benchmark::State &state) {
+    auto member_num = static_cast<std::size_t>(state.range(0));
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    for (const auto &node : bench::make_nodes(member_num)) {
+        recent.add(node, prev);
+    }
+
+    // The same limit as GossipNet with lambda 3.
+    auto max_spreaded_num = static_cast<std::size_t>(3 * std::log(member_num)) + 1;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        std::size_t budget = 1400;
+        auto [rumors, stable, reaped] = recent.fetch(FETCH_NUM, max_spreaded_num, budget, node_size);
+        benchmark::DoNotOptimize(rumors.data());
+
+        // Keep the set size unchanged with new updates of the stable members.
+        for (auto &node : stable) {
+            ++node.version;
+            recent.add(node, prev);
+        }
+    }
+}
+BENCHMARK(BM_RecentlyUpdatedSet_fetch)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+}
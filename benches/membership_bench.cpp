@@ -0,0 +1,65 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/membership.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr std::size_t MEMBER_NUM = 1000;
+
+MembershipPublisher& publisher() {
+    static auto &publisher = []() -> MembershipPublisher& {
+        static MembershipPublisher pub;
+        pub.publish(bench::make_nodes(MEMBER_NUM));
+        return pub;
+    }();
+
+    return publisher;
+}
+
+// Every thread looks up a member in the latest snapshot, as application threads do
+// with GossipNet::membership().
+void BM_MembershipPublisher_snapshot(benchmark::State &state) {
+    auto &pub = publisher();
+    auto node = bench::make_node(state.thread_index() % MEMBER_NUM);
+
+    for (auto _ : state) {
+        auto snapshot = pub.snapshot();
+        benchmark::DoNotOptimize(snapshot->find(node.id));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MembershipPublisher_snapshot)->ThreadRange(1, 32)->UseRealTime();
+
+// Same as above, with a per-thread MembershipReader.
+void BM_MembershipReader_acquire(benchmark::State &state) {
+    MembershipReader reader(publisher());
+    auto node = bench::make_node(state.thread_index() % MEMBER_NUM);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(reader.acquire().find(node.id));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MembershipReader_acquire)->ThreadRange(1, 32)->UseRealTime();
+
+}
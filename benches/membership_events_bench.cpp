@@ -0,0 +1,46 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <thread>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/membership_events.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+// Time from flush() until the batch is delivered to the listener, when events are
+// rare, i.e. the consumer is idle.
+void BM_MembershipEventStream_latency(benchmark::State &state) {
+    MembershipEventStream stream(1024);
+    stream.subscribe([](const std::vector<MembershipEvent> &) {});
+    auto node = bench::make_node(0);
+
+    std::size_t delivered = 0;
+    for (auto _ : state) {
+        stream.add(MembershipEventType::JOIN, node);
+        stream.flush();
+
+        ++delivered;
+        while (stream.delivered() != delivered) {
+            std::this_thread::yield();
+        }
+    }
+}
+BENCHMARK(BM_MembershipEventStream_latency)->UseRealTime();
+
+}
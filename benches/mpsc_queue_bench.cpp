@@ -0,0 +1,75 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/mpsc_queue.h>
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr std::size_t ITEMS_PER_ITERATION = 64 * 1024;
+
+// N producers push to a queue with the UdpServer default capacity, while the
+// consumer drains it, as the event loop drains the send queue.
+void BM_MpscQueue_contention(benchmark::State &state) {
+    auto producer_num = static_cast<std::size_t>(state.range(0));
+    auto items_per_producer = ITEMS_PER_ITERATION / producer_num;
+    auto total = items_per_producer * producer_num;
+
+    MpscQueue<uint64_t> queue(4096);
+    std::size_t empty = 0;
+
+    for (auto _ : state) {
+        std::vector<std::thread> producers;
+        producers.reserve(producer_num);
+        for (std::size_t idx = 0; idx != producer_num; ++idx) {
+            producers.emplace_back([&queue, items_per_producer]() {
+                        for (uint64_t item = 0; item != items_per_producer; ++item) {
+                            auto val = item;
+                            while (!queue.try_push(val)) {
+                                std::this_thread::yield();
+                            }
+                        }
+                    });
+        }
+
+        uint64_t item = 0;
+        for (std::size_t popped = 0; popped != total; ) {
+            if (queue.try_pop(item)) {
+                ++popped;
+            } else {
+                ++empty;
+                std::this_thread::yield();
+            }
+        }
+        benchmark::DoNotOptimize(item);
+
+        for (auto &producer : producers) {
+            producer.join();
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * total);
+    state.counters["empty_polls"] = benchmark::Counter(static_cast<double>(empty),
+            benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_MpscQueue_contention)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+}
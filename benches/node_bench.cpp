@@ -0,0 +1,80 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <unordered_map>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/utils.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr std::size_t MEMBER_NUM = 100000;
+
+const std::vector<Node>& cached_nodes() {
+    static auto nodes = bench::make_nodes(MEMBER_NUM);
+
+    return nodes;
+}
+
+// Heap bytes per member.
+void BM_Node_footprint(benchmark::State &state) {
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        auto before = bench::alloc_bytes();
+        auto nodes = bench::make_nodes(MEMBER_NUM);
+        bytes = bench::alloc_bytes() - before;
+        benchmark::DoNotOptimize(nodes.data());
+    }
+
+    state.counters["bytes/member"] = static_cast<double>(bytes) / MEMBER_NUM;
+}
+BENCHMARK(BM_Node_footprint)->Iterations(1);
+
+void BM_Node_copy(benchmark::State &state) {
+    const auto &nodes = cached_nodes();
+    std::vector<Node> copy(nodes.size());
+
+    for (auto _ : state) {
+        copy.assign(nodes.begin(), nodes.end());
+        benchmark::DoNotOptimize(copy.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * nodes.size());
+}
+BENCHMARK(BM_Node_copy);
+
+void BM_NodeId_lookup(benchmark::State &state) {
+    const auto &nodes = cached_nodes();
+    std::unordered_map<NodeId, std::size_t> index;
+    for (std::size_t idx = 0; idx != nodes.size(); ++idx) {
+        index.emplace(nodes[idx].id, idx);
+    }
+
+    std::size_t idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(nodes[idx].id));
+        if (++idx == nodes.size()) {
+            idx = 0;
+        }
+    }
+}
+BENCHMARK(BM_NodeId_lookup);
+
+}
@@ -0,0 +1,101 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <memory>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/pending_lists.h>
+#include <sw/gossip-net/task.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+class NopTask : public Task {
+public:
+    explicit NopTask(const NodeId &id) : Task(id) {}
+
+    virtual void on_ack() override {}
+
+    virtual void on_timeout() override {}
+};
+
+std::vector<NodeId> make_ids(std::size_t num) {
+    std::vector<NodeId> ids;
+    ids.reserve(num);
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        ids.push_back(bench::make_node(idx).id);
+    }
+
+    return ids;
+}
+
+// A task is pending for each member, and the one acked is replaced with a new task.
+void BM_PendingLists_add_fetch(benchmark::State &state) {
+    auto ids = make_ids(state.range(0));
+    PendingLists lists;
+    for (const auto &id : ids) {
+        lists.add(std::make_unique<NopTask>(id), TimerHandle{});
+    }
+
+    std::size_t idx = 0;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        const auto &id = ids[idx];
+        auto items = lists.fetch(id);
+        benchmark::DoNotOptimize(items.data());
+        lists.add(std::make_unique<NopTask>(id), TimerHandle{});
+
+        if (++idx == ids.size()) {
+            idx = 0;
+        }
+    }
+}
+BENCHMARK(BM_PendingLists_add_fetch)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+// A task is pending for each member, and the one timed out is replaced with a new task.
+void BM_PendingLists_add_timeout(benchmark::State &state) {
+    auto ids = make_ids(state.range(0));
+    PendingLists lists;
+    std::vector<Task*> tasks;
+    tasks.reserve(ids.size());
+    for (const auto &id : ids) {
+        auto task = std::make_unique<NopTask>(id);
+        tasks.push_back(task.get());
+        lists.add(std::move(task), TimerHandle{});
+    }
+
+    std::size_t idx = 0;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto timed_out = lists.remove(*tasks[idx]);
+        benchmark::DoNotOptimize(timed_out.get());
+
+        auto task = std::make_unique<NopTask>(ids[idx]);
+        tasks[idx] = task.get();
+        lists.add(std::move(task), TimerHandle{});
+
+        if (++idx == ids.size()) {
+            idx = 0;
+        }
+    }
+}
+BENCHMARK(BM_PendingLists_add_timeout)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+}
@@ -0,0 +1,85 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/gossip_net.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr int SEED_PORT = 47400;
+
+// Probing and periodic push-pull are effectively disabled, so that only the join is measured.
+GossipNetOptions options(const std::string &id, int port) {
+    GossipNetOptions opts;
+    opts.id = id;
+    opts.server_options.ip = "127.0.0.1";
+    opts.server_options.port = port;
+    opts.server_options.buffer_size = 64 * 1024;
+    opts.server_options.timer_tick = std::chrono::milliseconds(1);
+    opts.lambda = 3;
+    opts.max_rumor_num = 20;
+    opts.protocol_period = std::chrono::seconds(3600);
+    opts.snapshot_interval = std::chrono::milliseconds(10);
+    opts.push_pull_options.interval = std::chrono::milliseconds(0);
+
+    return opts;
+}
+
+void wait_for_size(const GossipNet &net, std::size_t size) {
+    while (net.membership()->size() != size) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+// Time from join until the membership snapshot of the new node has all members of
+// the seed, i.e. a push-pull exchange, merging in batches and publishing a snapshot.
+void BM_PushPull_time_to_full_view(benchmark::State &state) {
+    auto num = static_cast<std::size_t>(state.range(0));
+
+    GossipNet seed(options("seed", SEED_PORT));
+    seed.start();
+    seed.dispatch([&seed, nodes = bench::make_nodes(num)]() mutable {
+                seed.update(std::move(nodes));
+            });
+    wait_for_size(seed, num + 1);
+
+    for (auto _ : state) {
+        GossipNet net(options("joiner", SEED_PORT + 1));
+        net.start();
+
+        auto start = std::chrono::steady_clock::now();
+        net.join("127.0.0.1", SEED_PORT);
+        wait_for_size(net, num + 2);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        state.SetIterationTime(std::chrono::duration<double>(elapsed).count());
+    }
+
+    state.counters["members/s"] = benchmark::Counter(static_cast<double>(num),
+            benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_PushPull_time_to_full_view)
+    ->SW_GOSSIP_BENCH_CLUSTER_SIZES
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+}
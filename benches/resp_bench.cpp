@@ -0,0 +1,112 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <string>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/resp.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+// A ping with the given number of rumors, encoded as GossipNet sends it.
+std::string make_ping(std::size_t rumor_num) {
+    auto nodes = bench::make_nodes(rumor_num + 1);
+
+    RespReplyBuilder builder;
+    builder.append_array(1 + 5 + rumor_num * 6);
+    builder.append_bulk_string("ping");
+    builder.append_node("self", nodes[0], false);
+    for (std::size_t idx = 1; idx != nodes.size(); ++idx) {
+        builder.append_node("rumor", nodes[idx]);
+    }
+
+    return builder.data();
+}
+
+void BM_RespRequestParser_parse(benchmark::State &state) {
+    auto msg = make_ping(state.range(0));
+    RespRequestParser parser;
+    // Warm up the arena, as the parser of a running server.
+    parser.parse(msg);
+
+    {
+        bench::AllocScope allocs(state);
+        for (auto _ : state) {
+            auto [requests, len] = parser.parse(msg);
+            benchmark::DoNotOptimize(requests.size());
+            benchmark::DoNotOptimize(len);
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * msg.size());
+    state.counters["msg_bytes"] = static_cast<double>(msg.size());
+}
+BENCHMARK(BM_RespRequestParser_parse)->Arg(1)->Arg(5)->Arg(20)->Arg(60);
+
+void BM_RespReplyBuilder_ping(benchmark::State &state) {
+    auto rumor_num = static_cast<std::size_t>(state.range(0));
+    auto nodes = bench::make_nodes(rumor_num + 1);
+    std::string buf(64 * 1024, '\0');
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        RespReplyBuilder builder(buf.data(), buf.size());
+        builder.append_array(1 + 5 + rumor_num * 6);
+        builder.append_bulk_string("ping");
+        builder.append_node("self", nodes[0], false);
+        for (std::size_t idx = 1; idx != nodes.size(); ++idx) {
+            builder.append_node("rumor", nodes[idx]);
+        }
+
+        benchmark::DoNotOptimize(builder.size());
+    }
+}
+BENCHMARK(BM_RespReplyBuilder_ping)->Arg(1)->Arg(5)->Arg(20)->Arg(60);
+
+void BM_parse_node(benchmark::State &state) {
+    auto msg = make_ping(0);
+    RespRequestParser parser;
+    auto args = parser.parse(msg).first.front().args;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto [node, last] = utils::parse_node("self", args.begin(), args.end());
+        benchmark::DoNotOptimize(node);
+        benchmark::DoNotOptimize(last);
+    }
+}
+BENCHMARK(BM_parse_node);
+
+void BM_parse_rumors(benchmark::State &state) {
+    auto msg = make_ping(state.range(0));
+    RespRequestParser parser;
+    auto args = parser.parse(msg).first.front().args;
+    // Skip the self node.
+    auto *first = args.begin() + 5;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto rumors = utils::parse_rumors(first, args.end());
+        benchmark::DoNotOptimize(rumors.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_parse_rumors)->Arg(1)->Arg(5)->Arg(20)->Arg(60);
+
+}
@@ -0,0 +1,98 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <random>
+#include <string>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/rumor_dict.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr std::size_t MEMBER_NUM = 10000;
+
+constexpr std::size_t RUMOR_NUM = 20;
+
+// Gossip rumors about 10k members, picked in round robin, to a peer that acks each
+// message, and compare the message size with plain binary encoding. Messages and
+// acks are lost with the given percentage.
+// Args: dictionary capacity, loss percentage.
+void BM_RumorDictionary_bandwidth(benchmark::State &state) {
+    auto capacity = static_cast<std::size_t>(state.range(0));
+    auto loss = static_cast<unsigned>(state.range(1));
+
+    auto nodes = bench::make_nodes(MEMBER_NUM);
+    const auto self = nodes[0];
+    RumorDictionary local(capacity, 1);
+    RumorDictionary remote(capacity, 2);
+    std::mt19937 rng(1);
+    std::string buf(64 * 1024, '\0');
+
+    std::size_t cursor = 0;
+    std::size_t dict_bytes = 0;
+    std::size_t plain_bytes = 0;
+    std::size_t refs = 0;
+    std::size_t misses = 0;
+
+    for (auto _ : state) {
+        BinaryEncoder encoder(buf.data(), buf.size());
+        encoder.append_header(MessageType::PING, local.begin_message()).append_node(self);
+        encoder.append_varint(RUMOR_NUM);
+        plain_bytes += 3 + binary::node_size(self) + binary::varint_size(RUMOR_NUM);
+        for (std::size_t idx = 0; idx != RUMOR_NUM; ++idx) {
+            auto &node = nodes[cursor];
+            cursor = (cursor + 1) % nodes.size();
+            ++node.version;
+
+            auto code = local.encode(node);
+            encoder.append_rumor(node, code);
+            plain_bytes += binary::node_size(node);
+            refs += (code.kind == RumorKind::REF);
+        }
+        dict_bytes += encoder.size();
+
+        if (rng() % 100 >= loss) {
+            auto msg = binary::decode(encoder.view());
+            auto fresh = remote.on_header(msg.dict_header);
+            for (std::size_t idx = 0; idx != msg.rumors.size(); ++idx) {
+                if (!fresh || !remote.decode(msg.rumors[idx], msg.codes[idx])) {
+                    ++misses;
+                }
+            }
+        }
+
+        auto ack = remote.begin_message();
+        if (rng() % 100 >= loss) {
+            local.on_header(ack);
+        }
+    }
+
+    auto iterations = static_cast<double>(state.iterations());
+    state.counters["bytes/msg"] = dict_bytes / iterations;
+    state.counters["plain_bytes/msg"] = plain_bytes / iterations;
+    state.counters["ref_ratio"] = refs / (iterations * RUMOR_NUM);
+    state.counters["misses"] = static_cast<double>(misses);
+}
+BENCHMARK(BM_RumorDictionary_bandwidth)
+    ->Args({10000, 0})
+    ->Args({10000, 10})
+    ->Args({1000, 0})
+    ->Iterations(20000);
+
+}
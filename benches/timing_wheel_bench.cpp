@@ -0,0 +1,65 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <functional>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/timing_wheel.h>
+#include "bench_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+using std::chrono::milliseconds;
+
+// With N outstanding timers, e.g. suspicion timers, schedule a ping timeout,
+// and cancel it as its ack arrives.
+void BM_TimingWheel_schedule_cancel(benchmark::State &state) {
+    TimingWheel wheel(milliseconds(10), 0);
+    for (int64_t idx = 0; idx != state.range(0); ++idx) {
+        wheel.schedule(milliseconds(5000 + idx % 1000), []() {});
+    }
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        auto handle = wheel.schedule(milliseconds(200), []() {});
+        benchmark::DoNotOptimize(wheel.cancel(handle));
+    }
+}
+BENCHMARK(BM_TimingWheel_schedule_cancel)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+// Advance a tick, on which a timer fires and is rescheduled, with N outstanding timers.
+void BM_TimingWheel_advance(benchmark::State &state) {
+    TimingWheel wheel(milliseconds(1), 0);
+    for (int64_t idx = 0; idx != state.range(0); ++idx) {
+        wheel.schedule(milliseconds(1000000 + idx), []() {});
+    }
+
+    std::function<void ()> callback;
+    callback = [&wheel, &callback]() {
+        wheel.schedule(milliseconds(1), callback);
+    };
+    wheel.schedule(milliseconds(1), callback);
+
+    uint64_t now = 0;
+
+    bench::AllocScope allocs(state);
+    for (auto _ : state) {
+        wheel.advance(++now);
+    }
+}
+BENCHMARK(BM_TimingWheel_advance)->SW_GOSSIP_BENCH_CLUSTER_SIZES;
+
+}
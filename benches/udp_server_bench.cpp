@@ -0,0 +1,127 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/udp_server.h>
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr int PORT = 47500;
+
+// Number of datagrams sent with a single sendmmsg call, which fits into the
+// default socket receive buffer.
+constexpr std::size_t BURST_SIZE = 64;
+
+// Size of a ping with a few rumors.
+constexpr std::size_t DATAGRAM_SIZE = 256;
+
+// Send bursts of datagrams with sendmmsg, so that the sender costs far less than
+// the receiver.
+class Sender {
+public:
+    Sender() {
+        _fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+        _addr.sin_family = AF_INET;
+        _addr.sin_port = htons(PORT);
+        _addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        _payload.assign(DATAGRAM_SIZE, 'x');
+        _payload[0] = static_cast<char>(binary::MAGIC);
+
+        _iov = {_payload.data(), _payload.size()};
+        _msgs.resize(BURST_SIZE);
+        for (auto &msg : _msgs) {
+            msg.msg_hdr.msg_name = &_addr;
+            msg.msg_hdr.msg_namelen = sizeof(_addr);
+            msg.msg_hdr.msg_iov = &_iov;
+            msg.msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    Sender(const Sender &) = delete;
+    Sender& operator=(const Sender &) = delete;
+
+    ~Sender() {
+        ::close(_fd);
+    }
+
+    // @return number of datagrams sent.
+    std::size_t send_burst() {
+        auto num = ::sendmmsg(_fd, _msgs.data(), _msgs.size(), 0);
+        return num > 0 ? num : 0;
+    }
+
+private:
+    int _fd = -1;
+
+    sockaddr_in _addr{};
+
+    std::string _payload;
+
+    iovec _iov{};
+
+    std::vector<mmsghdr> _msgs;
+};
+
+// Datagrams per second handled by the server, with `recv_batch_size` datagrams
+// received per syscall. 0 receives one datagram per syscall.
+void BM_UdpServer_recv(benchmark::State &state) {
+    UdpServerOptions opts;
+    opts.ip = "127.0.0.1";
+    opts.port = PORT;
+    opts.buffer_size = 64 * 1024;
+    opts.recv_batch_size = state.range(0);
+    opts.recv_buffer_num = 4;
+
+    UdpServer server(opts);
+    std::atomic<std::size_t> received{0};
+    server.register_binary_handler([&received](const std::string_view &data) {
+                benchmark::DoNotOptimize(data.data());
+                received.fetch_add(1, std::memory_order_relaxed);
+            });
+
+    std::thread thread([&server]() { server.start(); });
+
+    Sender sender;
+    std::size_t sent = 0;
+    for (auto _ : state) {
+        sent += sender.send_burst();
+
+        // Wait for the burst, so that the socket receive buffer never overflows.
+        while (received.load(std::memory_order_relaxed) < sent) {
+            std::this_thread::yield();
+        }
+    }
+
+    server.stop();
+    thread.join();
+
+    state.SetItemsProcessed(static_cast<int64_t>(sent));
+}
+BENCHMARK(BM_UdpServer_recv)->Arg(0)->Arg(8)->Arg(20)->UseRealTime();
+
+}
@@ -0,0 +1,357 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "binary_codec.h"
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include "errors.h"
+
+namespace sw::gossip {
+
+namespace {
+
+constexpr uint64_t STATUS_BITS = 2;
+
+constexpr uint64_t STATUS_MASK = (1 << STATUS_BITS) - 1;
+
+constexpr uint64_t MAX_VERSION = std::numeric_limits<uint64_t>::max() >> STATUS_BITS;
+
+uint64_t pack_version(const Node &node) {
+    if (node.version > MAX_VERSION) {
+        throw Error("version is too large");
+    }
+
+    auto status = static_cast<uint64_t>(node.status);
+    if (status > static_cast<uint64_t>(NodeStatus::FAILED)) {
+        throw Error("unknow status");
+    }
+
+    return (node.version << STATUS_BITS) | status;
+}
+
+constexpr uint64_t KIND_BITS = 2;
+
+constexpr uint64_t KIND_MASK = (1 << KIND_BITS) - 1;
+
+constexpr uint64_t MAX_INDEX = std::numeric_limits<uint64_t>::max() >> KIND_BITS;
+
+uint64_t pack_code(const RumorCode &code) {
+    if (code.index > MAX_INDEX) {
+        throw Error("dictionary index is too large");
+    }
+
+    return (code.index << KIND_BITS) | static_cast<uint64_t>(code.kind);
+}
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view data) : _data(data) {}
+
+    uint8_t byte() {
+        if (_data.empty()) {
+            throw Error("incomplete binary message");
+        }
+
+        auto b = static_cast<uint8_t>(_data.front());
+        _data.remove_prefix(1);
+
+        return b;
+    }
+
+    uint64_t varint() {
+        uint64_t num = 0;
+        for (std::size_t shift = 0; shift < 64; shift += 7) {
+            auto b = byte();
+            num |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return num;
+            }
+        }
+
+        throw Error("invalid varint");
+    }
+
+    std::string_view string() {
+        auto len = varint();
+        if (len > _data.size()) {
+            throw Error("incomplete binary message");
+        }
+
+        auto str = _data.substr(0, len);
+        _data.remove_prefix(len);
+
+        return str;
+    }
+
+    Node node() {
+        Node node;
+        node.id.assign(string());
+
+        auto ip = string();
+        node.ip.assign(reinterpret_cast<const uint8_t *>(ip.data()), ip.size());
+
+        auto port = varint();
+        if (port > 65535) {
+            throw Error("invalid port");
+        }
+        node.port = static_cast<uint16_t>(port);
+
+        version(node);
+
+        return node;
+    }
+
+    void version(Node &node) {
+        auto version = varint();
+        auto status = version & STATUS_MASK;
+        if (status > static_cast<uint64_t>(NodeStatus::FAILED)) {
+            throw Error("invalid status");
+        }
+        node.status = static_cast<NodeStatus>(status);
+        node.version = version >> STATUS_BITS;
+    }
+
+    Node rumor(RumorCode &code) {
+        auto tag = varint();
+        auto kind = tag & KIND_MASK;
+        if (kind > static_cast<uint64_t>(RumorKind::REF)) {
+            throw Error("invalid rumor kind");
+        }
+        code.kind = static_cast<RumorKind>(kind);
+        code.index = tag >> KIND_BITS;
+
+        if (code.kind != RumorKind::REF) {
+            return node();
+        }
+
+        Node ref;
+        version(ref);
+
+        return ref;
+    }
+
+    bool empty() const {
+        return _data.empty();
+    }
+
+    std::size_t size() const {
+        return _data.size();
+    }
+
+private:
+    std::string_view _data;
+};
+
+}
+
+namespace binary {
+
+std::size_t node_size(const Node &node) {
+    auto ip_size = node.ip.size();
+    return varint_size(node.id.size()) + node.id.size() +
+        varint_size(ip_size) + ip_size +
+        varint_size(node.port) +
+        varint_size(pack_version(node));
+}
+
+std::size_t rumor_size(const Node &node, const RumorCode &code) {
+    auto size = varint_size(pack_code(code));
+    if (code.kind == RumorKind::REF) {
+        return size + varint_size(pack_version(node));
+    }
+
+    return size + node_size(node);
+}
+
+std::size_t dict_header_size(const DictHeader &header) {
+    return varint_size(header.epoch) + varint_size(header.seq)
+        + varint_size(header.peer_epoch) + varint_size(header.ack_seq)
+        + varint_size(header.ack_bits);
+}
+
+Message decode(std::string_view data) {
+    Decoder decoder(data);
+    if (decoder.byte() != MAGIC) {
+        throw Error("not a binary message");
+    }
+
+    Message msg;
+    switch (decoder.byte()) {
+    case VERSION:
+        break;
+
+    case DICT_VERSION:
+        msg.dict = true;
+        break;
+
+    default:
+        throw Error("unsupported binary message version");
+    }
+
+    auto type = decoder.byte();
+    switch (static_cast<MessageType>(type)) {
+    case MessageType::PING:
+    case MessageType::ACK:
+    case MessageType::PING_REQ:
+        msg.type = static_cast<MessageType>(type);
+        break;
+
+    default:
+        throw Error("unknown binary message type");
+    }
+
+    if (msg.dict) {
+        msg.dict_header.epoch = decoder.varint();
+        msg.dict_header.seq = decoder.varint();
+        msg.dict_header.peer_epoch = decoder.varint();
+        msg.dict_header.ack_seq = decoder.varint();
+        auto ack_bits = decoder.varint();
+        if (ack_bits > std::numeric_limits<uint32_t>::max()) {
+            throw Error("invalid dictionary ack bits");
+        }
+        msg.dict_header.ack_bits = static_cast<uint32_t>(ack_bits);
+    }
+
+    msg.self = decoder.node();
+    if (msg.type == MessageType::PING_REQ) {
+        msg.peer = decoder.node();
+    }
+
+    auto num = decoder.varint();
+    // Each node takes at least 4 bytes, or 2 bytes if it's a REF, and the check
+    // avoids reserving too much for invalid input.
+    if (num > decoder.size() / (msg.dict ? 2 : 4)) {
+        throw Error("invalid rumor number");
+    }
+
+    msg.rumors.reserve(num);
+    if (msg.dict) {
+        msg.codes.resize(num);
+        for (std::size_t idx = 0; idx != num; ++idx) {
+            msg.rumors.push_back(decoder.rumor(msg.codes[idx]));
+        }
+    } else {
+        for (std::size_t idx = 0; idx != num; ++idx) {
+            msg.rumors.push_back(decoder.node());
+        }
+    }
+
+    if (!decoder.empty()) {
+        throw Error("trailing bytes in binary message");
+    }
+
+    return msg;
+}
+
+}
+
+BinaryEncoder& BinaryEncoder::append_header(MessageType type) {
+    char header[] = {
+        static_cast<char>(binary::MAGIC),
+        static_cast<char>(binary::VERSION),
+        static_cast<char>(type)
+    };
+    _append(header, sizeof(header));
+
+    return *this;
+}
+
+BinaryEncoder& BinaryEncoder::append_header(MessageType type, const DictHeader &header) {
+    char buf[] = {
+        static_cast<char>(binary::MAGIC),
+        static_cast<char>(binary::DICT_VERSION),
+        static_cast<char>(type)
+    };
+    _append(buf, sizeof(buf));
+
+    append_varint(header.epoch);
+    append_varint(header.seq);
+    append_varint(header.peer_epoch);
+    append_varint(header.ack_seq);
+    append_varint(header.ack_bits);
+
+    return *this;
+}
+
+BinaryEncoder& BinaryEncoder::append_rumor(const Node &node, const RumorCode &code) {
+    append_varint(pack_code(code));
+    if (code.kind == RumorKind::REF) {
+        append_varint(pack_version(node));
+    } else {
+        append_node(node);
+    }
+
+    return *this;
+}
+
+BinaryEncoder& BinaryEncoder::append_node(const Node &node) {
+    append_string(node.id.view());
+    append_string(std::string_view(reinterpret_cast<const char *>(node.ip.bytes()),
+                node.ip.size()));
+    append_varint(node.port);
+    append_varint(pack_version(node));
+
+    return *this;
+}
+
+BinaryEncoder& BinaryEncoder::append_varint(uint64_t num) {
+    char buf[binary::MAX_VARINT_SIZE];
+    std::size_t len = 0;
+    while (num >= 0x80) {
+        buf[len++] = static_cast<char>((num & 0x7F) | 0x80);
+        num >>= 7;
+    }
+    buf[len++] = static_cast<char>(num);
+
+    _append(buf, len);
+
+    return *this;
+}
+
+BinaryEncoder& BinaryEncoder::append_string(const std::string_view &str) {
+    append_varint(str.size());
+    _append(str.data(), str.size());
+
+    return *this;
+}
+
+void BinaryEncoder::_append(const char *data, std::size_t len) {
+    if (in_place()) {
+        if (_ext_size + len <= _ext_capacity) {
+            std::memcpy(_ext + _ext_size, data, len);
+            _ext_size += len;
+            return;
+        }
+
+        _spill();
+    }
+
+    _buffer.append(data, len);
+}
+
+void BinaryEncoder::_spill() {
+    if (!in_place()) {
+        return;
+    }
+
+    _buffer.assign(_ext, _ext_size);
+    _ext = nullptr;
+    _ext_size = 0;
+    _ext_capacity = 0;
+}
+
+}
@@ -0,0 +1,207 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_BINARY_CODEC_H
+#define SW_GOSSIP_NET_BINARY_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils.h"
+
+namespace sw::gossip {
+
+enum class MessageType : uint8_t {
+    PING = 1,
+    ACK,
+    PING_REQ
+};
+
+// How a rumor is coded with the dictionary shared by sender and receiver.
+enum class RumorKind : uint8_t {
+    // Full node, which is not in the dictionary.
+    FULL = 0,
+
+    // Full node, which is also added to the receiver's dictionary with the index.
+    DEFINE,
+
+    // Only index, version and status. Id, ip and port are looked up in the dictionary.
+    REF
+};
+
+struct RumorCode {
+    RumorKind kind = RumorKind::FULL;
+
+    uint64_t index = 0;
+};
+
+// Dictionary state carried by messages with dictionary coding.
+struct DictHeader {
+    // Id of the sender's dictionary, which is random, and changes when the sender
+    // creates the dictionary again, e.g. it restarts.
+    uint64_t epoch = 0;
+
+    // Sequence number of the message among messages sent with the dictionary.
+    uint64_t seq = 0;
+
+    // Epoch of the receiver's dictionary, and the messages that the sender has received
+    // with it: the latest `ack_seq`, and bit N of `ack_bits` for `ack_seq - 1 - N`.
+    uint64_t peer_epoch = 0;
+
+    uint64_t ack_seq = 0;
+
+    uint32_t ack_bits = 0;
+};
+
+struct Message {
+    MessageType type = MessageType::PING;
+
+    Node self;
+
+    // Node to be probed, only for PING_REQ.
+    Node peer;
+
+    std::vector<Node> rumors;
+
+    // Whether rumors are coded with dictionary. If so, `codes[i]` is the code of
+    // `rumors[i]`, and REF rumors only have version and status, until they're resolved.
+    bool dict = false;
+
+    DictHeader dict_header;
+
+    std::vector<RumorCode> codes;
+};
+
+// Compact binary encoding of gossip messages:
+//
+// magic(1) version(1) type(1) self [peer] rumor_num(varint) rumors...
+//
+// and each node is encoded as:
+//
+// id_len(varint) id ip_len(varint) ip port(varint) (version << 2 | status)(varint)
+//
+// where ip is in network byte order, i.e. 4 bytes for IPv4, or 16 bytes for IPv6,
+// so that neither side converts it from or to the text form.
+//
+// With dictionary coding, i.e. DICT_VERSION, the type is followed by the dictionary header:
+//
+// epoch(varint) seq(varint) peer_epoch(varint) ack_seq(varint) ack_bits(varint)
+//
+// and each rumor starts with (index << 2 | kind)(varint), followed by the node for
+// FULL and DEFINE, or (version << 2 | status)(varint) for REF.
+//
+// The magic byte never starts a RESP message, so both encodings can share a socket.
+namespace binary {
+
+constexpr uint8_t MAGIC = 0xB7;
+
+constexpr uint8_t VERSION = 1;
+
+constexpr uint8_t DICT_VERSION = 3;
+
+inline bool is_binary(const std::string_view &data) {
+    return !data.empty() && static_cast<uint8_t>(data.front()) == MAGIC;
+}
+
+// Max encoded size of an uint64_t.
+constexpr std::size_t MAX_VARINT_SIZE = 10;
+
+inline std::size_t varint_size(uint64_t num) {
+    std::size_t size = 1;
+    while (num >= 0x80) {
+        num >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+// Encoded size of the node.
+std::size_t node_size(const Node &node);
+
+// Encoded size of the rumor with dictionary coding.
+std::size_t rumor_size(const Node &node, const RumorCode &code);
+
+// Encoded size of the dictionary header.
+std::size_t dict_header_size(const DictHeader &header);
+
+// @return the decoded message. Throw Error, if the data is invalid.
+Message decode(std::string_view data);
+
+}
+
+// Build a binary message. Like RespReplyBuilder, it writes into the given buffer
+// in place, and copies the message to an internal string if it outgrows the buffer.
+class BinaryEncoder {
+public:
+    BinaryEncoder() = default;
+
+    BinaryEncoder(char *buf, std::size_t capacity) : _ext(buf), _ext_capacity(capacity) {}
+
+    BinaryEncoder& append_header(MessageType type);
+
+    // Header of a message with dictionary coding.
+    BinaryEncoder& append_header(MessageType type, const DictHeader &header);
+
+    BinaryEncoder& append_node(const Node &node);
+
+    // Append a rumor of a message with dictionary coding.
+    BinaryEncoder& append_rumor(const Node &node, const RumorCode &code);
+
+    BinaryEncoder& append_varint(uint64_t num);
+
+    BinaryEncoder& append_string(const std::string_view &str);
+
+    bool in_place() const {
+        return _ext != nullptr;
+    }
+
+    std::size_t size() const {
+        return in_place() ? _ext_size : _buffer.size();
+    }
+
+    std::string_view view() const {
+        if (in_place()) {
+            return {_ext, _ext_size};
+        }
+
+        return _buffer;
+    }
+
+    // If the message is built in place, it's copied to the internal string.
+    std::string& data() {
+        _spill();
+        return _buffer;
+    }
+
+private:
+    void _append(const char *data, std::size_t len);
+
+    void _spill();
+
+    char *_ext = nullptr;
+
+    std::size_t _ext_size = 0;
+
+    std::size_t _ext_capacity = 0;
+
+    std::string _buffer;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_BINARY_CODEC_H
@@ -0,0 +1,78 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "buffer_pool.h"
+#include <cassert>
+#include "errors.h"
+
+namespace sw::gossip {
+
+BufferPool::BufferPool(std::size_t buffer_size, std::size_t buffer_num) :
+    _buffer_size(buffer_size),
+    _buffer_num(buffer_num) {
+    if (_buffer_size == 0 || _buffer_num == 0) {
+        throw Error("invalid buffer pool size");
+    }
+
+    expand();
+}
+
+char* BufferPool::acquire() {
+    if (_free_list.empty()) {
+        return nullptr;
+    }
+
+    auto *buffer = _free_list.back();
+    _free_list.pop_back();
+
+    return buffer;
+}
+
+void BufferPool::expand() {
+    auto slab = std::make_unique<char[]>(_buffer_size * _buffer_num);
+
+    _free_list.reserve(_free_list.size() + _buffer_num);
+    // Push in reverse order, so that buffers are handed out from the front of the slab.
+    for (auto idx = _buffer_num; idx != 0; --idx) {
+        _free_list.push_back(slab.get() + (idx - 1) * _buffer_size);
+    }
+
+    _slabs.push_back(std::move(slab));
+}
+
+void BufferPool::release(char *buffer) {
+    if (buffer == nullptr) {
+        return;
+    }
+
+    assert(_owns(buffer) && _free_list.size() < _buffer_num * _slabs.size());
+
+    _free_list.push_back(buffer);
+}
+
+bool BufferPool::_owns(const char *buffer) const {
+    for (const auto &slab : _slabs) {
+        const auto *first = slab.get();
+        const auto *last = first + _buffer_size * _buffer_num;
+        if (buffer >= first && buffer < last) {
+            return (buffer - first) % _buffer_size == 0;
+        }
+    }
+
+    return false;
+}
+
+}
@@ -0,0 +1,76 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_BUFFER_POOL_H
+#define SW_GOSSIP_NET_BUFFER_POOL_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sw::gossip {
+
+// A pool of fixed-size buffers carved from pre-allocated slabs.
+// NOT thread-safe, and should only be used in the event loop thread.
+class BufferPool {
+public:
+    BufferPool(std::size_t buffer_size, std::size_t buffer_num);
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool& operator=(const BufferPool &) = delete;
+
+    BufferPool(BufferPool &&) = default;
+    BufferPool& operator=(BufferPool &&) = default;
+
+    ~BufferPool() = default;
+
+    // @return nullptr if all buffers are in use.
+    char* acquire();
+
+    // Allocate another slab of `buffer_num` buffers.
+    void expand();
+
+    // Release a buffer acquired from this pool. Releasing nullptr is a no-op.
+    void release(char *buffer);
+
+    std::size_t buffer_size() const {
+        return _buffer_size;
+    }
+
+    std::size_t available() const {
+        return _free_list.size();
+    }
+
+    // Number of slabs allocated, including the one allocated by constructor.
+    std::size_t slab_num() const {
+        return _slabs.size();
+    }
+
+private:
+    bool _owns(const char *buffer) const;
+
+    std::size_t _buffer_size;
+
+    std::size_t _buffer_num;
+
+    std::vector<std::unique_ptr<char[]>> _slabs;
+
+    std::vector<char*> _free_list;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_BUFFER_POOL_H
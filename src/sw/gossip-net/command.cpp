@@ -20,84 +20,92 @@
 
 namespace sw::gossip {
 
-void Command::run(const RespRequest::Args &args) {
-    try {
-        _run(args, _net);
-    } catch (const Error &err) {
-        // TODO: reply with error
-    }
-}
-
 // ping self id ip port version [rumor id ip port version status]
 void PingCommand::_run(const RespRequest::Args &args, GossipNet &net) {
-    auto cmd_args = _parse_args(args);
+    // Parse in the receiving shard, and apply the result in the owner shard.
+    auto msg = _parse_args(args);
 
-    cmd_args.rumors.push_back(cmd_args.self);
-    net.update(cmd_args.rumors);
-
-    net.ack(cmd_args.self);
+    net.dispatch(std::move(msg));
 }
 
-PingCommand::Args PingCommand::_parse_args(const RespRequest::Args &args) const {
-    Args cmd_args;
+Message PingCommand::_parse_args(const RespRequest::Args &args) const {
+    Message msg;
+    msg.type = MessageType::PING;
 
     auto first = args.begin();
     auto last = args.end();
-    std::tie(cmd_args.self, first) = utils::parse_node("self", first, last);
+    std::tie(msg.self, first) = utils::parse_node("self", first, last);
 
-    cmd_args.rumors = utils::parse_rumors(first, last);
+    msg.rumors = utils::parse_rumors(first, last);
 
-    return cmd_args;
+    return msg;
 }
 
 // ping_req self id ip port version peer id ip port version [rumor id ip port version status]
 void PingReqCommand::_run(const RespRequest::Args &args, GossipNet &net) {
-    auto cmd_args = _parse_args(args);
+    auto msg = _parse_args(args);
+
+    net.dispatch(std::move(msg));
+}
 
-    cmd_args.rumors.push_back(cmd_args.self);
-    net.update(cmd_args.rumors);
+Message PingReqCommand::_parse_args(const RespRequest::Args &args) const {
+    Message msg;
+    msg.type = MessageType::PING_REQ;
 
-    // Forward ping.
-    net.ping(cmd_args.peer);
+    auto first = args.begin();
+    auto last = args.end();
+    std::tie(msg.self, first) = utils::parse_node("self", first, last);
 
-    auto task = std::make_unique<PingReqTask>(cmd_args.peer.id, cmd_args.self);
-    net.add(std::move(task));
+    std::tie(msg.peer, first) = utils::parse_node("peer", first, last);
+
+    msg.rumors = utils::parse_rumors(first, last);
+
+    return msg;
+}
+
+// caps self id ip port version binary_version
+void CapsCommand::_run(const RespRequest::Args &args, GossipNet &net) {
+    auto cmd_args = _parse_args(args);
+
+    net.dispatch([&net, cmd_args = std::move(cmd_args)]() {
+                net.on_caps(cmd_args.self, cmd_args.version);
+            });
 }
 
-PingReqCommand::Args PingReqCommand::_parse_args(const RespRequest::Args &args) const {
+CapsCommand::Args CapsCommand::_parse_args(const RespRequest::Args &args) const {
     Args cmd_args;
 
     auto first = args.begin();
     auto last = args.end();
     std::tie(cmd_args.self, first) = utils::parse_node("self", first, last);
 
-    std::tie(cmd_args.peer, first) = utils::parse_node("peer", first, last);
+    if (std::distance(first, last) != 1) {
+        throw Error("invalid caps");
+    }
 
-    cmd_args.rumors = utils::parse_rumors(first, last);
+    utils::to_num(*first, cmd_args.version);
 
     return cmd_args;
 }
 
 // ack self id ip port version [rumor id ip port version status]
 void AckCommand::_run(const RespRequest::Args &args, GossipNet &net) {
-    auto cmd_args = _parse_args(args);
-
-    cmd_args.rumors.push_back(cmd_args.self);
-    net.update(cmd_args.rumors);
+    auto msg = _parse_args(args);
 
-    net.do_task(cmd_args.self.id);
+    net.dispatch(std::move(msg));
 }
 
-AckCommand::Args AckCommand::_parse_args(const RespRequest::Args &args) const {
-    Args cmd_args;
+Message AckCommand::_parse_args(const RespRequest::Args &args) const {
+    Message msg;
+    msg.type = MessageType::ACK;
 
     auto first = args.begin();
     auto last = args.end();
-    std::tie(cmd_args.self, first) = utils::parse_node("self", first, last);
+    std::tie(msg.self, first) = utils::parse_node("self", first, last);
 
-    cmd_args.rumors = utils::parse_rumors(first, last);
+    msg.rumors = utils::parse_rumors(first, last);
 
-    return cmd_args;
+    return msg;
 }
 
 }
@@ -17,6 +17,10 @@
 #ifndef SW_GOSSIP_NET_COMMAND_H
 #define SW_GOSSIP_NET_COMMAND_H
 
+#include <memory>
+#include <string_view>
+#include "binary_codec.h"
+#include "errors.h"
 #include "resp.h"
 #include "utils.h"
 
@@ -24,6 +28,51 @@ namespace sw::gossip {
 
 class GossipNet;
 
+// Built-in commands. They're dispatched with a table indexed by type, while
+// other commands, i.e. extensions, are looked up by name.
+enum class CommandType : std::size_t {
+    PING = 0,
+    PING_REQ,
+    ACK,
+    CAPS,
+    UNKNOWN
+};
+
+constexpr std::size_t BUILTIN_COMMAND_NUM = static_cast<std::size_t>(CommandType::UNKNOWN);
+
+// Switch on length and first byte, so that at most one string comparison is needed.
+// @return CommandType::UNKNOWN, if it's not a built-in command.
+constexpr CommandType command_type(std::string_view name) {
+    switch (name.size()) {
+    case 3:
+        return name == "ack" ? CommandType::ACK : CommandType::UNKNOWN;
+
+    case 4:
+        switch (name[0]) {
+        case 'p':
+            return name == "ping" ? CommandType::PING : CommandType::UNKNOWN;
+
+        case 'c':
+            return name == "caps" ? CommandType::CAPS : CommandType::UNKNOWN;
+
+        default:
+            return CommandType::UNKNOWN;
+        }
+
+    case 8:
+        return name == "ping-req" ? CommandType::PING_REQ : CommandType::UNKNOWN;
+
+    default:
+        return CommandType::UNKNOWN;
+    }
+}
+
+static_assert(command_type("ping") == CommandType::PING);
+static_assert(command_type("ping-req") == CommandType::PING_REQ);
+static_assert(command_type("ack") == CommandType::ACK);
+static_assert(command_type("caps") == CommandType::CAPS);
+static_assert(command_type("pong") == CommandType::UNKNOWN);
+
 class Command {
 public:
     explicit Command(const std::string &name, GossipNet &net) :
@@ -31,7 +80,14 @@ public:
 
     virtual ~Command() = default;
 
-    void run(const RespRequest::Args &args);
+    // Errors are swallowed, since a bad request should not stop the server.
+    void run(const RespRequest::Args &args) {
+        try {
+            _run(args, _net);
+        } catch (const Error &err) {
+            // TODO: reply with error
+        }
+    }
 
     const std::string& name() const {
         return _name;
@@ -47,50 +103,50 @@ private:
 
 using CommandUPtr = std::unique_ptr<Command>;
 
-class PingCommand : public Command {
+class PingCommand final : public Command {
 public:
     explicit PingCommand(GossipNet &net) : Command("ping", net) {}
 
 private:
-    virtual std::vector<Node> _run(const RespRequest::Args &args, GossipNet &net) override;
+    virtual void _run(const RespRequest::Args &args, GossipNet &net) override;
 
-    struct Args {
-        Node self;
-        std::vector<Node> rumors;
-    };
-
-    Args _parse_args(const RespRequest::Args &args) const;
+    Message _parse_args(const RespRequest::Args &args) const;
 };
 
-class PingReqCommand : public Command {
+class PingReqCommand final : public Command {
 public:
     explicit PingReqCommand(GossipNet &net) : Command("ping-req", net) {}
 
 private:
-    virtual std::vector<Node> _run(const RespRequest::Args &args, GossipNet &net) override;
+    virtual void _run(const RespRequest::Args &args, GossipNet &net) override;
+
+    Message _parse_args(const RespRequest::Args &args) const;
+};
+
+// Advertise the supported binary format version.
+class CapsCommand final : public Command {
+public:
+    explicit CapsCommand(GossipNet &net) : Command("caps", net) {}
+
+private:
+    virtual void _run(const RespRequest::Args &args, GossipNet &net) override;
 
     struct Args {
         Node self;
-        Node peer;
-        std::vector<Node> rumors;
+        uint64_t version = 0;
     };
 
     Args _parse_args(const RespRequest::Args &args) const;
 };
 
-class AckCommand : public Command {
+class AckCommand final : public Command {
 public:
     explicit AckCommand(GossipNet &net) : Command("ack", net) {}
 
 private:
-    virtual std::vector<Node> _run(const RespRequest::Args &args, GossipNet &net) override;
+    virtual void _run(const RespRequest::Args &args, GossipNet &net) override;
 
-    struct Args {
-        Node self;
-        std::vector<Node> rumors;
-    };
-
-    Args _parse_args(const RespRequest::Args &args) const;
+    Message _parse_args(const RespRequest::Args &args) const;
 };
 
 }
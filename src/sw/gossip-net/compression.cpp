@@ -0,0 +1,343 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "compression.h"
+#include <cstring>
+#include "errors.h"
+
+namespace sw::gossip::lz {
+
+namespace {
+
+constexpr std::size_t MIN_MATCH = 4;
+
+constexpr std::size_t MAX_OFFSET = 65535;
+
+// Matches never start in the last bytes, and the last sequence has some literals,
+// so that the match finder can always read 4 bytes.
+constexpr std::size_t LAST_LITERALS = 5;
+
+constexpr std::size_t MF_LIMIT = 12;
+
+constexpr std::size_t HASH_BITS = 12;
+
+constexpr std::size_t MAX_VARINT_SIZE = 10;
+
+// Max ratio of decompressed size to compressed size. A match takes at least 3 bytes,
+// i.e. token and offset, for at most 19 bytes, and each extra length byte adds at
+// most 255 bytes.
+constexpr std::size_t MAX_EXPANSION = 255;
+
+uint32_t read32(const char *ptr) {
+    uint32_t val;
+    std::memcpy(&val, ptr, sizeof(val));
+    return val;
+}
+
+uint32_t hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+// Output with bounds check. Once it overflows, all writes are ignored.
+class Writer {
+public:
+    Writer(char *dst, std::size_t capacity) : _ptr(dst), _end(dst + capacity) {}
+
+    void byte(uint8_t b) {
+        if (_ptr == _end) {
+            _overflow = true;
+            return;
+        }
+
+        *_ptr++ = static_cast<char>(b);
+    }
+
+    void bytes(const char *data, std::size_t len) {
+        if (static_cast<std::size_t>(_end - _ptr) < len) {
+            _overflow = true;
+            _ptr = _end;
+            return;
+        }
+
+        std::memcpy(_ptr, data, len);
+        _ptr += len;
+    }
+
+    void varint(uint64_t num) {
+        while (num >= 0x80) {
+            byte(static_cast<uint8_t>((num & 0x7F) | 0x80));
+            num >>= 7;
+        }
+        byte(static_cast<uint8_t>(num));
+    }
+
+    // Extra bytes of a length, which is at least 15.
+    void length(std::size_t len) {
+        len -= 15;
+        while (len >= 255) {
+            byte(255);
+            len -= 255;
+        }
+        byte(static_cast<uint8_t>(len));
+    }
+
+    bool overflow() const {
+        return _overflow;
+    }
+
+    char* ptr() const {
+        return _ptr;
+    }
+
+private:
+    char *_ptr;
+
+    char *_end;
+
+    bool _overflow = false;
+};
+
+void write_sequence(Writer &writer,
+        const char *literals,
+        std::size_t literal_len,
+        std::size_t offset,
+        std::size_t match_len) {
+    auto lit_token = literal_len < 15 ? literal_len : 15;
+    std::size_t match_token = 0;
+    if (match_len > 0) {
+        match_len -= MIN_MATCH;
+        match_token = match_len < 15 ? match_len : 15;
+    }
+
+    writer.byte(static_cast<uint8_t>((lit_token << 4) | match_token));
+    if (lit_token == 15) {
+        writer.length(literal_len);
+    }
+
+    writer.bytes(literals, literal_len);
+
+    if (offset == 0) {
+        // The last sequence.
+        return;
+    }
+
+    writer.byte(static_cast<uint8_t>(offset & 0xFF));
+    writer.byte(static_cast<uint8_t>(offset >> 8));
+    if (match_token == 15) {
+        writer.length(match_len);
+    }
+}
+
+class Reader {
+public:
+    explicit Reader(std::string_view data) : _data(data) {}
+
+    uint8_t byte() {
+        if (_data.empty()) {
+            throw Error("incomplete compressed message");
+        }
+
+        auto b = static_cast<uint8_t>(_data.front());
+        _data.remove_prefix(1);
+
+        return b;
+    }
+
+    uint64_t varint() {
+        uint64_t num = 0;
+        for (std::size_t shift = 0; shift < 64; shift += 7) {
+            auto b = byte();
+            num |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return num;
+            }
+        }
+
+        throw Error("invalid varint");
+    }
+
+    std::size_t length(std::size_t len, std::size_t max_len) {
+        while (true) {
+            auto b = byte();
+            len += b;
+            if (len > max_len) {
+                throw Error("invalid length in compressed message");
+            }
+
+            if (b != 255) {
+                return len;
+            }
+        }
+    }
+
+    std::string_view bytes(std::size_t len) {
+        if (len > _data.size()) {
+            throw Error("incomplete compressed message");
+        }
+
+        auto res = _data.substr(0, len);
+        _data.remove_prefix(len);
+
+        return res;
+    }
+
+    bool empty() const {
+        return _data.empty();
+    }
+
+private:
+    std::string_view _data;
+};
+
+}
+
+std::size_t max_compressed_size(std::size_t size) {
+    // Header, and a single sequence of literals.
+    return 1 + MAX_VARINT_SIZE + 1 + size / 255 + 1 + size;
+}
+
+std::size_t compress(std::string_view src, char *dst, std::size_t capacity) {
+    if (capacity > src.size()) {
+        // Not worth it, unless it's smaller.
+        capacity = src.size();
+    }
+
+    Writer writer(dst, capacity);
+    writer.byte(MAGIC);
+    writer.varint(src.size());
+
+    const auto *base = src.data();
+    auto size = src.size();
+    std::size_t anchor = 0;
+
+    if (size > MF_LIMIT) {
+        // Positions plus 1, and 0 means empty.
+        uint32_t table[1 << HASH_BITS] = {};
+
+        auto limit = size - MF_LIMIT;
+        std::size_t pos = 0;
+        while (pos <= limit && !writer.overflow()) {
+            auto seq = read32(base + pos);
+            auto &slot = table[hash(seq)];
+            auto candidate = static_cast<std::size_t>(slot);
+            slot = static_cast<uint32_t>(pos + 1);
+
+            if (candidate == 0 || pos + 1 - candidate > MAX_OFFSET ||
+                    read32(base + candidate - 1) != seq) {
+                ++pos;
+                continue;
+            }
+
+            auto ref = candidate - 1;
+            auto len = MIN_MATCH;
+            while (pos + len < size - LAST_LITERALS && base[ref + len] == base[pos + len]) {
+                ++len;
+            }
+
+            write_sequence(writer, base + anchor, pos - anchor, pos - ref, len);
+
+            pos += len;
+            anchor = pos;
+        }
+    }
+
+    write_sequence(writer, base + anchor, size - anchor, 0, 0);
+
+    if (writer.overflow()) {
+        return 0;
+    }
+
+    auto compressed = static_cast<std::size_t>(writer.ptr() - dst);
+    if (compressed >= src.size()) {
+        return 0;
+    }
+
+    return compressed;
+}
+
+void decompress(std::string_view data, std::string &out, std::size_t max_size) {
+    Reader reader(data);
+    if (reader.byte() != MAGIC) {
+        throw Error("not a compressed message");
+    }
+
+    auto size = reader.varint();
+    if (size > max_size) {
+        throw Error("compressed message is too large");
+    }
+
+    // Check it before allocation, so that a short message cannot claim a huge size.
+    if (size / MAX_EXPANSION > data.size()) {
+        throw Error("invalid size in compressed message");
+    }
+
+    out.resize(size);
+    auto *dst = out.data();
+    std::size_t pos = 0;
+    while (true) {
+        auto token = reader.byte();
+
+        std::size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            literal_len = reader.length(literal_len, size - pos);
+        }
+
+        if (literal_len > size - pos) {
+            throw Error("invalid literal length in compressed message");
+        }
+
+        auto literals = reader.bytes(literal_len);
+        std::memcpy(dst + pos, literals.data(), literal_len);
+        pos += literal_len;
+
+        if (reader.empty()) {
+            break;
+        }
+
+        std::size_t offset = reader.byte();
+        offset |= static_cast<std::size_t>(reader.byte()) << 8;
+        if (offset == 0 || offset > pos) {
+            throw Error("invalid offset in compressed message");
+        }
+
+        std::size_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            match_len = reader.length(match_len, size);
+        }
+        match_len += MIN_MATCH;
+
+        if (match_len > size - pos) {
+            throw Error("invalid match length in compressed message");
+        }
+
+        const auto *ref = dst + pos - offset;
+        if (offset >= match_len) {
+            std::memcpy(dst + pos, ref, match_len);
+        } else {
+            // Byte by byte, since the match overlaps with itself.
+            for (std::size_t idx = 0; idx != match_len; ++idx) {
+                dst[pos + idx] = ref[idx];
+            }
+        }
+        pos += match_len;
+    }
+
+    if (pos != size) {
+        throw Error("size mismatch in compressed message");
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_COMPRESSION_H
+#define SW_GOSSIP_NET_COMPRESSION_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace sw::gossip {
+
+// A fast LZ77 block codec in the spirit of LZ4, for large and repetitive messages,
+// e.g. full state, whose ids, ip prefixes and status words repeat a lot.
+// A compressed message is:
+//
+// magic(1) raw_size(varint) sequences...
+//
+// and each sequence is:
+//
+// token(1) [literal_len...] literals [offset(2) [match_len...]]
+//
+// The high 4 bits of token is literal length, and the low 4 bits is match length
+// minus 4. If either is 15, it's continued with extra bytes, which are added up
+// until a byte less than 255. The last sequence has no match.
+//
+// The magic byte never starts a RESP or binary message, so receivers can tell
+// compressed messages apart, and decompress them before parsing.
+namespace lz {
+
+constexpr uint8_t MAGIC = 0xB8;
+
+inline bool is_compressed(const std::string_view &data) {
+    return !data.empty() && static_cast<uint8_t>(data.front()) == MAGIC;
+}
+
+// Compress `src` into `dst`.
+// @return compressed size, or 0 if it's not smaller than `src`, or doesn't fit into `dst`.
+std::size_t compress(std::string_view src, char *dst, std::size_t capacity);
+
+// Max compressed size of data of the given size, i.e. when it's incompressible.
+std::size_t max_compressed_size(std::size_t size);
+
+// Decompress `data` into `out`, which is reused to avoid allocation.
+// Throw Error, if `data` is invalid, or the original size exceeds `max_size`, or
+// it's more than `data` could expand to.
+void decompress(std::string_view data, std::string &out, std::size_t max_size);
+
+}
+
+}
+
+#endif // end SW_GOSSIP_NET_COMPRESSION_H
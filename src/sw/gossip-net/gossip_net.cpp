@@ -15,23 +15,90 @@
  *************************************************************************/
 
 #include "gossip_net.h"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <cstring>
+#include <iterator>
 #include "command.h"
+#include "compression.h"
+#include "logger.h"
 
 namespace sw::gossip {
 
+namespace {
+
+UdpServerOptions server_options(const GossipNetOptions &opts) {
+    auto server_opts = opts.server_options;
+    if (opts.shard_num > 1) {
+        server_opts.reuseport = true;
+    }
+
+    return server_opts;
+}
+
+TcpOptions push_pull_tcp_options(const GossipNetOptions &opts) {
+    const auto &server_opts = opts.server_options;
+
+    TcpOptions tcp_opts;
+    tcp_opts.ip = server_opts.ip;
+    tcp_opts.port = server_opts.port;
+    tcp_opts.backlog = opts.push_pull_options.backlog;
+    tcp_opts.keepalive = std::chrono::seconds(0);
+    tcp_opts.nodelay = false;
+
+    return tcp_opts;
+}
+
+const char* command_name(MessageType type) {
+    switch (type) {
+    case MessageType::PING:
+        return "ping";
+
+    case MessageType::ACK:
+        return "ack";
+
+    case MessageType::PING_REQ:
+        return "ping-req";
+
+    default:
+        throw Error("unknown message type");
+    }
+}
+
+}
+
 GossipNet::GossipNet(const GossipNetOptions &opts) :
-    _server(opts.server_options),
-    _opts(opts) {
-    _server.register_command(std::make_unique<PingCommand>(*this));
-    _server.register_command(std::make_unique<PingReqCommand>(*this));
-    _server.register_command(std::make_unique<AckCommand>(*this));
+    _server(server_options(opts)),
+    _opts(opts),
+    _messages(opts.message_queue_size),
+    _events(opts.event_queue_size) {
+    // Advertise the address of the owner shard, which push-pull listens on too.
+    _self.id.assign(opts.id);
+    _self.ip.assign(opts.server_options.ip);
+    _self.port = static_cast<uint16_t>(opts.server_options.port);
+
+    _register_commands(_server);
+
+    _push_pull = std::make_unique<PushPull>(_server.loop(),
+            push_pull_tcp_options(opts),
+            opts.push_pull_options,
+            *this);
+
+    for (auto idx = 1U; idx < opts.shard_num; ++idx) {
+        auto shard = std::make_unique<UdpServer>(server_options(opts));
+        _register_commands(*shard);
+        _shards.push_back(std::move(shard));
+    }
+
+    _membership.publish(state());
 }
 
 GossipNet::~GossipNet() {
-    if (_server_thread.joinable()) {
-        _server_thread.join();
-    }
+    stop();
+
+    // Push-pull handles run on the loop of the owner shard, and are destroyed before it.
+    uv::close_handles(_server.loop());
 }
 
 void GossipNet::start() {
@@ -40,142 +107,826 @@ void GossipNet::start() {
         throw Error("already started");
     }
 
+    // Start probing with the first protocol period.
+    _server.register_timer(_opts.protocol_period, [this]() {
+                _probe();
+            });
+
     _server_thread = std::thread([this]() {
                             _server.start();
                         });
+
+    for (auto &shard : _shards) {
+        _shard_threads.emplace_back([server = shard.get()]() {
+                                    server->start();
+                                });
+    }
 }
 
 void GossipNet::stop() {
     std::lock_guard<std::mutex> lock(_mtx);
+
+    // Stop other shards first, since they might wait for the owner shard to drain
+    // a full queue.
+    for (auto idx = 0U; idx != _shard_threads.size(); ++idx) {
+        auto &thread = _shard_threads[idx];
+        if (thread.joinable()) {
+            _shards[idx]->stop();
+            thread.join();
+        }
+    }
+
+    _shard_threads.clear();
+
     if (_server_thread.joinable()) {
         _server.stop();
         _server_thread.join();
     }
 }
 
+void GossipNet::dispatch(std::function<void ()> task) {
+    if (_server.in_loop_thread()) {
+        task();
+    } else {
+        _server.post(std::move(task));
+    }
+}
+
+void GossipNet::dispatch(Message msg) {
+    if (_server.in_loop_thread()) {
+        _on_message(msg);
+        return;
+    }
+
+    while (!_messages.try_push(msg)) {
+        std::this_thread::yield();
+    }
+
+    // Only the first message after the owner shard drained the queue needs a task.
+    // The task only captures `this`, so that posting it doesn't allocate either.
+    if (!_drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        _server.post([this]() { _drain_messages(); });
+    }
+}
+
 void GossipNet::join(const std::string &ip, int port) {
+    // Learn the full view with a single exchange, instead of waiting for rumors.
+    dispatch([this, ip, port]() {
+                _push_pull->sync(ip, port);
+            });
 }
 
 void GossipNet::update(std::vector<Node> rumors) {
     for (auto &rumor : rumors) {
-        auto node = _members.try_update(std::move(rumor));
-        if (node) {
-            _recently_updated_members.add(*node);
+        if (rumor.id == _self.id) {
+            if (rumor.status != NodeStatus::ALIVE && rumor.version >= _self.version) {
+                // Refute the suspicion with a newer version, which is spread with pings and acks.
+                _self.version = rumor.version + 1;
+                _on_membership_change();
+            }
+
+            continue;
+        }
+
+        std::optional<NodeStatus> prev;
+        auto node = _members.try_update(std::move(rumor), prev);
+        // The recently updated set might have a newer state.
+        if (node && _recently_updated_members.add(*node, prev)) {
+            if (node->status != NodeStatus::FAILED) {
+                // Resolve the address once, so that sending to it needs no parsing.
+                _server.add_peer(node->id, node->ip, node->port);
+            }
+
+            auto iter = _suspicions.find(node->id);
+            if (node->status == NodeStatus::SUSPECTED) {
+                if (iter == _suspicions.end()) {
+                    auto timer = _server.register_timer(_opts.suspicion_timeout,
+                            [this, suspected = *node]() {
+                                _on_suspicion_timeout(suspected);
+                            });
+                    _suspicions.emplace(node->id, timer);
+                }
+            } else if (iter != _suspicions.end()) {
+                // Refuted or already failed.
+                _server.cancel_timer(iter->second);
+                _suspicions.erase(iter);
+            }
+
+            if (_events.subscribed()) {
+                auto type = membership_event(prev, node->status);
+                if (type) {
+                    _on_membership_event(*type, *node);
+                }
+            }
+
+            _on_membership_change();
         }
     }
 }
 
-void GossipNet::ping_req(const Node &node) {
-}
+void GossipNet::merge(std::vector<Node> nodes) {
+    ++_merging;
 
-void GossipNet::ack(const Node &dest) {
-    ack(dest, _self);
+    _merge(std::move(nodes));
 }
 
-void GossipNet::ack(const Node &dest, const Node &self) {
-    auto rumors = _build_rumors();
+void GossipNet::_merge(std::vector<Node> nodes) {
+    auto batch_size = std::max<std::size_t>(_opts.push_pull_options.merge_batch_size, 1);
+    auto num = std::min(batch_size, nodes.size());
 
-    RespReplyBuilder builder;
-    builder.append_array(1 + 5 + rumors.size() * 6);
-    builder.append_simple_string("ack");
-    _append_node(builder, "self", self, false);
+    std::vector<Node> batch;
+    batch.reserve(num);
+    for (auto iter = nodes.end() - num; iter != nodes.end(); ++iter) {
+        // Only the node itself can refute a suspicion.
+        if (iter->id != _self.id) {
+            batch.push_back(std::move(*iter));
+        }
+    }
+    nodes.resize(nodes.size() - num);
+
+    update(std::move(batch));
 
-    for (const auto &rumor : rumors) {
-        _append_node(builder, "rumor", rumor);
+    if (!nodes.empty()) {
+        _server.defer([this, nodes = std::move(nodes)]() mutable {
+                    _merge(std::move(nodes));
+                });
+        return;
     }
 
-    _server.send(dest.ip, dest.port, std::move(builder.data()));
+    assert(_merging > 0);
+    if (--_merging == 0 && _snapshot_deferred) {
+        _snapshot_deferred = false;
+        _on_membership_change();
+    }
 }
 
-void GossipNet::ping(const Node &dest) {
-    auto rumors = _build_rumors();
+std::vector<Node> GossipNet::state() const {
+    auto nodes = _members.all();
 
-    RespReplyBuilder builder;
-    builder.append_array(1 + 5 + rumors.size() * 6);
-    builder.append_simple_string("ping");
+    auto recent_nodes = _recently_updated_members.all();
+    nodes.insert(nodes.end(),
+            std::make_move_iterator(recent_nodes.begin()),
+            std::make_move_iterator(recent_nodes.end()));
+
+    nodes.push_back(_self);
 
-    _append_node(builder, "self", _self, false);
+    return nodes;
+}
 
-    for (const auto &rumor : rumors) {
-        _append_node(builder, "rumor", rumor);
+void GossipNet::push_pull() {
+    // Members are fetched in a round-robin way, so that all of them are synchronized eventually.
+    auto nodes = _members.fetch(1);
+    for (const auto &node : nodes) {
+        if (node.id != _self.id) {
+            _push_pull->sync(node.ip.str(), node.port);
+        }
     }
+}
 
-    _server.send(dest.ip, dest.port, std::move(builder.data()));
+void GossipNet::on_ping(Node self, std::vector<Node> rumors) {
+    rumors.push_back(self);
+    update(std::move(rumors));
+
+    ack(self);
 }
 
-void GossipNet::do_task(const std::string &id) {
-    auto tasks = _tasks.fetch(id);
-    for (auto &task : tasks) {
-        assert(task);
+void GossipNet::on_ping_req(Node self, Node peer, std::vector<Node> rumors) {
+    rumors.push_back(self);
+    update(std::move(rumors));
 
-        auto next_task = task.run();
-        if (next_task) {
-            _tasks.add(std::move(next_task));
-        }
-    }
+    forward_ping(peer, self);
 }
 
-void GossipNet::_append_node(RespReplyBuilder &builder,
-        const std::string &type,
-        const Node &node,
-        bool append_status) const {
-    builder.append_simple_string(type)
-        .append_simple_string(node.id)
-        .append_simple_string(node.ip)
-        .append_simple_string(std::to_string(node.port))
-        .append_simple_string(std::to_string(version));
+void GossipNet::on_ack(Node self, std::vector<Node> rumors) {
+    auto id = self.id;
 
-    if (append_status) {
-        const char *status = nullptr;
-        switch (node.status) {
-        case NodeStatus::ALIVE:
-            status = utils::ALIVE;
-            break;
+    rumors.push_back(std::move(self));
+    update(std::move(rumors));
 
-        case NodeStatus::SUSPECTED:
-            status = utils::SUSPECTED;
-            break;
+    do_task(id);
+}
+
+void GossipNet::on_caps(const Node &self, uint64_t version) {
+    auto peer = _peer(self);
+    auto format = _server.peer_format(peer);
+    if (format != WireFormat::BINARY && format != WireFormat::BINARY_DICT) {
+        // Let the peer know that we support binary format too.
+        _send_caps(peer);
+    }
+
+    if (version >= binary::DICT_VERSION && _opts.rumor_dictionary_size > 0) {
+        _server.set_peer_format(peer, WireFormat::BINARY_DICT);
+    } else if (version >= binary::VERSION) {
+        _server.set_peer_format(peer, WireFormat::BINARY);
+    }
+}
+
+void GossipNet::ping_req(const Node &node) {
+    auto members = _members.fetch(_opts.indirect_checks + 2);
 
-        case NodeStatus::FAILED:
-            status = utils::FAILED;
+    std::size_t num = 0;
+    for (const auto &member : members) {
+        if (num == _opts.indirect_checks) {
             break;
+        }
 
-        default:
-            throw Error("unknow status");
+        if (member.id == node.id || member.id == _self.id ||
+                member.status != NodeStatus::ALIVE) {
+            continue;
         }
 
-        builder.append_simple_string(status);
+        // Rumors are picked for each member, since they're packed in its wire format.
+        _send(member, MessageType::PING_REQ, _self, &node,
+                _build_rumors(member, MessageType::PING_REQ, _self, &node));
+
+        ++num;
+    }
+
+    // Wait for relayed acks in the remaining of the protocol period.
+    auto timeout = _opts.protocol_period - _opts.ping_timeout;
+    if (timeout <= std::chrono::milliseconds(0)) {
+        timeout = _opts.ping_timeout;
     }
+
+    add_task(std::make_unique<IndirectProbeTask>(node, *this), timeout);
+}
+
+void GossipNet::forward_ping(const Node &dest, const Node &requester) {
+    ping(dest);
+
+    add_task(std::make_unique<PingReqTask>(dest, requester, *this), _opts.ping_timeout);
 }
 
-void GossipNet::add_task(const std::string &id, std::unique_ptr<Task> task) {
-    _tasks.add(id, std::move(task));
+void GossipNet::suspect(const Node &node) {
+    auto suspected = node;
+    suspected.status = NodeStatus::SUSPECTED;
+
+    update({std::move(suspected)});
 }
 
-std::vector<Node> GossipNet::_build_rumors() {
+void GossipNet::ack(const Node &dest) {
+    ack(dest, _self);
+}
+
+void GossipNet::ack(const Node &dest, const Node &self) {
+    _send(dest, MessageType::ACK, self, nullptr,
+            _build_rumors(dest, MessageType::ACK, self, nullptr));
+}
+
+void GossipNet::ping(const Node &dest) {
+    _send(dest, MessageType::PING, _self, nullptr,
+            _build_rumors(dest, MessageType::PING, _self, nullptr));
+}
+
+void GossipNet::add_task(TaskUPtr task, const std::chrono::milliseconds &timeout) {
+    assert(task);
+
+    auto timer = _server.register_timer(timeout, [this, ptr = task.get()]() {
+                _on_task_timeout(*ptr);
+            });
+
+    _tasks.add(std::move(task), timer);
+}
+
+void GossipNet::do_task(const NodeId &id) {
+    auto items = _tasks.fetch(id);
+    for (auto &item : items) {
+        assert(item.task);
+
+        _server.cancel_timer(item.timer);
+        item.task->on_ack();
+    }
+}
+
+std::vector<Node> GossipNet::_build_rumors(const Node &dest,
+        MessageType type,
+        const Node &self,
+        const Node *peer) {
     auto max_rumor_num = _opts.max_rumor_num;
+    auto format = _wire_format(_peer(dest), self);
+    auto budget = _rumor_budget(format, dest, type, self, peer);
+    NodeSize node_size;
+    switch (format) {
+    case WireFormat::BINARY:
+        node_size = [](const Node &node) {
+            return binary::node_size(node);
+        };
+        break;
+
+    case WireFormat::BINARY_DICT:
+        node_size = [dict = &_dict(dest.id)](const Node &node) {
+            return dict->size(node);
+        };
+        break;
+
+    default:
+        node_size = [](const Node &node) {
+            return RespReplyBuilder::node_size("rumor", node);
+        };
+        break;
+    }
 
     // Each new member info will be spread max_spreaded_num times before stable.
     auto max_spreaded_num = static_cast<std::size_t>(_opts.lambda * std::log(_members.size()
                 + _recently_updated_members.size())) + 1;
 
-    auto [rumors, stable_rumors] = _recently_updated_members.fetch(max_rumor_num, max_spreaded_num);
+    auto [rumors, stable_rumors, reaped_rumors] =
+        _recently_updated_members.fetch(max_rumor_num, max_spreaded_num, budget, node_size);
 
     for (auto &rumor : stable_rumors) {
         _members.add(std::move(rumor));
     }
 
-    if (rumors.size() == max_rumor_num) {
-        return rumors;
+    if (rumors.size() < max_rumor_num) {
+        // Fill the rest with stable members.
+        auto n = max_rumor_num - rumors.size();
+        auto temp = _members.fetch(n, budget, node_size);
+        rumors.insert(rumors.end(), temp.begin(), temp.end());
     }
 
-    assert(rumors.size() < max_rumor_num);
+    // Do it at last, since `node_size` might refer to the dictionary of a reaped peer.
+    for (const auto &rumor : reaped_rumors) {
+        _server.remove_peer(rumor.id);
+        _dicts.erase(rumor.id);
+        for (auto &[id, dict] : _dicts) {
+            dict.remove(rumor.id);
+        }
 
-    auto n = max_rumor_num - rumors.size();
-    auto temp = _members.fetch(n);
-    rumors.insert(rumors.end(), temp.begin(), temp.end());
+        if (_events.subscribed()) {
+            _on_membership_event(MembershipEventType::LEAVE, rumor);
+        }
+    }
+
+    if (!reaped_rumors.empty()) {
+        _on_membership_change();
+    }
 
     return rumors;
 }
 
+std::size_t GossipNet::_rumor_budget(WireFormat format,
+        const Node &dest,
+        MessageType type,
+        const Node &self,
+        const Node *peer) {
+    std::size_t size = 0;
+    switch (format) {
+    case WireFormat::BINARY:
+    case WireFormat::BINARY_DICT:
+        // magic, version and type, and rumor number is bounded by the max number of rumors.
+        size = 3 + binary::node_size(self) + binary::varint_size(_opts.max_rumor_num);
+        if (peer != nullptr) {
+            size += binary::node_size(*peer);
+        }
+
+        if (format == WireFormat::BINARY_DICT) {
+            size += binary::dict_header_size(_dict(dest.id).header());
+        }
+        break;
+
+    default: {
+        // Array size is bounded by the max number of rumors.
+        auto num = 1 + 5 + (peer != nullptr ? 5 : 0) + _opts.max_rumor_num * 6;
+        size = RespReplyBuilder::integer_size(num)
+            + RespReplyBuilder::bulk_string_size(std::strlen(command_name(type)))
+            + RespReplyBuilder::node_size("self", self, false);
+        if (peer != nullptr) {
+            size += RespReplyBuilder::node_size("peer", *peer, false);
+        }
+        break;
+    }
+    }
+
+    if (size >= _opts.max_message_size) {
+        return 0;
+    }
+
+    return _opts.max_message_size - size;
+}
+
+void GossipNet::_probe() {
+    // Schedule the next period first, so that probing goes on even if this one fails.
+    _server.register_timer(_opts.protocol_period, [this]() {
+                _probe();
+            });
+
+    ++_period;
+
+    auto member = _members.probe();
+    if (!member) {
+        member = _probe_recent();
+    }
+
+    if (!member || member->id == _self.id || member->status == NodeStatus::FAILED) {
+        return;
+    }
+
+    ping(*member);
+
+    add_task(std::make_unique<ProbeTask>(*member, *this), _opts.ping_timeout);
+}
+
+std::optional<Node> GossipNet::_probe_recent() {
+    auto nodes = _recently_updated_members.all();
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                [](const Node &node) { return node.status == NodeStatus::FAILED; }),
+            nodes.end());
+    if (nodes.empty()) {
+        return std::nullopt;
+    }
+
+    std::uniform_int_distribution<std::size_t> dist(0, nodes.size() - 1);
+
+    return nodes[dist(_rng)];
+}
+
+void GossipNet::_on_task_timeout(const Task &task) {
+    // The timer is canceled when the task is fetched, so the task should be pending.
+    auto pending = _tasks.remove(task);
+    if (pending) {
+        pending->on_timeout();
+    }
+}
+
+void GossipNet::_on_suspicion_timeout(const Node &node) {
+    _suspicions.erase(node.id);
+
+    auto failed = node;
+    failed.status = NodeStatus::FAILED;
+
+    update({std::move(failed)});
+}
+
+void GossipNet::_register_commands(UdpServer &server) {
+    server.register_command(std::make_unique<PingCommand>(*this));
+    server.register_command(std::make_unique<PingReqCommand>(*this));
+    server.register_command(std::make_unique<AckCommand>(*this));
+    server.register_command(std::make_unique<CapsCommand>(*this));
+
+    server.register_binary_handler([this](const std::string_view &buf) {
+                _on_binary(buf);
+            });
+}
+
+WireFormat GossipNet::_wire_format(const PeerHandle &dest, const Node &self) const {
+    auto format = _server.peer_format(dest);
+    if (format == WireFormat::BINARY_DICT && self.id != _self.id) {
+        // The peer keys the dictionary with `self`, which is not the sender of a relayed message.
+        return WireFormat::BINARY;
+    }
+
+    return format;
+}
+
+RumorDictionary& GossipNet::_dict(const NodeId &id) {
+    auto iter = _dicts.find(id);
+    if (iter == _dicts.end()) {
+        iter = _dicts.emplace(id, RumorDictionary(_opts.rumor_dictionary_size, _rng())).first;
+    }
+
+    return iter->second;
+}
+
+RumorDictionary* GossipNet::_sender_dict(const NodeId &id) {
+    auto iter = _dicts.find(id);
+    if (iter != _dicts.end()) {
+        return &iter->second;
+    }
+
+    if (!_members.contains(id) && !_recently_updated_members.contains(id)) {
+        return nullptr;
+    }
+
+    auto peer = _server.find_peer(id);
+    if (!peer.valid() || _server.peer_format(peer) != WireFormat::BINARY_DICT) {
+        return nullptr;
+    }
+
+    return &_dict(id);
+}
+
+void GossipNet::_resolve(Message &msg) {
+    assert(msg.rumors.size() == msg.codes.size());
+
+    // Without a dictionary, or with indexes beyond its capacity, the message is
+    // handled as a stale one, i.e. it's neither learned nor acked. So the peer keeps
+    // sending these members in full.
+    auto *dict = _sender_dict(msg.self.id);
+    auto fresh = dict != nullptr
+        && std::all_of(msg.codes.begin(), msg.codes.end(),
+                [dict](const RumorCode &code) { return dict->valid(code); })
+        && dict->on_header(msg.dict_header);
+
+    // Drop rumors that cannot be resolved. Entries that we've lost are defined
+    // again, since the peer only references entries of acked messages.
+    std::size_t num = 0;
+    for (std::size_t idx = 0; idx != msg.rumors.size(); ++idx) {
+        const auto &code = msg.codes[idx];
+        if (fresh) {
+            if (!dict->decode(msg.rumors[idx], code)) {
+                _stats.dictionary_misses.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+        } else if (code.kind == RumorKind::REF) {
+            // The index might have been reused since the stale message was sent.
+            _stats.dictionary_misses.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (num != idx) {
+            msg.rumors[num] = std::move(msg.rumors[idx]);
+        }
+        ++num;
+    }
+
+    msg.rumors.resize(num);
+}
+
+PeerHandle GossipNet::_peer(const Node &dest) {
+    auto peer = _server.find_peer(dest.id);
+    if (!peer.valid()) {
+        peer = _server.add_peer(dest.id, dest.ip, dest.port);
+    }
+
+    return peer;
+}
+
+void GossipNet::_on_binary(const std::string_view &buf) {
+    auto msg = binary::decode(buf);
+    if (msg.dict && _opts.rumor_dictionary_size == 0) {
+        // We never advertise dictionary coding with it disabled.
+        SW_GOSSIP_LOG_ERROR_RL("dictionary coding is disabled, drop the message");
+        return;
+    }
+
+    dispatch(std::move(msg));
+}
+
+void GossipNet::_on_message(Message &msg) {
+    if (msg.dict) {
+        _resolve(msg);
+    }
+
+    switch (msg.type) {
+    case MessageType::PING:
+        on_ping(std::move(msg.self), std::move(msg.rumors));
+        break;
+
+    case MessageType::ACK:
+        on_ack(std::move(msg.self), std::move(msg.rumors));
+        break;
+
+    case MessageType::PING_REQ:
+        on_ping_req(std::move(msg.self), std::move(msg.peer), std::move(msg.rumors));
+        break;
+
+    default:
+        assert(false);
+    }
+}
+
+void GossipNet::_drain_messages() {
+    // Clear the flag before draining, so that any message pushed after that
+    // is either handled by this call, or posts another task.
+    _drain_pending.exchange(false, std::memory_order_acq_rel);
+
+    auto max_num = _messages.capacity();
+    std::size_t num = 0;
+    Message msg;
+    while (num < max_num && _messages.try_pop(msg)) {
+        ++num;
+        try {
+            _on_message(msg);
+        } catch (const Error &err) {
+            SW_GOSSIP_LOG_ERROR_RL("failed to handle message: %s", err.what());
+        }
+    }
+
+    if (num == max_num && !_drain_pending.exchange(true, std::memory_order_acq_rel)) {
+        // There might be more messages. Let other tasks run, and drain again.
+        _server.post([this]() { _drain_messages(); });
+    }
+}
+
+void GossipNet::_send(const Node &dest,
+        MessageType type,
+        const Node &self,
+        const Node *peer,
+        const std::vector<Node> &rumors) {
+    auto handle = _peer(dest);
+    auto format = _wire_format(handle, self);
+    if (format == WireFormat::UNKNOWN) {
+        // Talk RESP until the peer replies, since it might be an older node.
+        _negotiate(handle);
+        format = WireFormat::RESP;
+    }
+
+    auto buf = _server.acquire_send_buffer();
+    try {
+        if (format == WireFormat::BINARY_DICT) {
+            auto &dict = _dict(dest.id);
+            BinaryEncoder encoder(buf.data, buf.capacity);
+            encoder.append_header(type, dict.begin_message()).append_node(self);
+            if (peer != nullptr) {
+                encoder.append_node(*peer);
+            }
+
+            encoder.append_varint(rumors.size());
+            std::size_t refs = 0;
+            for (const auto &rumor : rumors) {
+                auto code = dict.encode(rumor);
+                if (code.kind == RumorKind::REF) {
+                    ++refs;
+                }
+
+                encoder.append_rumor(rumor, code);
+            }
+
+            _stats.dictionary_refs.fetch_add(refs, std::memory_order_relaxed);
+            _record(encoder.size(), rumors.size());
+            _send(handle, encoder, buf);
+        } else if (format == WireFormat::BINARY) {
+            BinaryEncoder encoder(buf.data, buf.capacity);
+            encoder.append_header(type).append_node(self);
+            if (peer != nullptr) {
+                encoder.append_node(*peer);
+            }
+
+            encoder.append_varint(rumors.size());
+            for (const auto &rumor : rumors) {
+                encoder.append_node(rumor);
+            }
+
+            _record(encoder.size(), rumors.size());
+            _send(handle, encoder, buf);
+        } else {
+            std::string_view name = command_name(type);
+            auto num = 1 + 5 + (peer != nullptr ? 5 : 0) + rumors.size() * 6;
+            auto size = RespReplyBuilder::integer_size(num)
+                + RespReplyBuilder::bulk_string_size(name.size())
+                + RespReplyBuilder::node_size("self", self, false);
+            if (peer != nullptr) {
+                size += RespReplyBuilder::node_size("peer", *peer, false);
+            }
+
+            for (const auto &rumor : rumors) {
+                size += RespReplyBuilder::node_size("rumor", rumor);
+            }
+
+            RespReplyBuilder builder(buf.data, buf.capacity);
+            builder.reserve(size);
+            builder.append_array(num);
+            builder.append_bulk_string(name);
+            builder.append_node("self", self, false);
+            if (peer != nullptr) {
+                builder.append_node("peer", *peer, false);
+            }
+
+            for (const auto &rumor : rumors) {
+                builder.append_node("rumor", rumor);
+            }
+
+            _record(builder.size(), rumors.size());
+            _send(handle, builder, buf);
+        }
+    } catch (...) {
+        _server.release_send_buffer(buf);
+        throw;
+    }
+}
+
+void GossipNet::_record(std::size_t size, std::size_t rumor_num) {
+    _stats.messages.fetch_add(1, std::memory_order_relaxed);
+    _stats.message_bytes.fetch_add(size, std::memory_order_relaxed);
+    _stats.budget_bytes.fetch_add(_opts.max_message_size, std::memory_order_relaxed);
+    _stats.rumors.fetch_add(rumor_num, std::memory_order_relaxed);
+    if (size > _opts.max_message_size) {
+        _stats.oversized_messages.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void GossipNet::_on_membership_change() {
+    if (_snapshot_scheduled) {
+        return;
+    }
+
+    // Changes in the interval are published with a single snapshot.
+    _snapshot_scheduled = true;
+    _server.register_timer(_opts.snapshot_interval, [this]() {
+                _snapshot_scheduled = false;
+                if (_merging > 0) {
+                    // Publishing copies the full state, so doing it between merge batches
+                    // makes merging a large state quadratic. Publish once it's merged.
+                    _snapshot_deferred = true;
+                    return;
+                }
+
+                _membership.publish(state());
+            });
+}
+
+void GossipNet::_on_membership_event(MembershipEventType type, const Node &node) {
+    _events.add(type, node);
+
+    if (_events_scheduled) {
+        return;
+    }
+
+    // Events of this loop iteration are delivered with a single batch.
+    _events_scheduled = true;
+    _server.post([this]() {
+                _events_scheduled = false;
+                _events.flush();
+            });
+}
+
+GossipNetStats GossipNet::stats() const {
+    auto stats = _stats.snapshot();
+    stats.events_delivered = _events.delivered();
+    stats.events_coalesced = _events.coalesced();
+    stats.events_dropped = _events.dropped();
+
+    return stats;
+}
+
+GossipNetStats GossipNet::Stats::snapshot() const {
+    GossipNetStats stats;
+    stats.messages = messages.load(std::memory_order_relaxed);
+    stats.message_bytes = message_bytes.load(std::memory_order_relaxed);
+    stats.budget_bytes = budget_bytes.load(std::memory_order_relaxed);
+    stats.rumors = rumors.load(std::memory_order_relaxed);
+    stats.oversized_messages = oversized_messages.load(std::memory_order_relaxed);
+    stats.compressed_messages = compressed_messages.load(std::memory_order_relaxed);
+    stats.dictionary_refs = dictionary_refs.load(std::memory_order_relaxed);
+    stats.dictionary_misses = dictionary_misses.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+template <typename Builder>
+void GossipNet::_send(const PeerHandle &peer, Builder &builder, SendBuffer &buf) {
+    if (_opts.compression_threshold > 0 && builder.size() > _opts.compression_threshold) {
+        auto out = _server.acquire_send_buffer();
+        out.size = lz::compress(builder.view(), out.data, out.capacity);
+        if (out.size > 0) {
+            _stats.compressed_messages.fetch_add(1, std::memory_order_relaxed);
+            _server.release_send_buffer(buf);
+            _server.send(peer, out);
+            buf = SendBuffer{};
+            return;
+        }
+
+        // Incompressible, or it doesn't fit.
+        _server.release_send_buffer(out);
+    }
+
+    if (builder.in_place()) {
+        buf.size = builder.size();
+        _server.send(peer, buf);
+    } else {
+        // The message outgrows the pooled buffer, and has been copied to heap.
+        _server.release_send_buffer(buf);
+        _server.send(peer, std::move(builder.data()));
+    }
+
+    // Ownership has been transferred.
+    buf = SendBuffer{};
+}
+
+void GossipNet::_send_caps(const PeerHandle &peer) {
+    RespReplyBuilder builder;
+    builder.append_array(1 + 5 + 1);
+    builder.append_bulk_string("caps");
+    builder.append_node("self", _self, false);
+    // Dictionary coding is advertised only if it's enabled, so that it's used
+    // only if both sides enable it.
+    builder.append_bulk_integer(_opts.rumor_dictionary_size > 0 ?
+            binary::DICT_VERSION : binary::VERSION);
+
+    _server.send(peer, std::move(builder.data()));
+}
+
+void GossipNet::_negotiate(const PeerHandle &peer) {
+    auto *negotiation = _server.peer_negotiation(peer);
+    if (negotiation == nullptr) {
+        return;
+    }
+
+    if (negotiation->attempts > 0
+            && _period < negotiation->period + _opts.caps_retry_periods) {
+        // Wait for the reply of the last attempt.
+        return;
+    }
+
+    if (negotiation->attempts >= std::max<std::size_t>(_opts.caps_max_attempts, 1)) {
+        _server.set_peer_format(peer, WireFormat::RESP);
+        return;
+    }
+
+    _send_caps(peer);
+
+    ++negotiation->attempts;
+    negotiation->period = _period;
+}
+
 }
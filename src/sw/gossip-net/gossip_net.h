@@ -17,25 +17,146 @@
 #ifndef SW_GOSSIP_NET_GOSSIP_NET_H
 #define SW_GOSSIP_NET_GOSSIP_NET_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <string>
 #include <thread>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <vector>
 #include "udp_server.h"
+#include "binary_codec.h"
+#include "mpsc_queue.h"
+#include "push_pull.h"
 #include "utils.h"
 #include "pending_lists.h"
 #include "member_set.h"
+#include "membership.h"
+#include "membership_events.h"
 #include "recently_updated_set.h"
+#include "rumor_dict.h"
 
 namespace sw::gossip {
 
 struct GossipNetOptions {
+    // Unique id of this node in the cluster, e.g. a UUID string, which is at most
+    // NodeId::MAX_SIZE bytes.
+    std::string id;
+
+    // Its ip and port are advertised to other members as the address of this node,
+    // so it should be reachable by them, i.e. not a wildcard address.
     UdpServerOptions server_options;
 
     std::size_t lambda;
 
     std::size_t max_rumor_num;
+
+    // Byte budget of ping, ping-req and ack, which should fit into the path MTU to avoid
+    // IP fragmentation. Rumors are packed by encoded size until either the budget or
+    // `max_rumor_num` is reached. The default suits 1500-byte Ethernet MTU with IPv6.
+    std::size_t max_message_size = 1400;
+
+    // Max entries of the dictionary shared with each peer in binary format. Once the
+    // peer acks a member's entry, rumors about it carry an index instead of id, ip and
+    // port. It's used only if both sides enable it, and takes O(peers * size) memory.
+    // It's capped at RumorDictionary::MAX_CAPACITY. 0 disables it. All nodes should use
+    // the same size, since a peer with a larger one keeps sending rumors about members
+    // beyond our size in full.
+    std::size_t rumor_dictionary_size = 0;
+
+    // Ping, ping-req and ack larger than it are compressed, if that makes them smaller.
+    // Receivers always accept compressed messages, so enable it only after all nodes
+    // are upgraded. 0 disables it.
+    std::size_t compression_threshold = 0;
+
+    // Capabilities are advertised to a peer that hasn't replied every N protocol periods,
+    // since the advertisement, a UDP datagram, might be lost.
+    std::size_t caps_retry_periods = 10;
+
+    // After that many unanswered advertisements, the peer is assumed to only speak RESP,
+    // until it advertises capabilities itself.
+    std::size_t caps_max_attempts = 3;
+
+    // SWIM protocol period, in which a member is probed.
+    std::chrono::milliseconds protocol_period{1000};
+
+    // If the probed member doesn't ack in time, probe it indirectly with ping-req.
+    std::chrono::milliseconds ping_timeout{200};
+
+    // Number of members asked to ping the probed member.
+    std::size_t indirect_checks = 3;
+
+    // A suspected member is declared failed, if it doesn't refute in time.
+    std::chrono::milliseconds suspicion_timeout{5000};
+
+    // Number of UDP servers, each with its own event loop thread. If it's more than 1,
+    // servers bind to the same port with SO_REUSEPORT, and the kernel spreads
+    // incoming datagrams among them. Shard 0 owns the membership state, and other
+    // shards only decode requests, and forward the results to it.
+    std::size_t shard_num = 1;
+
+    // Capacity of the queue of messages decoded by other shards, and waiting for the
+    // owner shard, rounded up to power of 2. If it's full, these shards wait.
+    std::size_t message_queue_size = 1024;
+
+    // Full state synchronization over TCP, which listens on the same ip and port
+    // as the UDP server of the owner shard.
+    PushPullOptions push_pull_options;
+
+    // Membership snapshot is republished at most once per interval, if membership
+    // changes. Each publish copies the full state, so don't make it too small.
+    std::chrono::milliseconds snapshot_interval{100};
+
+    // Max batches of membership events waiting for delivery to listeners. If listeners
+    // fall behind, new batches are dropped.
+    std::size_t event_queue_size = 1024;
+};
+
+struct GossipNetStats {
+    // Number of ping, ping-req and ack messages.
+    std::size_t messages = 0;
+
+    // Total encoded size of these messages.
+    std::size_t message_bytes = 0;
+
+    // Total byte budget of these messages, i.e. messages * max_message_size.
+    std::size_t budget_bytes = 0;
+
+    // Number of rumors packed into these messages.
+    std::size_t rumors = 0;
+
+    // Number of messages exceeding the budget, e.g. a huge node id leaves no room.
+    std::size_t oversized_messages = 0;
+
+    // Number of messages sent compressed. `message_bytes` counts their size
+    // before compression, since rumors are packed by it.
+    std::size_t compressed_messages = 0;
+
+    // Number of rumors sent as dictionary index.
+    std::size_t dictionary_refs = 0;
+
+    // Number of received rumors dropped, since their dictionary index is unknown,
+    // or the message is too old to resolve them.
+    std::size_t dictionary_misses = 0;
+
+    // Number of membership events passed to listeners.
+    std::size_t events_delivered = 0;
+
+    // Number of membership events merged into, or cancelled by, a later event of
+    // the same member in the same batch.
+    std::size_t events_coalesced = 0;
+
+    // Number of membership events dropped, since listeners fall behind.
+    std::size_t events_dropped = 0;
+
+    // How much of the budget is used on average.
+    double fill_ratio() const {
+        return budget_bytes == 0 ? 0.0 : static_cast<double>(message_bytes) / budget_bytes;
+    }
 };
 
 class GossipNet {
@@ -44,36 +165,187 @@ public:
 
     ~GossipNet();
 
+    // Start event loop threads of all shards.
     void start();
 
+    // Stop event loops, and wait for their threads to exit. It cannot be restarted.
     void stop();
 
     void join(const std::string &ip, int port);
 
-    void update(std::vector<Node> rumors)
+    void update(std::vector<Node> rumors);
+
+    // Handlers of received messages, which run in the owner shard.
+    void on_ping(Node self, std::vector<Node> rumors);
+
+    void on_ping_req(Node self, Node peer, std::vector<Node> rumors);
+
+    void on_ack(Node self, std::vector<Node> rumors);
 
+    // The peer supports binary format with the given version.
+    void on_caps(const Node &self, uint64_t version);
+
+    // Merge the full state received from a peer. Nodes are merged in batches,
+    // and the remaining ones are merged in the following loop iterations. Membership
+    // snapshots are published once all merges in progress finish.
+    void merge(std::vector<Node> nodes);
+
+    // Get the full state, i.e. all members including itself.
+    std::vector<Node> state() const;
+
+    // Exchange the full state with a member.
+    void push_pull();
+
+    // Ask other members to ping the node, since it doesn't ack in time.
     void ping_req(const Node &node);
 
+    // Ping `dest` on behalf of `requester`, and relay the ack back to it.
+    void forward_ping(const Node &dest, const Node &requester);
+
+    // Mark the node as suspected, since it doesn't ack the indirect probe.
+    void suspect(const Node &node);
+
     void ack(const Node &dest);
 
     void ack(const Node &dest, const Node &self);
 
     void ping(const Node &dest);
 
-    void add(const std::string &id, std::unique_ptr<Task> task);
+    // Add a task waiting for an ack. If the ack is not received in time,
+    // the task is removed, and its `on_timeout` is called.
+    void add_task(TaskUPtr task, const std::chrono::milliseconds &timeout);
+
+    // Run tasks waiting for an ack from the given node.
+    void do_task(const NodeId &id);
+
+    // Thread-safe. Run the task in the event loop thread of the owner shard, i.e. the
+    // only thread that accesses membership state. If it's already in that thread,
+    // run the task inline.
+    void dispatch(std::function<void ()> task);
+
+    // Thread-safe. Handle a decoded message in the owner shard. Unlike the task version,
+    // it's queued without allocation, since it's the hot path of every received message.
+    void dispatch(Message msg);
 
-    void do_task(const std::string &id);
+    // Thread-safe.
+    GossipNetStats stats() const;
+
+    // Thread-safe, but not wait-free, see MembershipPublisher. Get the latest membership
+    // snapshot. Hot readers should cache it with a MembershipReader instead.
+    MembershipSnapshotPtr membership() const {
+        return _membership.snapshot();
+    }
+
+    // Thread-safe. Create a reader for a thread that reads membership at high rates.
+    // Each thread should have its own reader, which must not outlive GossipNet.
+    MembershipReader membership_reader() const {
+        return MembershipReader(_membership);
+    }
+
+    // Thread-safe. Listen to membership changes of other members, which are delivered
+    // in batches by a background thread. It should be called before start(), otherwise
+    // earlier changes are missed.
+    void subscribe(MembershipListener listener) {
+        _events.subscribe(std::move(listener));
+    }
 
 private:
-    void _append_node(RespReplyBuilder &builder,
-            const std::string &type,
-            const Node &node,
-            bool append_status = true);
+    // Benchmarks drive private members of an unstarted instance.
+    friend class GossipNetAccess;
+
+    void _register_commands(UdpServer &server);
+
+    // Pick rumors, which fit into the rest of a message to `dest` with the given header.
+    std::vector<Node> _build_rumors(const Node &dest,
+            MessageType type,
+            const Node &self,
+            const Node *peer);
+
+    // Bytes left for rumors in the given format.
+    std::size_t _rumor_budget(WireFormat format,
+            const Node &dest,
+            MessageType type,
+            const Node &self,
+            const Node *peer);
+
+    // Merge a batch of nodes, and defer the remaining ones to the next loop iteration.
+    void _merge(std::vector<Node> nodes);
+
+    // Probe a member, and schedule the next protocol period.
+    void _probe();
 
-    std::vector<Node> build_rumors();
+    // Members only become stable after their rumors are spread with pings, so right
+    // after joining, there might be nobody to probe. Pick a recently updated member
+    // instead, which is O(n), but only until some member becomes stable.
+    std::optional<Node> _probe_recent();
 
+    void _on_task_timeout(const Task &task);
+
+    void _on_suspicion_timeout(const Node &node);
+
+    // Schedule publishing a new membership snapshot, unless it's already scheduled.
+    void _on_membership_change();
+
+    // Add the event to the current batch, and schedule delivering the batch.
+    void _on_membership_event(MembershipEventType type, const Node &node);
+
+    // Get the cached address of `dest`, and cache it if it's a new peer.
+    PeerHandle _peer(const Node &dest);
+
+    // Format of a message sent to `dest` on behalf of `self`.
+    WireFormat _wire_format(const PeerHandle &dest, const Node &self) const;
+
+    // Get the dictionary shared with the peer, and create it if it doesn't exist.
+    RumorDictionary& _dict(const NodeId &id);
+
+    // Get the dictionary shared with the sender of a received message. It's created
+    // only for a known member, which has negotiated dictionary coding, so that
+    // messages with arbitrary sender ids never create one.
+    // @return nullptr, if there's no such member.
+    RumorDictionary* _sender_dict(const NodeId &id);
+
+    // Resolve rumors coded with dictionary, and drop those that cannot be resolved.
+    void _resolve(Message &msg);
+
+    // Decode in the receiving shard, and handle it in the owner shard.
+    void _on_binary(const std::string_view &buf);
+
+    // Handle a message in the owner shard.
+    void _on_message(Message &msg);
+
+    // Handle messages queued by other shards.
+    void _drain_messages();
+
+    // Encode the message in the format negotiated with `dest`, and send it.
+    void _send(const Node &dest,
+            MessageType type,
+            const Node &self,
+            const Node *peer,
+            const std::vector<Node> &rumors);
+
+    // Update stats with a message of the given size.
+    void _record(std::size_t size, std::size_t rumor_num);
+
+    // Send the message built in `buf` without copy, or the heap copy if it outgrows `buf`.
+    template <typename Builder>
+    void _send(const PeerHandle &peer, Builder &builder, SendBuffer &buf);
+
+    // Advertise the binary format. Peers that don't support it ignore the message.
+    void _send_caps(const PeerHandle &peer);
+
+    // Advertise capabilities to a peer whose format is unknown, if it's time to retry,
+    // or fall back to RESP, if it never replies.
+    void _negotiate(const PeerHandle &peer);
+
+    // The owner shard.
     UdpServer _server;
 
+    // Other shards, if any.
+    std::vector<std::unique_ptr<UdpServer>> _shards;
+
+    // It runs in the event loop of the owner shard.
+    std::unique_ptr<PushPull> _push_pull;
+
     Node _self;
 
     // alive and suspected members including itself.
@@ -84,11 +356,60 @@ private:
 
     GossipNetOptions _opts;
 
+    // Number of protocol periods since start.
+    uint64_t _period = 0;
+
     std::thread _server_thread;
 
+    std::vector<std::thread> _shard_threads;
+
+    // Messages decoded by other shards.
+    MpscQueue<Message> _messages;
+
+    // Whether a task draining `_messages` is posted to the owner shard, and not run yet.
+    std::atomic<bool> _drain_pending{false};
+
     std::mutex _mtx;
 
-    PendingLists<Task> _tasks;
+    PendingLists _tasks;
+
+    // Suspicion timers of suspected members.
+    std::unordered_map<NodeId, TimerHandle> _suspicions;
+
+    // Dictionaries shared with peers, keyed by peer id.
+    std::unordered_map<NodeId, RumorDictionary> _dicts;
+
+    // Generate dictionary epochs.
+    std::mt19937_64 _rng{std::random_device{}()};
+
+    MembershipPublisher _membership;
+
+    bool _snapshot_scheduled = false;
+
+    // Number of merges in progress, during which snapshots are not published.
+    std::size_t _merging = 0;
+
+    // Whether a snapshot is due once merges finish.
+    bool _snapshot_deferred = false;
+
+    MembershipEventStream _events;
+
+    bool _events_scheduled = false;
+
+    struct Stats {
+        GossipNetStats snapshot() const;
+
+        std::atomic<std::size_t> messages{0};
+        std::atomic<std::size_t> message_bytes{0};
+        std::atomic<std::size_t> budget_bytes{0};
+        std::atomic<std::size_t> rumors{0};
+        std::atomic<std::size_t> oversized_messages{0};
+        std::atomic<std::size_t> compressed_messages{0};
+        std::atomic<std::size_t> dictionary_refs{0};
+        std::atomic<std::size_t> dictionary_misses{0};
+    };
+
+    Stats _stats;
 };
 
 }
@@ -0,0 +1,151 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "logger.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+
+namespace sw::gossip {
+
+namespace {
+
+constexpr std::size_t LOG_QUEUE_SIZE = 1024;
+
+// How long the consumer sleeps when there's no record.
+constexpr std::chrono::milliseconds LOG_IDLE_INTERVAL(10);
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE:
+        return "TRACE";
+
+    case LogLevel::DEBUG:
+        return "DEBUG";
+
+    case LogLevel::INFO:
+        return "INFO";
+
+    case LogLevel::WARN:
+        return "WARN";
+
+    case LogLevel::ERROR:
+        return "ERROR";
+
+    default:
+        return "UNKNOWN";
+    }
+}
+
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+
+    return logger;
+}
+
+Logger::Logger() : _records(LOG_QUEUE_SIZE) {
+    _consumer = std::thread([this]() {
+                            _consume();
+                        });
+}
+
+Logger::~Logger() {
+    _stop.store(true, std::memory_order_release);
+
+    if (_consumer.joinable()) {
+        _consumer.join();
+    }
+}
+
+void Logger::log(LogLevel level, std::size_t suppressed, const char *fmt, ...) {
+    Record record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+
+    va_list args;
+    va_start(args, fmt);
+    auto len = std::vsnprintf(record.msg, MAX_MSG_SIZE, fmt, args);
+    va_end(args);
+
+    if (len < 0) {
+        return;
+    }
+
+    record.len = std::min(static_cast<std::size_t>(len), MAX_MSG_SIZE - 1);
+
+    if (suppressed > 0 && record.len < MAX_MSG_SIZE - 1) {
+        len = std::snprintf(record.msg + record.len, MAX_MSG_SIZE - record.len,
+                " (%zu similar messages suppressed)", suppressed);
+        if (len > 0) {
+            record.len = std::min(record.len + len, MAX_MSG_SIZE - 1);
+        }
+    }
+
+    if (!_records.try_push(record)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Logger::_consume() {
+    Record record;
+    while (true) {
+        if (!_records.try_pop(record)) {
+            if (_stop.load(std::memory_order_acquire)) {
+                break;
+            }
+
+            std::this_thread::sleep_for(LOG_IDLE_INTERVAL);
+            continue;
+        }
+
+        auto time = std::chrono::system_clock::to_time_t(record.time);
+        std::tm tm;
+        localtime_r(&time, &tm);
+        char time_str[32];
+        std::strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm);
+
+        std::fprintf(stderr, "%s [%s] %.*s\n", time_str, level_name(record.level),
+                static_cast<int>(record.len), record.msg);
+    }
+
+    std::fflush(stderr);
+}
+
+bool RateLimiter::allow(std::size_t &suppressed) {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    auto start = _window_start.load(std::memory_order_relaxed);
+    if (now - start >= _interval &&
+            _window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        // Start a new window.
+        _count.store(0, std::memory_order_relaxed);
+    }
+
+    if (_count.fetch_add(1, std::memory_order_relaxed) < _burst) {
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    _suppressed.fetch_add(1, std::memory_order_relaxed);
+
+    return false;
+}
+
+}
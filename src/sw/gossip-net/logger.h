@@ -0,0 +1,168 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_LOGGER_H
+#define SW_GOSSIP_NET_LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include "mpsc_queue.h"
+
+namespace sw::gossip {
+
+enum class LogLevel {
+    TRACE = 0,
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR,
+    OFF
+};
+
+}
+
+// Log statements below this level are compiled out, e.g. build with
+// -DSW_GOSSIP_NET_LOG_LEVEL=0 to enable TRACE logs, which are on the per-packet path.
+#ifndef SW_GOSSIP_NET_LOG_LEVEL
+#define SW_GOSSIP_NET_LOG_LEVEL 2 // LogLevel::INFO
+#endif
+
+namespace sw::gossip {
+
+// Asynchronous logger. Messages are formatted into fixed-size records, pushed to
+// a lock-free ring buffer, and written to stderr by a background thread.
+// Logging never blocks, and records are dropped if the ring buffer is full.
+class Logger {
+public:
+    static Logger& instance();
+
+    Logger(const Logger &) = delete;
+    Logger& operator=(const Logger &) = delete;
+
+    Logger(Logger &&) = delete;
+    Logger& operator=(Logger &&) = delete;
+
+    void set_level(LogLevel level) {
+        _level.store(level, std::memory_order_relaxed);
+    }
+
+    bool enabled(LogLevel level) const {
+        return level >= _level.load(std::memory_order_relaxed);
+    }
+
+    // `suppressed` is the number of similar messages discarded by rate limiting.
+    void log(LogLevel level, std::size_t suppressed, const char *fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    // Number of records dropped since the ring buffer is full.
+    std::size_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    Logger();
+
+    ~Logger();
+
+    void _consume();
+
+    // Long messages are truncated.
+    static constexpr std::size_t MAX_MSG_SIZE = 256;
+
+    struct Record {
+        LogLevel level = LogLevel::INFO;
+
+        std::chrono::system_clock::time_point time;
+
+        std::size_t len = 0;
+
+        char msg[MAX_MSG_SIZE];
+    };
+
+    std::atomic<LogLevel> _level{LogLevel::INFO};
+
+    std::atomic<std::size_t> _dropped{0};
+
+    MpscQueue<Record> _records;
+
+    std::atomic<bool> _stop{false};
+
+    std::thread _consumer;
+};
+
+// Allow at most `burst` messages per `interval`. Thread-safe.
+class RateLimiter {
+public:
+    RateLimiter(std::size_t burst, const std::chrono::milliseconds &interval) :
+        _burst(burst), _interval(interval.count()) {}
+
+    // @return true, if the message is allowed, and `suppressed` is set to
+    //         the number of messages discarded since the last allowed one.
+    bool allow(std::size_t &suppressed);
+
+private:
+    std::size_t _burst;
+
+    long long _interval;
+
+    std::atomic<long long> _window_start{0};
+
+    std::atomic<std::size_t> _count{0};
+
+    std::atomic<std::size_t> _suppressed{0};
+};
+
+}
+
+#define SW_GOSSIP_LOG(level, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= SW_GOSSIP_NET_LOG_LEVEL) { \
+            auto &sw_logger_ = ::sw::gossip::Logger::instance(); \
+            if (sw_logger_.enabled(level)) { \
+                sw_logger_.log(level, 0, __VA_ARGS__); \
+            } \
+        } \
+    } while (false)
+
+// Log at most `burst` messages per `interval_ms` from this statement.
+#define SW_GOSSIP_LOG_EVERY(level, burst, interval_ms, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= SW_GOSSIP_NET_LOG_LEVEL) { \
+            auto &sw_logger_ = ::sw::gossip::Logger::instance(); \
+            if (sw_logger_.enabled(level)) { \
+                static ::sw::gossip::RateLimiter sw_limiter_(burst, \
+                        std::chrono::milliseconds(interval_ms)); \
+                std::size_t sw_suppressed_ = 0; \
+                if (sw_limiter_.allow(sw_suppressed_)) { \
+                    sw_logger_.log(level, sw_suppressed_, __VA_ARGS__); \
+                } \
+            } \
+        } \
+    } while (false)
+
+#define SW_GOSSIP_LOG_TRACE(...) SW_GOSSIP_LOG(::sw::gossip::LogLevel::TRACE, __VA_ARGS__)
+#define SW_GOSSIP_LOG_DEBUG(...) SW_GOSSIP_LOG(::sw::gossip::LogLevel::DEBUG, __VA_ARGS__)
+#define SW_GOSSIP_LOG_INFO(...) SW_GOSSIP_LOG(::sw::gossip::LogLevel::INFO, __VA_ARGS__)
+#define SW_GOSSIP_LOG_WARN(...) SW_GOSSIP_LOG(::sw::gossip::LogLevel::WARN, __VA_ARGS__)
+#define SW_GOSSIP_LOG_ERROR(...) SW_GOSSIP_LOG(::sw::gossip::LogLevel::ERROR, __VA_ARGS__)
+
+// Errors that might repeat on the per-packet path, at most 10 messages per second.
+#define SW_GOSSIP_LOG_ERROR_RL(...) \
+    SW_GOSSIP_LOG_EVERY(::sw::gossip::LogLevel::ERROR, 10, 1000, __VA_ARGS__)
+
+#endif // end SW_GOSSIP_NET_LOGGER_H
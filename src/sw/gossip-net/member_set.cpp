@@ -14,33 +14,51 @@
    limitations under the License.
  *************************************************************************/
 
+
 #include "member_set.h"
-#include <random>
+#include <cassert>
+#include <cstring>
+#include <utility>
 
 namespace sw::gossip {
 
-MemberSet::MemberSet() :
-    _iter(_members.end()),
-    _random_key_prefix(_gen_random_key_prefix()) {
+namespace {
+
+constexpr std::size_t INIT_SLOT_NUM = 64;
+
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x;
 }
 
-std::optional<Node> MemberSet::try_update(Node node) {
-    auto key = _build_key(node.id);
+}
 
-    auto iter = _members.find(key);
-    if (iter == _members.end()) {
+MemberSet::MemberSet() :
+    _slots(INIT_SLOT_NUM),
+    _rng(std::random_device{}()),
+    _seed(_rng()) {
+}
+
+std::optional<Node> MemberSet::try_update(Node node, std::optional<NodeStatus> &prev) {
+    auto hash = _hash(node.id);
+    auto pos = _find(node.id, hash);
+    auto idx = _slots[pos].index;
+    if (idx == NIL) {
+        prev = std::nullopt;
         return std::optional<Node>(std::move(node));
     }
 
-    auto &member = iter->second;
-    if (member < node) {
+    if (outdated(_states[idx].status, _states[idx].version, node.status, node.version)) {
+        prev = _states[idx].status;
+
         // Should update node info
         // Remove it from stable member set.
-        if (iter == _iter) {
-            _iter = _members.erase(iter);
-        } else {
-            _members.erase(iter);
-        }
+        _erase(pos);
 
         return std::optional<Node>(std::move(node));
     }
@@ -50,56 +68,253 @@ std::optional<Node> MemberSet::try_update(Node node) {
 }
 
 void MemberSet::add(Node node) {
-    auto key = _build_key(node.id);
+    // Keep load factor below 3/4.
+    if ((_order.size() + 1) * 4 > _slots.size() * 3) {
+        _grow();
+    }
+
+    auto hash = _hash(node.id);
+    auto pos = _find(node.id, hash);
+
+    assert(_slots[pos].index == NIL);
+
+    Index idx = 0;
+    if (!_free.empty()) {
+        idx = _free.back();
+        _free.pop_back();
+
+        _ids[idx] = node.id;
+        _ips[idx] = node.ip;
+        _ports[idx] = node.port;
+        _states[idx] = State{node.version, node.status};
+    } else {
+        idx = static_cast<Index>(_ids.size());
+
+        _ids.push_back(node.id);
+        _ips.push_back(node.ip);
+        _ports.push_back(node.port);
+        _states.push_back(State{node.version, node.status});
+        _positions.push_back(NIL);
+    }
+
+    _slots[pos] = Slot{hash, idx};
+
+    // Swap it with a random member that hasn't been probed in this round, or itself.
+    std::uniform_int_distribution<std::size_t> dist(_probe_cursor, _order.size());
+    auto order_pos = dist(_rng);
+    if (order_pos != _order.size()) {
+        auto other = _order[order_pos];
+        _positions[other] = static_cast<Index>(_order.size());
+        _order.push_back(other);
+        _order[order_pos] = idx;
+    } else {
+        _order.push_back(idx);
+    }
+    _positions[idx] = static_cast<Index>(order_pos);
+}
 
-    assert(_members.find(key) == _members.end());
+std::optional<Node> MemberSet::probe() {
+    if (_order.empty()) {
+        return std::nullopt;
+    }
+
+    if (_probe_cursor >= _order.size()) {
+        // Start another round in a new random order.
+        _shuffle();
+        _probe_cursor = 0;
+    }
 
-    _members.emplace(key, std::move(node));
+    auto node = _node(_order[_probe_cursor]);
+    ++_probe_cursor;
+
+    return std::optional<Node>(node);
 }
 
 std::vector<Node> MemberSet::fetch(std::size_t num) {
-    if (num > _members.size()) {
-        return _fetch_all();
+    if (num >= _order.size()) {
+        return all();
     } else {
         return _fetch(num);
     }
 }
 
-std::vector<Node> MemberSet::_fetch_all() {
+std::vector<Node> MemberSet::fetch(std::size_t num,
+        std::size_t &budget,
+        const NodeSize &node_size) {
+    std::vector<Node> result;
+    if (num == 0 || _order.empty()) {
+        return result;
+    }
+
+    // Visit each member at most once, and give up after skipping `num` members,
+    // since members are similar in size, and the rest most likely don't fit either.
+    std::size_t skipped = 0;
+    for (auto idx = 0U; idx != _order.size() && result.size() != num; ++idx) {
+        if (_cursor >= _order.size()) {
+            _cursor = 0;
+        }
+
+        auto node = _node(_order[_cursor]);
+        ++_cursor;
+
+        auto size = node_size(node);
+        if (size > budget) {
+            if (++skipped == num) {
+                break;
+            }
+
+            continue;
+        }
+
+        budget -= size;
+        result.push_back(node);
+    }
+
+    return result;
+}
+
+std::vector<Node> MemberSet::all() const {
     std::vector<Node> result;
-    result.reserve(_members.size());
-    for (const auto &ele : _members) {
-        result.push_back(ele.second);
+    result.reserve(_order.size());
+    for (auto idx : _order) {
+        result.push_back(_node(idx));
     }
 
     return result;
 }
 
+bool MemberSet::contains(const NodeId &id) const {
+    return _slots[_find(id, _hash(id))].index != NIL;
+}
+
+uint32_t MemberSet::_hash(const NodeId &id) const {
+    auto view = id.view();
+    auto *ptr = view.data();
+    auto len = view.size();
+    auto hash = _seed ^ len;
+    while (len >= 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, ptr, 8);
+        hash = mix(hash ^ word);
+        ptr += 8;
+        len -= 8;
+    }
+
+    uint64_t word = 0;
+    std::memcpy(&word, ptr, len);
+
+    return static_cast<uint32_t>(mix(hash ^ word));
+}
+
+std::size_t MemberSet::_find(const NodeId &id, uint32_t hash) const {
+    auto mask = _slots.size() - 1;
+    for (auto pos = hash & mask; ; pos = (pos + 1) & mask) {
+        const auto &slot = _slots[pos];
+        if (slot.index == NIL || (slot.hash == hash && _ids[slot.index] == id)) {
+            return pos;
+        }
+    }
+}
+
+void MemberSet::_erase(std::size_t pos) {
+    auto idx = _slots[pos].index;
+
+    // Swap remove it from the probe order. If it has been probed in this round, fill
+    // the hole with the last probed one, so that unprobed ones are not skipped.
+    auto order_pos = _positions[idx];
+    if (order_pos < _probe_cursor) {
+        --_probe_cursor;
+        auto probed = _order[_probe_cursor];
+        _order[order_pos] = probed;
+        _positions[probed] = order_pos;
+        order_pos = static_cast<Index>(_probe_cursor);
+    }
+
+    if (order_pos + 1 != _order.size()) {
+        auto last = _order.back();
+        _order[order_pos] = last;
+        _positions[last] = order_pos;
+    }
+    _order.pop_back();
+
+    _positions[idx] = NIL;
+    _free.push_back(idx);
+
+    // Backward shift deletion, so that no tombstone is needed.
+    auto mask = _slots.size() - 1;
+    auto hole = pos;
+    for (auto next = (hole + 1) & mask; _slots[next].index != NIL; next = (next + 1) & mask) {
+        auto home = _slots[next].hash & mask;
+        // Move it to the hole, if the hole is between its home and its current slot.
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            _slots[hole] = _slots[next];
+            hole = next;
+        }
+    }
+
+    _slots[hole] = Slot{};
+}
+
+void MemberSet::_grow() {
+    std::vector<Slot> slots(_slots.size() * 2);
+    auto mask = slots.size() - 1;
+    for (const auto &slot : _slots) {
+        if (slot.index == NIL) {
+            continue;
+        }
+
+        auto pos = slot.hash & mask;
+        while (slots[pos].index != NIL) {
+            pos = (pos + 1) & mask;
+        }
+
+        slots[pos] = slot;
+    }
+
+    _slots.swap(slots);
+}
+
+Node MemberSet::_node(Index idx) const {
+    Node node;
+    node.id = _ids[idx];
+    node.ip = _ips[idx];
+    node.port = _ports[idx];
+    node.version = _states[idx].version;
+    node.status = _states[idx].status;
+
+    return node;
+}
+
+void MemberSet::_shuffle() {
+    for (auto pos = _order.size(); pos > 1; --pos) {
+        std::uniform_int_distribution<std::size_t> dist(0, pos - 1);
+        std::swap(_order[pos - 1], _order[dist(_rng)]);
+    }
+
+    for (std::size_t pos = 0; pos != _order.size(); ++pos) {
+        _positions[_order[pos]] = static_cast<Index>(pos);
+    }
+}
+
 std::vector<Node> MemberSet::_fetch(std::size_t num) {
     if (num == 0) {
         return {};
     }
 
-    assert(num < _members.size());
+    assert(num < _order.size());
 
     std::vector<Node> result;
     result.reserve(num);
     for (auto idx = 0U; idx != num; ++idx) {
-        if (_iter == _members.end()) {
-            _iter = _members.begin();
+        if (_cursor >= _order.size()) {
+            _cursor = 0;
         }
 
-        result.push_back(_iter->second);
-        ++_iter;
+        result.push_back(_node(_order[_cursor]));
+        ++_cursor;
     }
 
     return result;
 }
 
-std::string MemberSet::_gen_random_key_prefix() {
-    std::random_device rd;
-
-    return std::to_string(rd());
-}
-
 }
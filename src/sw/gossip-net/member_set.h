@@ -14,44 +14,116 @@
    limitations under the License.
  *************************************************************************/
 
+
 #ifndef SW_GOSSIP_NET_MEMBER_SET_H
 #define SW_GOSSIP_NET_MEMBER_SET_H
 
-#include <unordered_map>
-#include <string>
+#include <cstdint>
+#include <limits>
 #include <optional>
+#include <random>
+#include <vector>
 #include "utils.h"
 
 namespace sw::gossip {
 
+// Stable members. Each member is interned into a dense index on add, and its info
+// is stored in a struct-of-arrays layout. Ids are looked up with an open addressing
+// table, so that updates on the receive path don't allocate.
 class MemberSet {
 public:
     MemberSet();
 
     // If try_update returns a valid node, add it to recently updated set.
-    std::optional<Node> try_update(Node node);
+    // `prev` is set to the status of the replaced member, or std::nullopt if it's unknown.
+    std::optional<Node> try_update(Node node, std::optional<NodeStatus> &prev);
 
     void add(Node node);
 
+    // Next member to probe. Members are probed in round robin of a random order, which
+    // is reshuffled after each round. So a member is probed exactly once per round,
+    // and a failed one is detected in at most one round. A new member is inserted at
+    // a random position that hasn't been probed in the current round.
+    std::optional<Node> probe();
+
     std::vector<Node> fetch(std::size_t num);
 
-private:
-    std::string _gen_random_key_prefix() const;
+    // Fetch at most `num` members in round robin, whose total size doesn't exceed
+    // `budget`, which is decreased accordingly. Members that don't fit are skipped,
+    // and it stops after skipping `num` members.
+    std::vector<Node> fetch(std::size_t num, std::size_t &budget, const NodeSize &node_size);
 
-    std::string _build_key(const std::string &key) const {
-        return _random_key_prefix + key;
+    // Get all members, e.g. for full state synchronization.
+    std::vector<Node> all() const;
+
+    bool contains(const NodeId &id) const;
+
+    std::size_t size() const {
+        return _order.size();
     }
 
-    std::vector<Node> _fetch_all();
+private:
+    using Index = uint32_t;
+
+    static constexpr Index NIL = std::numeric_limits<Index>::max();
+
+    struct Slot {
+        // Low bits of the id hash, with which probing skips most string comparisons,
+        // and growing doesn't need to rehash ids.
+        uint32_t hash = 0;
+
+        Index index = NIL;
+    };
+
+    uint32_t _hash(const NodeId &id) const;
+
+    // Position of the slot holding `id`, or the empty slot where it should be inserted.
+    std::size_t _find(const NodeId &id, uint32_t hash) const;
+
+    void _erase(std::size_t pos);
+
+    void _grow();
+
+    Node _node(Index idx) const;
+
+    void _shuffle();
 
     std::vector<Node> _fetch(std::size_t num);
 
-    using Map = std::unordered_map<std::string, Node>;
-    Map _members;
+    std::vector<Slot> _slots;
+
+    // Member info indexed by member index.
+    std::vector<NodeId> _ids;
+    std::vector<IpAddress> _ips;
+    std::vector<uint16_t> _ports;
+
+    // Version and status are kept together, since they're compared together on update.
+    struct State {
+        uint64_t version;
+        NodeStatus status;
+    };
+
+    std::vector<State> _states;
+
+    // Position of each member in `_order`.
+    std::vector<Index> _positions;
+
+    // Indexes of removed members, which are reused by new members.
+    std::vector<Index> _free;
+
+    // Indexes of members in a random order, which is walked in round robin.
+    std::vector<Index> _order;
+
+    // Position in `_order` of the next member to probe.
+    std::size_t _probe_cursor = 0;
+
+    // Position in `_order` of the next member to fetch.
+    std::size_t _cursor = 0;
 
-    Map::iterator _iter;
+    std::mt19937_64 _rng;
 
-    std::string _random_key_prefix;
+    // Random seed of the id hash, so that peers cannot flood a slot chain.
+    uint64_t _seed;
 };
 
 }
@@ -0,0 +1,88 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+
+#include "membership.h"
+#include <algorithm>
+#include <utility>
+
+namespace sw::gossip {
+
+MembershipSnapshot::MembershipSnapshot(std::vector<Node> nodes, uint64_t version) :
+    _nodes(std::move(nodes)),
+    _version(version) {
+    // Group nodes by status with a counting sort, so that each status is a range.
+    std::array<std::size_t, STATUS_NUM> counts = {};
+    for (const auto &node : _nodes) {
+        ++counts[static_cast<std::size_t>(node.status)];
+    }
+
+    for (std::size_t idx = 1; idx != _offsets.size(); ++idx) {
+        _offsets[idx] = _offsets[idx - 1] + counts[idx - 1];
+    }
+
+    auto next = _offsets;
+    std::vector<Node> sorted(_nodes.size());
+    for (const auto &node : _nodes) {
+        sorted[next[static_cast<std::size_t>(node.status)]++] = node;
+    }
+    _nodes.swap(sorted);
+
+    _index.reserve(_nodes.size());
+    for (std::size_t idx = 0; idx != _nodes.size(); ++idx) {
+        _index.emplace(_nodes[idx].id, idx);
+    }
+}
+
+const Node* MembershipSnapshot::find(const NodeId &id) const {
+    auto iter = _index.find(id);
+    if (iter == _index.end()) {
+        return nullptr;
+    }
+
+    return &_nodes[iter->second];
+}
+
+ArrayView<Node> MembershipSnapshot::members(NodeStatus status) const {
+    auto idx = static_cast<std::size_t>(status);
+    if (idx >= STATUS_NUM) {
+        return {};
+    }
+
+    return ArrayView<Node>(_nodes.data() + _offsets[idx], _offsets[idx + 1] - _offsets[idx]);
+}
+
+MembershipPublisher::MembershipPublisher() :
+    _snapshot(std::make_shared<const MembershipSnapshot>()) {
+}
+
+void MembershipPublisher::publish(std::vector<Node> nodes) {
+    auto version = _version.load(std::memory_order_relaxed) + 1;
+    MembershipSnapshotPtr snapshot = std::make_shared<const MembershipSnapshot>(std::move(nodes),
+            version);
+
+    // The previous snapshot is freed out of lock, if no reader refers to it.
+    snapshot = std::atomic_exchange(&_snapshot, std::move(snapshot));
+
+    _version.store(version, std::memory_order_release);
+}
+
+MembershipReader::MembershipReader(const MembershipPublisher &publisher) :
+    _publisher(&publisher),
+    _snapshot(publisher.snapshot()) {
+}
+
+}
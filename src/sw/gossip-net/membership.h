@@ -0,0 +1,128 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+
+#ifndef SW_GOSSIP_NET_MEMBERSHIP_H
+#define SW_GOSSIP_NET_MEMBERSHIP_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "utils.h"
+
+namespace sw::gossip {
+
+// Immutable view of the membership, which can be read from any thread.
+class MembershipSnapshot {
+public:
+    MembershipSnapshot() = default;
+
+    MembershipSnapshot(std::vector<Node> nodes, uint64_t version);
+
+    // @return nullptr, if the node is unknown.
+    const Node* find(const NodeId &id) const;
+
+    // Nodes with the given status, e.g. alive ones.
+    ArrayView<Node> members(NodeStatus status) const;
+
+    // All nodes, ordered by status.
+    ArrayView<Node> all() const {
+        return ArrayView<Node>(_nodes.data(), _nodes.size());
+    }
+
+    std::size_t size() const {
+        return _nodes.size();
+    }
+
+    // Increased each time a snapshot is published.
+    uint64_t version() const {
+        return _version;
+    }
+
+private:
+    static constexpr std::size_t STATUS_NUM = static_cast<std::size_t>(NodeStatus::UNKNOWN) + 1;
+
+    std::vector<Node> _nodes;
+
+    // Nodes with status S are in [_offsets[S], _offsets[S + 1]).
+    std::array<std::size_t, STATUS_NUM + 1> _offsets = {};
+
+    // Node id => index in `_nodes`.
+    std::unordered_map<NodeId, std::size_t> _index;
+
+    uint64_t _version = 0;
+};
+
+using MembershipSnapshotPtr = std::shared_ptr<const MembershipSnapshot>;
+
+// Snapshots are built and published by the event loop thread, and the previous one is
+// freed once no reader refers to it, i.e. in RCU style. The pointer is accessed with
+// std::atomic_load/atomic_exchange, which libstdc++ implements with a small pool of
+// mutexes hashed by address. So it's not wait-free, but a lock is only held for a
+// reference count update, and never while building or freeing a snapshot.
+class MembershipPublisher {
+public:
+    MembershipPublisher();
+
+    // Event loop thread only. Build a snapshot of `nodes`, and publish it.
+    void publish(std::vector<Node> nodes);
+
+    // Thread-safe, but not wait-free. Get the latest snapshot.
+    MembershipSnapshotPtr snapshot() const {
+        return std::atomic_load(&_snapshot);
+    }
+
+    // Thread-safe. Version of the latest snapshot.
+    uint64_t version() const {
+        return _version.load(std::memory_order_acquire);
+    }
+
+private:
+    // Only accessed with atomic shared_ptr operations.
+    MembershipSnapshotPtr _snapshot;
+
+    std::atomic<uint64_t> _version{0};
+};
+
+// Cache of the latest snapshot, which should be owned by a single reader thread.
+// Readers only share a version counter in steady state, so that they never contend
+// with each other, or with the publisher.
+class MembershipReader {
+public:
+    explicit MembershipReader(const MembershipPublisher &publisher);
+
+    // Wait-free, unless a new snapshot has been published since the last call.
+    // The returned snapshot is kept alive until the next call.
+    const MembershipSnapshot& acquire() {
+        if (_publisher->version() != _snapshot->version()) {
+            _snapshot = _publisher->snapshot();
+        }
+
+        return *_snapshot;
+    }
+
+private:
+    const MembershipPublisher *_publisher;
+
+    MembershipSnapshotPtr _snapshot;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_MEMBERSHIP_H
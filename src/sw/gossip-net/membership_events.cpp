@@ -0,0 +1,225 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "membership_events.h"
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include "logger.h"
+
+namespace sw::gossip {
+
+namespace {
+
+// The consumer is woken up by flush() and on stop, and the timeout is never relied on.
+// A timed wait only keeps it off condition_variable::wait(), which needs GLIBCXX_3.4.30
+// when built with GCC 12, so that it still runs with older libstdc++ runtimes.
+constexpr std::chrono::seconds EVENT_WAIT_TIMEOUT(1);
+
+// Status of a member before the event, or UNKNOWN if it's not a member. std::nullopt,
+// if it cannot be told, i.e. a member fails from either ALIVE or SUSPECTED.
+std::optional<NodeStatus> status_before(MembershipEventType type) {
+    switch (type) {
+    case MembershipEventType::JOIN:
+        return NodeStatus::UNKNOWN;
+
+    case MembershipEventType::ALIVE:
+        return NodeStatus::SUSPECTED;
+
+    case MembershipEventType::SUSPECT:
+        return NodeStatus::ALIVE;
+
+    case MembershipEventType::LEAVE:
+        return NodeStatus::FAILED;
+
+    default:
+        return std::nullopt;
+    }
+}
+
+// Status of a member after the event, or UNKNOWN if it's removed.
+NodeStatus status_after(MembershipEventType type, const Node &node) {
+    return type == MembershipEventType::LEAVE ? NodeStatus::UNKNOWN : node.status;
+}
+
+}
+
+std::optional<MembershipEventType> membership_event(const std::optional<NodeStatus> &prev,
+        NodeStatus status) {
+    switch (status) {
+    case NodeStatus::ALIVE:
+        if (!prev) {
+            return MembershipEventType::JOIN;
+        }
+
+        if (*prev == NodeStatus::SUSPECTED) {
+            return MembershipEventType::ALIVE;
+        }
+
+        break;
+
+    case NodeStatus::SUSPECTED:
+        if (!prev) {
+            return MembershipEventType::JOIN;
+        }
+
+        if (*prev == NodeStatus::ALIVE) {
+            return MembershipEventType::SUSPECT;
+        }
+
+        break;
+
+    case NodeStatus::FAILED:
+        // Ignore failed members that nobody has seen alive.
+        if (prev && *prev != NodeStatus::FAILED) {
+            return MembershipEventType::FAILED;
+        }
+
+        break;
+
+    default:
+        break;
+    }
+
+    return std::nullopt;
+}
+
+MembershipEventStream::MembershipEventStream(std::size_t queue_size) :
+    _batches(queue_size),
+    _listeners(std::make_shared<const Listeners>()) {}
+
+MembershipEventStream::~MembershipEventStream() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stop = true;
+    }
+    _cv.notify_one();
+
+    if (_consumer.joinable()) {
+        _consumer.join();
+    }
+}
+
+void MembershipEventStream::subscribe(MembershipListener listener) {
+    if (!listener) {
+        throw Error("null membership listener");
+    }
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto listeners = std::make_shared<Listeners>(*_listeners);
+    listeners->push_back(std::move(listener));
+    _listeners = std::move(listeners);
+
+    if (!_consumer.joinable()) {
+        _consumer = std::thread([this]() {
+                                _consume();
+                            });
+    }
+
+    _subscribed.store(true, std::memory_order_release);
+}
+
+void MembershipEventStream::add(MembershipEventType type, const Node &node) {
+    auto iter = _batch_index.find(node.id);
+    if (iter == _batch_index.end()) {
+        _batch_index.emplace(node.id, BatchEntry{_batch.size(), type});
+        _batch.push_back(MembershipEvent{type, node});
+        return;
+    }
+
+    auto [pos, first] = iter->second;
+    auto &event = _batch[pos];
+    if (status_before(first) == status_after(type, node)) {
+        // Swap remove it, since the order of members in a batch doesn't matter.
+        _batch_index.erase(iter);
+        if (pos + 1 != _batch.size()) {
+            event = _batch.back();
+            _batch_index.at(event.node.id).pos = pos;
+        }
+        _batch.pop_back();
+
+        // Both this event, and the one that earlier events have been merged into.
+        _coalesced.fetch_add(2, std::memory_order_relaxed);
+        return;
+    }
+
+    // Listeners haven't seen the member joined yet.
+    if (first != MembershipEventType::JOIN) {
+        event.type = type;
+    }
+
+    event.node = node;
+
+    _coalesced.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MembershipEventStream::flush() {
+    if (_batch.empty()) {
+        return;
+    }
+
+    auto num = _batch.size();
+    if (!_batches.try_push(_batch)) {
+        _dropped.fetch_add(num, std::memory_order_relaxed);
+    } else if (_pending.fetch_add(1, std::memory_order_release) == 0) {
+        // Only wake up the consumer when the queue becomes non-empty, since it
+        // drains the queue before waiting again.
+        std::lock_guard<std::mutex> lock(_mtx);
+        _cv.notify_one();
+    }
+
+    _batch.clear();
+    _batch_index.clear();
+}
+
+void MembershipEventStream::_consume() {
+    std::vector<MembershipEvent> batch;
+    while (true) {
+        ListenersPtr listeners;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            auto ready = [this]() {
+                return _pending.load(std::memory_order_acquire) > 0 || _stop;
+            };
+            while (!_cv.wait_for(lock, EVENT_WAIT_TIMEOUT, ready)) {}
+
+            // Deliver queued batches before stopping.
+            if (_pending.load(std::memory_order_acquire) == 0) {
+                break;
+            }
+
+            listeners = _listeners;
+        }
+
+        auto popped = _batches.try_pop(batch);
+        assert(popped);
+        (void)popped;
+        _pending.fetch_sub(1, std::memory_order_relaxed);
+
+        for (const auto &listener : *listeners) {
+            try {
+                listener(batch);
+            } catch (const std::exception &e) {
+                SW_GOSSIP_LOG_ERROR("membership listener failed: %s", e.what());
+            }
+        }
+
+        _delivered.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+}
+
+}
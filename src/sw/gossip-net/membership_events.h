@@ -0,0 +1,167 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_MEMBERSHIP_EVENTS_H
+#define SW_GOSSIP_NET_MEMBERSHIP_EVENTS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "spsc_queue.h"
+#include "utils.h"
+
+namespace sw::gossip {
+
+enum class MembershipEventType : uint8_t {
+    // A member is seen for the first time, or again after it's removed.
+    JOIN = 0,
+
+    // A member refutes the suspicion.
+    ALIVE,
+
+    SUSPECT,
+
+    FAILED,
+
+    // A failed member is removed from the membership.
+    LEAVE
+};
+
+struct MembershipEvent {
+    MembershipEventType type = MembershipEventType::JOIN;
+
+    // The latest state of the member.
+    Node node;
+};
+
+// Event of a member whose status changes from `prev` to `status`. `prev` is std::nullopt,
+// if the member is unknown. Returns std::nullopt, if it's not worth an event, e.g. only
+// the version changes.
+std::optional<MembershipEventType> membership_event(const std::optional<NodeStatus> &prev,
+        NodeStatus status);
+
+// Called with a batch of events, in which each member appears at most once.
+using MembershipListener = std::function<void (const std::vector<MembershipEvent> &events)>;
+
+// Events are collected by the event loop thread into a batch, which is pushed to
+// a bounded ring buffer, and delivered to listeners by a background thread. So a
+// slow listener never stalls the event loop, and batches are dropped instead if
+// the ring buffer is full.
+class MembershipEventStream {
+public:
+    // `queue_size` is the max number of batches waiting for delivery.
+    explicit MembershipEventStream(std::size_t queue_size);
+
+    MembershipEventStream(const MembershipEventStream &) = delete;
+    MembershipEventStream& operator=(const MembershipEventStream &) = delete;
+
+    MembershipEventStream(MembershipEventStream &&) = delete;
+    MembershipEventStream& operator=(MembershipEventStream &&) = delete;
+
+    // Deliver the queued batches, and stop the background thread.
+    ~MembershipEventStream();
+
+    // Thread-safe. Listeners are called in the background thread, in the order
+    // they subscribe. The thread is started by the first subscription.
+    void subscribe(MembershipListener listener);
+
+    // Thread-safe. Events are not worth collecting, if nobody listens.
+    bool subscribed() const {
+        return _subscribed.load(std::memory_order_acquire);
+    }
+
+    // Event loop thread only. If the member is already in the current batch, events
+    // are merged. If the member ends up in the status it had before the batch, e.g. a
+    // suspicion is refuted, or it joins and leaves, the events cancel each other. A
+    // batch starting with JOIN stays JOIN with the latest state, since listeners
+    // haven't seen the member yet. Otherwise, the latest event wins.
+    void add(MembershipEventType type, const Node &node);
+
+    // Event loop thread only. Push the current batch to the background thread.
+    void flush();
+
+    // Thread-safe. Number of events passed to listeners.
+    std::size_t delivered() const {
+        return _delivered.load(std::memory_order_relaxed);
+    }
+
+    // Thread-safe. Number of events merged into, or cancelled by, a later event of
+    // the same member. Each added event is either delivered, coalesced or dropped.
+    std::size_t coalesced() const {
+        return _coalesced.load(std::memory_order_relaxed);
+    }
+
+    // Thread-safe. Number of events dropped, since the ring buffer is full.
+    std::size_t dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void _consume();
+
+    using Listeners = std::vector<MembershipListener>;
+
+    using ListenersPtr = std::shared_ptr<const Listeners>;
+
+    SpscQueue<std::vector<MembershipEvent>> _batches;
+
+    struct BatchEntry {
+        // Index in the current batch.
+        std::size_t pos;
+
+        // The first event of the member in the batch, which tells its status before it.
+        MembershipEventType first;
+    };
+
+    // The current batch, and member id => its entry.
+    std::vector<MembershipEvent> _batch;
+    std::unordered_map<NodeId, BatchEntry> _batch_index;
+
+    // Replaced on each subscription, so that listeners are called without the lock,
+    // and they can subscribe more listeners.
+    ListenersPtr _listeners;
+
+    // Protects `_listeners` and `_stop`, and pairs with `_cv`.
+    std::mutex _mtx;
+
+    // Signaled when the queue becomes non-empty, or on stop.
+    std::condition_variable _cv;
+
+    // Number of batches in the queue.
+    std::atomic<std::size_t> _pending{0};
+
+    std::atomic<bool> _subscribed{false};
+
+    bool _stop = false;
+
+    std::thread _consumer;
+
+    std::atomic<std::size_t> _delivered{0};
+    std::atomic<std::size_t> _coalesced{0};
+    std::atomic<std::size_t> _dropped{0};
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_MEMBERSHIP_EVENTS_H
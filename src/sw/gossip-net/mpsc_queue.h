@@ -0,0 +1,148 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_MPSC_QUEUE_H
+#define SW_GOSSIP_NET_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "errors.h"
+
+namespace sw::gossip {
+
+// What to do when pushing to a full queue.
+enum class OverflowPolicy {
+    // Wait until there's free space.
+    BLOCK = 0,
+
+    // Discard the item being pushed.
+    DROP_NEWEST,
+
+    // Discard the oldest item in queue, and push the new one.
+    DROP_OLDEST
+};
+
+// Bounded lock-free queue based on Dmitry Vyukov's bounded MPMC queue:
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// It's used with multiple producers and a single consumer. However, `try_pop`
+// is also safe to be called by producers, which is required by OverflowPolicy::DROP_OLDEST.
+template <typename T>
+class MpscQueue {
+public:
+    // `capacity` is rounded up to power of 2.
+    explicit MpscQueue(std::size_t capacity) {
+        if (capacity == 0) {
+            throw Error("queue capacity should be positive");
+        }
+
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _cells = std::make_unique<Cell[]>(size);
+        _mask = size - 1;
+        for (std::size_t idx = 0; idx != size; ++idx) {
+            _cells[idx].seq.store(idx, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue& operator=(const MpscQueue &) = delete;
+
+    MpscQueue(MpscQueue &&) = delete;
+    MpscQueue& operator=(MpscQueue &&) = delete;
+
+    ~MpscQueue() = default;
+
+    // @return false if queue is full, and `item` is NOT moved.
+    bool try_push(T &item) {
+        auto pos = _enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full.
+                return false;
+            } else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // @return false if queue is empty.
+    bool try_pop(T &item) {
+        auto pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell = nullptr;
+        while (true) {
+            cell = &_cells[pos & _mask];
+            auto seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Empty.
+                return false;
+            } else {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        item = std::move(cell->data);
+        cell->seq.store(pos + _mask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    std::size_t capacity() const {
+        return _mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        T data;
+    };
+
+    // Avoid false sharing between producers and the consumer.
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    std::unique_ptr<Cell[]> _cells;
+
+    std::size_t _mask = 0;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> _enqueue_pos{0};
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> _dequeue_pos{0};
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_MPSC_QUEUE_H
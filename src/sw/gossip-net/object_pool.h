@@ -0,0 +1,97 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_OBJECT_POOL_H
+#define SW_GOSSIP_NET_OBJECT_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "errors.h"
+
+namespace sw::gossip {
+
+// Free-list allocator of objects, which are carved from slabs of `slab_size` objects.
+// Objects are default constructed with the slab, and are reused without destruction,
+// so callers should reset their state before releasing them.
+// NOT thread-safe, and should only be used in the event loop thread.
+template <typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(std::size_t slab_size) : _slab_size(slab_size) {
+        if (_slab_size == 0) {
+            throw Error("invalid object pool size");
+        }
+
+        _expand();
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool& operator=(const ObjectPool &) = delete;
+
+    ObjectPool(ObjectPool &&) = default;
+    ObjectPool& operator=(ObjectPool &&) = default;
+
+    ~ObjectPool() = default;
+
+    // Allocate another slab, if all objects are in use.
+    T* acquire() {
+        if (_free_list.empty()) {
+            _expand();
+        }
+
+        assert(!_free_list.empty());
+
+        auto *obj = _free_list.back();
+        _free_list.pop_back();
+
+        return obj;
+    }
+
+    void release(T *obj) {
+        assert(obj != nullptr);
+
+        _free_list.push_back(obj);
+    }
+
+    // Number of slabs allocated, including the one allocated by constructor.
+    std::size_t slab_num() const {
+        return _slabs.size();
+    }
+
+private:
+    void _expand() {
+        auto slab = std::make_unique<T[]>(_slab_size);
+
+        _free_list.reserve(_free_list.size() + _slab_size);
+        for (auto idx = _slab_size; idx != 0; --idx) {
+            _free_list.push_back(slab.get() + idx - 1);
+        }
+
+        _slabs.push_back(std::move(slab));
+    }
+
+    std::size_t _slab_size;
+
+    std::vector<std::unique_ptr<T[]>> _slabs;
+
+    std::vector<T*> _free_list;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_OBJECT_POOL_H
@@ -0,0 +1,172 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "peer_table.h"
+#include <cassert>
+#include <cstring>
+#include <netinet/in.h>
+
+namespace sw::gossip {
+
+PeerHandle PeerTable::add(const NodeId &id, const IpAddress &ip, uint16_t port) {
+    auto iter = _index.find(id);
+    if (iter != _index.end()) {
+        auto index = iter->second;
+        assert(index < _entries.size());
+
+        auto &entry = _entries[index];
+        if (entry.port != port || entry.ip != ip) {
+            // Node restarted with a new address.
+            _assign(entry, ip, port);
+        }
+
+        return {index, entry.generation};
+    }
+
+    auto peer = _resolve(ip, port);
+
+    uint32_t index = 0;
+    if (!_free_list.empty()) {
+        index = _free_list.back();
+        _free_list.pop_back();
+    } else {
+        index = static_cast<uint32_t>(_entries.size());
+        _entries.emplace_back();
+    }
+
+    auto &entry = _entries[index];
+    entry.peer = peer;
+    entry.ip = ip;
+    entry.port = port;
+    entry.format = WireFormat::UNKNOWN;
+    entry.negotiation = Negotiation{};
+    entry.used = true;
+
+    _index.emplace(id, index);
+
+    return {index, entry.generation};
+}
+
+void PeerTable::remove(const NodeId &id) {
+    auto iter = _index.find(id);
+    if (iter == _index.end()) {
+        return;
+    }
+
+    auto index = iter->second;
+    _index.erase(iter);
+
+    assert(index < _entries.size());
+    auto &entry = _entries[index];
+    entry.used = false;
+    // Invalidate all handles to this slot.
+    ++entry.generation;
+
+    _free_list.push_back(index);
+}
+
+PeerHandle PeerTable::find(const NodeId &id) const {
+    auto iter = _index.find(id);
+    if (iter == _index.end()) {
+        return {};
+    }
+
+    auto index = iter->second;
+    assert(index < _entries.size());
+
+    return {index, _entries[index].generation};
+}
+
+auto PeerTable::get(const PeerHandle &handle) const -> const Peer* {
+    const auto *entry = _entry(handle);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+    return &entry->peer;
+}
+
+WireFormat PeerTable::format(const PeerHandle &handle) const {
+    const auto *entry = _entry(handle);
+    if (entry == nullptr) {
+        return WireFormat::UNKNOWN;
+    }
+
+    return entry->format;
+}
+
+void PeerTable::set_format(const PeerHandle &handle, WireFormat format) {
+    auto *entry = _entry(handle);
+    if (entry != nullptr) {
+        entry->format = format;
+    }
+}
+
+Negotiation* PeerTable::negotiation(const PeerHandle &handle) {
+    auto *entry = _entry(handle);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+
+    return &entry->negotiation;
+}
+
+auto PeerTable::_entry(const PeerHandle &handle) -> Entry* {
+    return const_cast<Entry *>(static_cast<const PeerTable *>(this)->_entry(handle));
+}
+
+auto PeerTable::_entry(const PeerHandle &handle) const -> const Entry* {
+    if (handle.index >= _entries.size()) {
+        return nullptr;
+    }
+
+    const auto &entry = _entries[handle.index];
+    if (!entry.used || entry.generation != handle.generation) {
+        return nullptr;
+    }
+
+    return &entry;
+}
+
+void PeerTable::_assign(Entry &entry, const IpAddress &ip, uint16_t port) const {
+    entry.peer = _resolve(ip, port);
+    entry.ip = ip;
+    entry.port = port;
+}
+
+auto PeerTable::_resolve(const IpAddress &ip, uint16_t port) const -> Peer {
+    // The address is already in binary, so there's nothing to parse.
+    Peer peer;
+    std::memset(&peer.addr, 0, sizeof(peer.addr));
+    if (ip.is_v4()) {
+        auto *addr = reinterpret_cast<sockaddr_in *>(&peer.addr);
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(port);
+        // The last 4 bytes of an IPv4-mapped address.
+        std::memcpy(&addr->sin_addr, ip.data() + IpAddress::SIZE - 4, 4);
+        peer.addr_len = sizeof(sockaddr_in);
+    } else {
+        auto *addr = reinterpret_cast<sockaddr_in6 *>(&peer.addr);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_port = htons(port);
+        std::memcpy(&addr->sin6_addr, ip.data(), IpAddress::SIZE);
+        peer.addr_len = sizeof(sockaddr_in6);
+    }
+
+    return peer;
+}
+
+}
@@ -0,0 +1,136 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_PEER_TABLE_H
+#define SW_GOSSIP_NET_PEER_TABLE_H
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "utils.h"
+
+namespace sw::gossip {
+
+// Compact handle of a peer, whose address has been resolved and cached in PeerTable.
+struct PeerHandle {
+    static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+    uint32_t index = INVALID_INDEX;
+
+    // Distinguish peers reusing the same slot, so that a stale handle never
+    // resolves to the address of another peer.
+    uint32_t generation = 0;
+
+    bool valid() const {
+        return index != INVALID_INDEX;
+    }
+};
+
+// Encoding of messages sent to a peer.
+enum class WireFormat : uint8_t {
+    // Not negotiated yet.
+    UNKNOWN = 0,
+
+    // Capabilities have been advertised several times, and the peer never replied.
+    // It's an older node that only speaks RESP.
+    RESP,
+
+    BINARY,
+
+    // Binary format, and rumors are coded with a dictionary shared with the peer.
+    BINARY_DICT
+};
+
+// Progress of advertising capabilities to a peer whose format is UNKNOWN.
+struct Negotiation {
+    // Number of times capabilities have been sent.
+    uint32_t attempts = 0;
+
+    // Protocol period of the last attempt.
+    uint64_t period = 0;
+};
+
+// Cache of pre-resolved peer addresses keyed by node id.
+// NOT thread-safe, and should only be used in the event loop thread.
+class PeerTable {
+public:
+    struct Peer {
+        sockaddr_storage addr;
+        socklen_t addr_len;
+    };
+
+    // Resolve and cache the address of the given node. If the node has already been
+    // cached with the same address, return the existing handle without resolving again.
+    PeerHandle add(const NodeId &id, const IpAddress &ip, uint16_t port);
+
+    void remove(const NodeId &id);
+
+    // @return an invalid handle, if the node has not been cached.
+    PeerHandle find(const NodeId &id) const;
+
+    // @return nullptr, if the handle is invalid or stale.
+    const Peer* get(const PeerHandle &handle) const;
+
+    // @return WireFormat::UNKNOWN, if the handle is invalid or stale.
+    WireFormat format(const PeerHandle &handle) const;
+
+    // It's a no-op, if the handle is invalid or stale.
+    void set_format(const PeerHandle &handle, WireFormat format);
+
+    // @return nullptr, if the handle is invalid or stale.
+    Negotiation* negotiation(const PeerHandle &handle);
+
+    std::size_t size() const {
+        return _index.size();
+    }
+
+private:
+    struct Entry {
+        Peer peer;
+
+        IpAddress ip;
+
+        uint16_t port = 0;
+
+        WireFormat format = WireFormat::UNKNOWN;
+
+        Negotiation negotiation;
+
+        uint32_t generation = 0;
+
+        bool used = false;
+    };
+
+    Peer _resolve(const IpAddress &ip, uint16_t port) const;
+
+    void _assign(Entry &entry, const IpAddress &ip, uint16_t port) const;
+
+    Entry* _entry(const PeerHandle &handle);
+
+    const Entry* _entry(const PeerHandle &handle) const;
+
+    std::vector<Entry> _entries;
+
+    std::vector<uint32_t> _free_list;
+
+    std::unordered_map<NodeId, uint32_t> _index;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_PEER_TABLE_H
@@ -15,68 +15,56 @@
  *************************************************************************/
 
 #include "pending_lists.h"
+#include <cassert>
 
 namespace sw::gossip {
 
-void PendingLists::add(TaskUPtr task) {
+void PendingLists::add(TaskUPtr task, const TimerHandle &timer) {
     assert(task);
 
-    auto cur = _now();
-    auto id = task->id();
-    _task_index[id].emplace_back(std::move(task), cur);
-    _timeout_index[cur].push_back(id);
+    auto &items = _tasks[task->id()];
+    items.push_back(Item{std::move(task), timer});
+    ++_size;
 }
 
-std::vector<TaskUPtr> PendingLists::fetch(const std::string &id) {
-    auto iter = _task_index.find(id);
-    if (iter == _task_index.end()) {
+auto PendingLists::fetch(const NodeId &id) -> std::vector<Item> {
+    auto iter = _tasks.find(id);
+    if (iter == _tasks.end()) {
         return {};
     }
 
-    auto &tasks = iter->second;
-    std::vector<TaskUPtr> results;
-    results.reserve(tasks.size());
-    for (auto &task : tasks) {
-        results.push_back(std::move(task.first));
-    }
+    auto items = std::move(iter->second);
+    _tasks.erase(iter);
+
+    assert(_size >= items.size());
+    _size -= items.size();
 
-    return results;
+    return items;
 }
 
-std::vector<TaskUPtr> PendingLists::timeout_tasks() {
-    auto cur = _now();
-    auto last = _timeout_index.upper_bound(cur);
-    std::vector<TaskUPtr> results;
-    for (auto iter = _timeout_index.begin(); iter != last; ++iter) {
-        for (const auto &id : iter->second) {
-            auto it = _task_index.find(id);
-            if (it != _task_index.end()) {
-                auto &tasks = it->second;
-                for (auto i = tasks.begin(); i != tasks.end(); ) {
-                    if (i->second < cur) {
-                        results.push_back(std::move(i->first));
-                        i = tasks.erase(i);
-                    } else {
-                        ++i;
-                    }
-                }
-
-                if (tasks.empty()) {
-                    _task_index.erase(it);
-                }
-            } // else already removed
-        }
+TaskUPtr PendingLists::remove(const Task &task) {
+    auto iter = _tasks.find(task.id());
+    if (iter == _tasks.end()) {
+        return nullptr;
     }
 
-    _timeout_index.erase(_timeout_index.begin(), last);
+    auto &items = iter->second;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        if (it->task.get() == &task) {
+            auto result = std::move(it->task);
+            items.erase(it);
+            if (items.empty()) {
+                _tasks.erase(iter);
+            }
 
-    return results;
-}
+            assert(_size > 0);
+            --_size;
 
-TimePoint PendingLists::_now() const {
-    auto cur = std::chrono::steady_clock::now();
+            return result;
+        }
+    }
 
-    return std::chrono::time_point_cast<std::chrono::milliseconds>(cur);
+    return nullptr;
 }
 
 }
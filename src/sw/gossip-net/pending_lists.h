@@ -17,35 +17,40 @@
 #ifndef SW_GOSSIP_NET_PENDING_LISTS_H
 #define SW_GOSSIP_NET_PENDING_LISTS_H
 
-#include <chrono>
-#include <map>
-#include <string>
 #include <unordered_map>
+#include <vector>
 #include "task.h"
+#include "timing_wheel.h"
 
 namespace sw::gossip {
 
+// Tasks waiting for acks, indexed by node id. Each task has a timeout timer,
+// which should be canceled when the task is fetched.
 class PendingLists {
 public:
-    explicit PendingLists(const std::chrono::milliseconds &timeout) : _timeout(timeout) {}
+    struct Item {
+        TaskUPtr task;
 
-    void add(TaskUPtr task);
+        TimerHandle timer;
+    };
 
-    std::vector<TaskUPtr> fetch(const std::string &id);
+    void add(TaskUPtr task, const TimerHandle &timer);
 
-    std::vector<Item> timeout_tasks();
+    // Remove and return all tasks waiting for an ack from the given node.
+    std::vector<Item> fetch(const NodeId &id);
 
-private:
-    using TimePoint = std::chrono::time_point<std::chrono::steady_clock,
-                                  std::chrono::milliseconds>;
-
-    TimePoint _now() const;
+    // Remove the given task, whose timer has fired.
+    // @return nullptr, if the task has already been fetched.
+    TaskUPtr remove(const Task &task);
 
-    std::unordered_map<std::string, std::vector<std::pair<TaskUPtr, TimePoint>>> _task_index;
+    std::size_t size() const {
+        return _size;
+    }
 
-    std::map<TimePoint, std::vector<std::string>> _timeout_index;
+private:
+    std::unordered_map<NodeId, std::vector<Item>> _tasks;
 
-    std::chrono::milliseconds _timeout;
+    std::size_t _size = 0;
 };
 
 }
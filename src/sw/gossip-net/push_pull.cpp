@@ -0,0 +1,384 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "push_pull.h"
+#include <cassert>
+#include "errors.h"
+#include "gossip_net.h"
+#include "compression.h"
+#include "logger.h"
+#include "resp.h"
+
+namespace sw::gossip {
+
+namespace {
+
+constexpr std::string_view PUSH_PULL_COMMAND = "push-pull";
+
+// Number of items of each node: rumor id ip port version status
+constexpr std::size_t NODE_ITEM_NUM = 6;
+
+}
+
+PushPull::PushPull(uv_loop_t &loop,
+        const TcpOptions &tcp_opts,
+        const PushPullOptions &opts,
+        GossipNet &net) :
+            _loop(loop),
+            _opts(opts),
+            _net(net) {
+    _server = uv::make_tcp_server(_loop, tcp_opts, _on_accept, this);
+
+    if (_opts.interval.count() > 0) {
+        _interval_timer = uv::make_timer(_loop, _on_interval, _opts.interval, _opts.interval, this);
+    }
+
+    _sweep_timer = uv::make_timer(_loop, _on_sweep, _opts.timeout, _opts.timeout, this);
+}
+
+void PushPull::sync(const std::string &ip, int port) {
+    SockAddr addr(ip, port);
+
+    auto &conn = _make_connection(true);
+    auto err = uv_tcp_connect(&conn.connect_req, conn.tcp.get(), addr.addr(), _on_connect);
+    if (err != 0) {
+        SW_GOSSIP_LOG_WARN("failed to connect to %s:%d for push-pull: %s",
+                ip.data(), port, uv_strerror(err));
+        _close(conn);
+    }
+}
+
+void PushPull::_on_accept(uv_stream_t *server, int status) {
+    assert(server != nullptr);
+
+    auto *push_pull = uv::get_data<PushPull>(server);
+    assert(push_pull != nullptr);
+
+    if (status < 0) {
+        SW_GOSSIP_LOG_ERROR_RL("failed to accept push-pull connection: %s", uv_strerror(status));
+        return;
+    }
+
+    // Accept it even if there're too many connections, otherwise it stays in the backlog.
+    auto reject = push_pull->_inbound_num >= push_pull->_opts.max_connections;
+
+    auto &conn = push_pull->_make_connection(false);
+    auto err = uv_accept(server, uv::to_stream(conn.tcp.get()));
+    if (err != 0) {
+        SW_GOSSIP_LOG_ERROR_RL("failed to accept push-pull connection: %s", uv_strerror(err));
+        push_pull->_close(conn);
+        return;
+    }
+
+    if (reject) {
+        SW_GOSSIP_LOG_ERROR_RL("too many push-pull connections, reject it");
+        push_pull->_close(conn);
+        return;
+    }
+
+    push_pull->_read_start(conn);
+}
+
+void PushPull::_on_connect(uv_connect_t *req, int status) {
+    assert(req != nullptr);
+
+    auto *conn = uv::get_data<Connection>(req);
+    assert(conn != nullptr && conn->push_pull != nullptr);
+
+    auto *push_pull = conn->push_pull;
+    if (status < 0) {
+        if (status != UV_ECANCELED) {
+            SW_GOSSIP_LOG_WARN("failed to connect for push-pull: %s", uv_strerror(status));
+        }
+
+        push_pull->_close(*conn);
+        return;
+    }
+
+    push_pull->_write(*conn);
+    push_pull->_read_start(*conn);
+}
+
+void PushPull::_on_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
+    assert(handle != nullptr && buf != nullptr);
+
+    auto *conn = uv::get_data<Connection>(handle);
+    assert(conn != nullptr);
+
+    auto &in = conn->in;
+    if (in.size() - conn->in_size < suggested_size) {
+        in.resize(conn->in_size + suggested_size);
+    }
+
+    buf->base = in.data() + conn->in_size;
+    buf->len = in.size() - conn->in_size;
+}
+
+void PushPull::_on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t * /*buf*/) {
+    assert(stream != nullptr);
+
+    auto *conn = uv::get_data<Connection>(stream);
+    assert(conn != nullptr && conn->push_pull != nullptr);
+
+    auto *push_pull = conn->push_pull;
+    if (nread == UV_EOF) {
+        push_pull->_on_state(*conn);
+    } else if (nread < 0) {
+        SW_GOSSIP_LOG_WARN("failed to read push-pull state: %s",
+                uv_strerror(static_cast<int>(nread)));
+        push_pull->_close(*conn);
+    } else {
+        conn->in_size += nread;
+        if (conn->in_size > push_pull->_opts.max_state_size) {
+            SW_GOSSIP_LOG_WARN("push-pull state is too large: %zu", conn->in_size);
+            push_pull->_close(*conn);
+        }
+    }
+}
+
+void PushPull::_on_write(uv_write_t *req, int status) {
+    assert(req != nullptr);
+
+    auto *conn = uv::get_data<Connection>(req);
+    assert(conn != nullptr && conn->push_pull != nullptr);
+
+    auto *push_pull = conn->push_pull;
+    if (status < 0) {
+        if (status != UV_ECANCELED) {
+            SW_GOSSIP_LOG_WARN("failed to write push-pull state: %s", uv_strerror(status));
+        }
+
+        push_pull->_close(*conn);
+        return;
+    }
+
+    // Free the memory as early as possible, since the state might be large.
+    std::string().swap(conn->out);
+
+    if (!conn->initiator) {
+        // The exchange is done.
+        push_pull->_close(*conn);
+        return;
+    }
+
+    // Tell the peer that the whole state has been sent.
+    conn->shutdown_req.data = conn;
+    auto err = uv_shutdown(&conn->shutdown_req, uv::to_stream(conn->tcp.get()), _on_shutdown);
+    if (err != 0) {
+        SW_GOSSIP_LOG_WARN("failed to shutdown push-pull connection: %s", uv_strerror(err));
+        push_pull->_close(*conn);
+    }
+}
+
+void PushPull::_on_shutdown(uv_shutdown_t *req, int status) {
+    assert(req != nullptr);
+
+    auto *conn = uv::get_data<Connection>(req);
+    assert(conn != nullptr && conn->push_pull != nullptr);
+
+    if (status < 0) {
+        if (status != UV_ECANCELED) {
+            SW_GOSSIP_LOG_WARN("failed to shutdown push-pull connection: %s", uv_strerror(status));
+        }
+
+        conn->push_pull->_close(*conn);
+    }
+}
+
+void PushPull::_on_close(uv_handle_t *handle) {
+    assert(handle != nullptr);
+
+    auto *conn = uv::get_data<Connection>(handle);
+    assert(conn != nullptr && conn->push_pull != nullptr);
+
+    auto *push_pull = conn->push_pull;
+    if (!conn->initiator) {
+        assert(push_pull->_inbound_num > 0);
+        --push_pull->_inbound_num;
+    }
+
+    // All pending requests have been canceled, and it's safe to destroy the connection.
+    push_pull->_connections.erase(conn);
+}
+
+void PushPull::_on_interval(uv_timer_t *timer) {
+    assert(timer != nullptr);
+
+    auto *push_pull = uv::get_data<PushPull>(timer);
+    assert(push_pull != nullptr);
+
+    try {
+        push_pull->_net.push_pull();
+    } catch (const Error &err) {
+        SW_GOSSIP_LOG_WARN("failed to start push-pull: %s", err.what());
+    }
+}
+
+void PushPull::_on_sweep(uv_timer_t *timer) {
+    assert(timer != nullptr);
+
+    auto *push_pull = uv::get_data<PushPull>(timer);
+    assert(push_pull != nullptr);
+
+    auto now = uv_now(&push_pull->_loop);
+    for (auto &ele : push_pull->_connections) {
+        auto &conn = *(ele.second);
+        if (conn.deadline <= now && !conn.closing) {
+            SW_GOSSIP_LOG_WARN("push-pull timed out");
+            // It only closes the handle, and connections are erased in close callback.
+            push_pull->_close(conn);
+        }
+    }
+}
+
+auto PushPull::_make_connection(bool initiator) -> Connection& {
+    auto conn = std::make_unique<Connection>();
+    conn->push_pull = this;
+    conn->tcp = uv::make_tcp_client(_loop, conn.get());
+    conn->connect_req.data = conn.get();
+    conn->write_req = uv::make_write(_loop, conn.get());
+    conn->initiator = initiator;
+    conn->deadline = uv_now(&_loop) + _opts.timeout.count();
+
+    auto *ptr = conn.get();
+    _connections.emplace(ptr, std::move(conn));
+
+    if (!initiator) {
+        ++_inbound_num;
+    }
+
+    return *ptr;
+}
+
+void PushPull::_write(Connection &conn) {
+    try {
+        conn.out = _build_state();
+    } catch (const Error &err) {
+        SW_GOSSIP_LOG_ERROR("failed to build push-pull state: %s", err.what());
+        _close(conn);
+        return;
+    }
+
+    auto buf = uv_buf_init(conn.out.data(), conn.out.size());
+    auto err = uv_write(conn.write_req.get(), uv::to_stream(conn.tcp.get()), &buf, 1, _on_write);
+    if (err != 0) {
+        SW_GOSSIP_LOG_WARN("failed to write push-pull state: %s", uv_strerror(err));
+        _close(conn);
+    }
+}
+
+void PushPull::_read_start(Connection &conn) {
+    auto err = uv_read_start(uv::to_stream(conn.tcp.get()), _on_alloc, _on_read);
+    if (err != 0) {
+        SW_GOSSIP_LOG_WARN("failed to read push-pull state: %s", uv_strerror(err));
+        _close(conn);
+    }
+}
+
+void PushPull::_on_state(Connection &conn) {
+    uv_read_stop(uv::to_stream(conn.tcp.get()));
+
+    std::vector<Node> nodes;
+    try {
+        nodes = _parse_state(std::string_view(conn.in.data(), conn.in_size));
+    } catch (const Error &err) {
+        SW_GOSSIP_LOG_WARN("invalid push-pull state: %s", err.what());
+        _close(conn);
+        return;
+    }
+
+    std::string().swap(conn.in);
+    conn.in_size = 0;
+
+    if (conn.initiator) {
+        _close(conn);
+    } else {
+        // Reply with the local state before merging, since the peer already has the received one.
+        _write(conn);
+    }
+
+    _net.merge(std::move(nodes));
+}
+
+void PushPull::_close(Connection &conn) {
+    if (conn.closing) {
+        return;
+    }
+
+    conn.closing = true;
+    uv::handle_close(conn.tcp.get(), _on_close);
+}
+
+std::string PushPull::_build_state() const {
+    auto nodes = _net.state();
+
+    auto num = 1 + nodes.size() * NODE_ITEM_NUM;
+    auto size = RespReplyBuilder::integer_size(num)
+        + RespReplyBuilder::bulk_string_size(PUSH_PULL_COMMAND.size());
+    for (const auto &node : nodes) {
+        size += RespReplyBuilder::node_size("rumor", node);
+    }
+
+    // The state can be large, so allocate it exactly once.
+    RespReplyBuilder builder;
+    builder.reserve(size);
+    builder.append_array(num);
+    builder.append_bulk_string(PUSH_PULL_COMMAND);
+    for (const auto &node : nodes) {
+        builder.append_node("rumor", node);
+    }
+
+    assert(builder.size() == size);
+
+    auto &state = builder.data();
+    if (_opts.compression_threshold == 0 || state.size() <= _opts.compression_threshold) {
+        return std::move(state);
+    }
+
+    std::string compressed(lz::max_compressed_size(state.size()), '\0');
+    auto len = lz::compress(state, compressed.data(), compressed.size());
+    if (len == 0) {
+        // Incompressible.
+        return std::move(state);
+    }
+
+    compressed.resize(len);
+
+    return compressed;
+}
+
+std::vector<Node> PushPull::_parse_state(std::string_view data) const {
+    std::string decompressed;
+    if (lz::is_compressed(data)) {
+        lz::decompress(data, decompressed, _opts.max_state_size);
+        data = decompressed;
+    }
+
+    RespRequestParser parser;
+    auto [requests, len] = parser.parse(data);
+    if (requests.size() != 1 || len != data.size()) {
+        throw Error("incomplete state");
+    }
+
+    const auto &request = requests.front();
+    if (request.name != PUSH_PULL_COMMAND) {
+        throw Error("unknown command");
+    }
+
+    return utils::parse_rumors(request.args.begin(), request.args.end());
+}
+
+}
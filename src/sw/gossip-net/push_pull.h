@@ -0,0 +1,173 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_PUSH_PULL_H
+#define SW_GOSSIP_NET_PUSH_PULL_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "uv_utils.h"
+#include "utils.h"
+
+namespace sw::gossip {
+
+class GossipNet;
+
+struct PushPullOptions {
+    // Interval of push-pull with a member, i.e. anti-entropy. If it's 0,
+    // push-pull only runs on join.
+    std::chrono::milliseconds interval{30000};
+
+    // A connection is closed, if the exchange cannot finish in time.
+    std::chrono::milliseconds timeout{10000};
+
+    // Max size of state received from a peer. If it's compressed, it's also the max
+    // size after decompression.
+    std::size_t max_state_size = 64 * 1024 * 1024;
+
+    // State larger than it is compressed, if that makes it smaller. Compressed
+    // state is always accepted, so enable it after all nodes are upgraded.
+    // 0 disables it.
+    std::size_t compression_threshold = 0;
+
+    // Number of received members merged in a loop iteration, so that
+    // merging a large state won't block other events for long.
+    std::size_t merge_batch_size = 256;
+
+    int backlog = 128;
+
+    // Max number of exchanges started by peers at the same time, since each of them
+    // might buffer up to `max_state_size`. Connections beyond it are closed once
+    // accepted, and those peers retry with their next interval. Exchanges started
+    // by this node are not limited.
+    std::size_t max_connections = 64;
+};
+
+// Exchange the full membership state with a peer over TCP. The initiator sends
+// `push-pull [rumor id ip port version status]...`, and shuts down the write side.
+// The peer reads until EOF, replies with its own state in the same format, and
+// closes the connection. Both sides merge the received state.
+// All methods should be called in the event loop thread.
+class PushPull {
+public:
+    PushPull(uv_loop_t &loop,
+            const TcpOptions &tcp_opts,
+            const PushPullOptions &opts,
+            GossipNet &net);
+
+    PushPull(const PushPull &) = delete;
+    PushPull& operator=(const PushPull &) = delete;
+
+    PushPull(PushPull &&) = delete;
+    PushPull& operator=(PushPull &&) = delete;
+
+    ~PushPull() = default;
+
+    // Start an exchange with the peer.
+    void sync(const std::string &ip, int port);
+
+    std::size_t connection_num() const {
+        return _connections.size();
+    }
+
+private:
+    struct Connection {
+        PushPull *push_pull = nullptr;
+
+        TcpUPtr tcp;
+
+        uv_connect_t connect_req;
+
+        uv_shutdown_t shutdown_req;
+
+        WriteUPtr write_req;
+
+        // State to be sent.
+        std::string out;
+
+        // State received, and only the first `in_size` bytes are valid.
+        std::string in;
+
+        std::size_t in_size = 0;
+
+        // Whether this side starts the exchange.
+        bool initiator = false;
+
+        bool closing = false;
+
+        uint64_t deadline = 0;
+    };
+
+    static void _on_accept(uv_stream_t *server, int status);
+
+    static void _on_connect(uv_connect_t *req, int status);
+
+    static void _on_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf);
+
+    static void _on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf);
+
+    static void _on_write(uv_write_t *req, int status);
+
+    static void _on_shutdown(uv_shutdown_t *req, int status);
+
+    static void _on_close(uv_handle_t *handle);
+
+    static void _on_interval(uv_timer_t *timer);
+
+    static void _on_sweep(uv_timer_t *timer);
+
+    Connection& _make_connection(bool initiator);
+
+    void _write(Connection &conn);
+
+    void _read_start(Connection &conn);
+
+    // The whole state has been received.
+    void _on_state(Connection &conn);
+
+    void _close(Connection &conn);
+
+    std::string _build_state() const;
+
+    std::vector<Node> _parse_state(std::string_view data) const;
+
+    uv_loop_t &_loop;
+
+    PushPullOptions _opts;
+
+    GossipNet &_net;
+
+    TcpUPtr _server;
+
+    // Periodic push-pull, and it's null if disabled.
+    TimerUPtr _interval_timer;
+
+    // Close timed out connections.
+    TimerUPtr _sweep_timer;
+
+    std::unordered_map<Connection *, std::unique_ptr<Connection>> _connections;
+
+    // Number of connections in `_connections` accepted from peers.
+    std::size_t _inbound_num = 0;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_PUSH_PULL_H
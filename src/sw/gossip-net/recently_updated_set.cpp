@@ -14,100 +14,163 @@
    limitations under the License.
  *************************************************************************/
 
+
 #include "recently_updated_set.h"
+#include <algorithm>
 #include <cassert>
-#include <queue>
 
 namespace sw::gossip {
 
-void RecentlyUpdatedSet::add(const Node &node) {
+bool RecentlyUpdatedSet::add(const Node &node, std::optional<NodeStatus> &prev) {
     const auto &id = node.id;
-    auto iter = _members.find(id);
-    if (iter != _members.end()) {
+    auto iter = _index.find(id);
+    if (iter != _index.end()) {
         // If we should update the info, reset the counter.
-        auto &mem = iter->second;
-        if (mem.node < node) {
-            mem.node = node;
-            mem.counter = 0;
+        auto index = iter->second;
+        auto &mem = _members[index];
+        if (!(mem.node < node)) {
+            return false;
         }
+
+        prev = mem.node.status;
+        mem.node = node;
+
+        _unlink(index);
+        mem.counter = 0;
+        _link(index);
     } else {
-        _members[id].node = node;
-    }
-}
+        uint32_t index = 0;
+        if (!_free_list.empty()) {
+            index = _free_list.back();
+            _free_list.pop_back();
+        } else {
+            index = static_cast<uint32_t>(_members.size());
+            _members.emplace_back();
+        }
 
-auto RecentlyUpdatedSet::fetch(std::size_t n, std::size_t max_spreaded_num)
-    -> std::pair<std::vector<Node>, std::vector<Node>> {
-    if (n == 0) {
-        return {};
+        auto &mem = _members[index];
+        mem.node = node;
+        mem.counter = 0;
+        _link(index);
+
+        _index.emplace(id, index);
     }
 
-    if (n >= _members.size()) {
-        return _fetch_all(n, max_spreaded_num);
+    return true;
+}
+
+std::vector<Node> RecentlyUpdatedSet::all() const {
+    std::vector<Node> nodes;
+    nodes.reserve(_index.size());
+    for (const auto &ele : _index) {
+        nodes.push_back(_members[ele.second].node);
     }
 
-    return _fetch(n, max_spreaded_num);
+    return nodes;
 }
 
-auto RecentlyUpdatedSet::_fetch(std::size_t n, std::size_t max_spreaded_num)
-    -> std::pair<std::vector<Node>, std::vector<Node>> {
-    std::priority_queue<MemberIter, std::vector<MemberIter>, MemberCmp> que;
-    for (auto iter = _members.begin(); iter != _members.end(); ++iter) {
-        que.push(iter);
+auto RecentlyUpdatedSet::fetch(std::size_t n,
+        std::size_t max_spreaded_num,
+        std::size_t &budget,
+        const NodeSize &node_size) -> FetchResult {
+    if (n == 0) {
+        return {};
     }
 
     std::vector<Node> recent_nodes;
-    recent_nodes.reserve(n);
+    recent_nodes.reserve(std::min(n, _index.size()));
     std::vector<Node> stable_nodes;
-    stable_nodes.reserve(n);
+    std::vector<Node> reaped_nodes;
 
-    assert(n > 0 && n < _members.size());
+    // Members that have been spreaded many times are stable, and no more spreading.
+    for (auto counter = max_spreaded_num; counter < _buckets.size(); ++counter) {
+        auto &bucket = _buckets[counter];
+        while (bucket.head != INVALID_INDEX) {
+            auto index = bucket.head;
+            _unlink(index);
 
-    while (!que.empty()) {
-        auto &iter = que.top();
-        auto &member = iter->second;
-        ++member.counter;
-        if (member.counter > max_spreaded_num) {
-            // Member has been spreaded many times, make it stable, and no more spreading.
+            auto &member = _members[index];
+            _index.erase(member.node.id);
             if (member.node.status != NodeStatus::FAILED) {
                 stable_nodes.push_back(std::move(member.node));
-            } // Simply remove FAILED node.
+            } else {
+                // Simply remove FAILED node.
+                reaped_nodes.push_back(std::move(member.node));
+            }
 
-            _members.erase(iter);
-        } else {
-            recent_nodes.push_back(member.node);
-            if (recent_nodes.size() == n) {
-                break;
+            _free_list.push_back(index);
+        }
+    }
+
+    std::size_t skipped = 0;
+    auto bucket_num = std::min(max_spreaded_num, _buckets.size());
+    for (std::size_t counter = 0; counter != bucket_num; ++counter) {
+        auto index = _buckets[counter].head;
+        while (index != INVALID_INDEX && recent_nodes.size() != n && skipped != n) {
+            auto &member = _members[index];
+            auto next = member.next;
+
+            auto size = node_size(member.node);
+            if (size > budget) {
+                // Try smaller ones, and spread it in the next message.
+                ++skipped;
+            } else {
+                budget -= size;
+                recent_nodes.push_back(member.node);
+
+                _unlink(index);
+                _fetched.push_back(index);
             }
+
+            index = next;
         }
-        que.pop();
     }
 
-    return std::make_pair(std::move(recent_nodes), std::move(stable_nodes));
+    for (auto index : _fetched) {
+        ++_members[index].counter;
+        _link(index);
+    }
+    _fetched.clear();
+
+    return std::make_tuple(std::move(recent_nodes),
+            std::move(stable_nodes),
+            std::move(reaped_nodes));
 }
 
-auto RecentlyUpdatedSet::_fetch_all(std::size_t max_spreaded_num)
-    -> std::pair<std::vector<Node>, std::vector<Node>> {
-    std::vector<Node> recent_nodes;
-    recent_nodes.reserve(_members.size());
-    std::vector<Node> stable_nodes;
-    stable_nodes.reserve(_members.size());
-    for (auto iter = _members.begin(); iter != _members.end(); ) {
-        auto &member = iter->second;
-        ++member.counter;
-        if (member.counter > max_spreaded_num) {
-            // Member has been spreaded many times, make it stable, and no more spreading.
-            if (member.node.status != NodeStatus::FAILED) {
-                stable_nodes.push_back(std::move(member.node));
-            } // else simply remove FAILED node
+void RecentlyUpdatedSet::_link(uint32_t index) {
+    auto &member = _members[index];
+    if (member.counter >= _buckets.size()) {
+        _buckets.resize(member.counter + 1);
+    }
 
-            iter = _members.erase(iter);
-        } else {
-            recent_nodes.push_back(member.node);
-            ++iter;
-        }
+    auto &bucket = _buckets[member.counter];
+    member.prev = bucket.tail;
+    member.next = INVALID_INDEX;
+    if (bucket.tail != INVALID_INDEX) {
+        _members[bucket.tail].next = index;
+    } else {
+        bucket.head = index;
+    }
+    bucket.tail = index;
+}
+
+void RecentlyUpdatedSet::_unlink(uint32_t index) {
+    auto &member = _members[index];
+    auto &bucket = _buckets[member.counter];
+
+    if (member.prev != INVALID_INDEX) {
+        _members[member.prev].next = member.next;
+    } else {
+        bucket.head = member.next;
+    }
+
+    if (member.next != INVALID_INDEX) {
+        _members[member.next].prev = member.prev;
+    } else {
+        bucket.tail = member.prev;
     }
 
-    return std::make_pair(std::move(recent_nodes), std::move(stable_nodes));
+    member.prev = member.next = INVALID_INDEX;
 }
 
 }
@@ -14,51 +14,94 @@
    limitations under the License.
  *************************************************************************/
 
+
 #ifndef SW_GOSSIP_NET_RECENTLY_UPDATED_SET
 #define SW_GOSSIP_NET_RECENTLY_UPDATED_SET
 
+#include <cstdint>
+#include <limits>
+#include <optional>
 #include <unordered_map>
-#include <string>
+#include <tuple>
+#include <vector>
 #include "utils.h"
 
 namespace sw::gossip {
 
+// Members are kept in a slab, and linked into buckets by their spread counters with
+// intrusive lists. So fetching the N least spreaded members is O(N), and promoting
+// a member to stable is O(1).
 class RecentlyUpdatedSet {
 public:
     RecentlyUpdatedSet() = default;
 
-    void add(const Node &node);
+    // @return false, if the node is not newer than the existing one, and it's ignored.
+    //         Otherwise, `prev` is set to the status of the replaced one, if any.
+    bool add(const Node &node, std::optional<NodeStatus> &prev);
+
+    using FetchResult = std::tuple<std::vector<Node>, std::vector<Node>, std::vector<Node>>;
 
-    // Fetch N recently updated members, and increase its counter.
+    // Fetch N least spreaded members, and increase their counters.
     // Also returns members that already been spreaded at least `max_spreaded_num` times,
-    // i.e. the stable nodes.
-    auto fetch(std::size_t n, std::size_t max_spreaded_num)
-        -> std::pair<std::vector<Node>, std::vector<Node>>;
+    // i.e. the stable nodes, and the FAILED ones among them, which are reaped.
+    // Total size of recent nodes doesn't exceed `budget`, which is decreased accordingly.
+    // Members that don't fit are skipped, and their counters are unchanged. It stops
+    // after skipping N members.
+    // @return tuple<recent nodes, stable nodes, reaped nodes>
+    FetchResult fetch(std::size_t n,
+            std::size_t max_spreaded_num,
+            std::size_t &budget,
+            const NodeSize &node_size);
+
+    // Get all members without increasing counters, e.g. for full state synchronization.
+    std::vector<Node> all() const;
+
+    std::size_t size() const {
+        return _index.size();
+    }
+
+    bool contains(const NodeId &id) const {
+        return _index.find(id) != _index.end();
+    }
 
 private:
-    auto _fetch_all(std::size_t n, std::size_t max_spreaded_num)
-        -> std::pair<std::vector<Node>, std::vector<Node>>;
-
-    auto _fetch(std::size_t max_spreaded_num)
-        -> std::pair<std::vector<Node>, std::vector<Node>>;
+    static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
 
     struct Member {
         Node node;
 
         // Count of times that the node has been fetched (spreaded).
         std::size_t counter = 0;
-    };
 
-    std::unordered_map<std::string, Member> _members;
+        uint32_t prev = INVALID_INDEX;
+
+        uint32_t next = INVALID_INDEX;
+    };
 
-    using MemberIter = std::unordered_map<std::string, Member>::iterator;
+    struct Bucket {
+        uint32_t head = INVALID_INDEX;
 
-    struct MemberCmp {
-        bool operator()(const MemberIter &lhs, const MemberIter &rhs) const {
-            return rhs->second.counter < lhs->second.counter;
-        }
+        uint32_t tail = INVALID_INDEX;
     };
 
+    // Append the member to the bucket of its counter.
+    void _link(uint32_t index);
+
+    void _unlink(uint32_t index);
+
+    std::vector<Member> _members;
+
+    std::vector<uint32_t> _free_list;
+
+    // Member id => index in `_members`.
+    std::unordered_map<NodeId, uint32_t> _index;
+
+    // Members spreaded N times are linked in `_buckets[N]`, in the order they're spreaded.
+    std::vector<Bucket> _buckets;
+
+    // Members fetched in a call, which are moved to the next buckets at last, so that
+    // they won't be visited again in the same call.
+    std::vector<uint32_t> _fetched;
 };
 
 }
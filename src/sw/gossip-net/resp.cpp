@@ -18,13 +18,54 @@
 #include "errors.h"
 #include <cassert>
 #include <charconv>
+#include <cstring>
+
+namespace {
+
+std::size_t uint_size(uint64_t num) {
+    std::size_t size = 1;
+    while (num >= 10) {
+        num /= 10;
+        ++size;
+    }
+
+    return size;
+}
+
+uint64_t abs_value(long long num) {
+    // Avoid overflow on LLONG_MIN.
+    return num < 0 ? 0 - static_cast<uint64_t>(num) : static_cast<uint64_t>(num);
+}
+
+// Format `num`, which has exactly `size` digits, in place.
+char* write_uint(char *ptr, std::size_t size, uint64_t num) {
+    auto [last, err] = std::to_chars(ptr, ptr + size, num);
+    assert(err == std::errc() && last == ptr + size);
+    (void)err;
+
+    return last;
+}
+
+char* write_crlf(char *ptr) {
+    ptr[0] = '\r';
+    ptr[1] = '\n';
+
+    return ptr + 2;
+}
+
+}
 
 namespace sw::gossip {
 
-auto RespRequestParser::parse(std::string_view buffer) const
-    -> std::pair<std::vector<RespRequest>, std::size_t> {
+auto RespRequestParser::parse(std::string_view buffer)
+    -> std::pair<Requests, std::size_t> {
+    auto args_capacity = _args.capacity();
+    auto requests_capacity = _requests.capacity();
+
+    _args.clear();
+    _requests.clear();
+
     auto *first = buffer.data();
-    std::vector<RespRequest> requests;
     std::size_t bytes_parsed = 0;
 
     while (true) {
@@ -44,42 +85,62 @@ auto RespRequestParser::parse(std::string_view buffer) const
             break;
         }
 
-        RespRequest req;
-        req.name = *argv;
+        auto name = *argv;
 
         --num;
 
-        auto &args = req.args;
-        args.reserve(num);
+        // Don't reserve `num` slots, since it's not validated yet.
+        auto arg_first = _args.size();
         auto idx = 0U;
-        for ( ; idx != *argc; ++idx) {
+        for ( ; idx != num; ++idx) {
             argv = _parse_argv(buffer);
             if (!argv) {
                 // Incomplete request.
                 break;
             }
-            args.push_back(std::move(*argv));
+            _args.push_back(*argv);
         }
 
         if (idx < num) {
             // Incomplete request.
+            _args.resize(arg_first);
             break;
         }
 
-        requests.push_back(std::move(req));
+        // Args are bound after parsing, since `_args` might be reallocated.
+        _requests.push_back(RespRequest{name, RespRequest::Args(nullptr, num)});
         bytes_parsed = (buffer.data() - first);
     }
 
-    return std::make_pair(std::move(requests), bytes_parsed);
+    const auto *args = _args.data();
+    for (auto &req : _requests) {
+        auto num = req.args.size();
+        req.args = RespRequest::Args(args, num);
+        args += num;
+    }
+
+    if (_args.capacity() != args_capacity) {
+        ++_grow_count;
+    }
+
+    if (_requests.capacity() != requests_capacity) {
+        ++_grow_count;
+    }
+
+    return std::make_pair(Requests(_requests.data(), _requests.size()), bytes_parsed);
+}
+
+void RespRequestParser::_throw_error(const char *msg) {
+    throw Error(msg);
 }
 
-std::optional<std::size_t> RespRequestParser::_parse_num(char c, std::string_view &buffer) const {
+std::optional<std::size_t> RespRequestParser::_parse_num_slow(char c, std::string_view &buffer) {
     if (buffer.empty()) {
         return std::nullopt;
     }
 
     if (buffer.front() != c) {
-        throw Error("expect " + std::string(1, c));
+        _throw_error(c == '*' ? "expect *" : "expect $");
     }
 
     buffer.remove_prefix(1);
@@ -92,15 +153,16 @@ std::optional<std::size_t> RespRequestParser::_parse_num(char c, std::string_vie
     auto *last = buffer.data() + buffer.size();
     auto [ptr, err] = std::from_chars(buffer.data(), last, argc);
     if (err != std::errc()) {
-        throw Error("expect a positive integer");
+        _throw_error("expect a positive integer");
     }
 
     if (ptr + 2 > last) {
+        // Incomplete request.
         return std::nullopt;
     }
 
     if (*ptr != '\r' || *(ptr + 1) != '\n') {
-        throw Error("expect '\\r\\n'");
+        _throw_error("expect '\\r\\n'");
     }
 
     buffer.remove_prefix(ptr + 2 - buffer.data());
@@ -108,58 +170,140 @@ std::optional<std::size_t> RespRequestParser::_parse_num(char c, std::string_vie
     return argc;
 }
 
-std::optional<std::string_view> RespRequestParser::_parse_argv(std::string_view &buffer) const {
-    // $n\r\nxxxxx\r\n
-    auto num = _parse_num('$', buffer);
-    if (!num) {
-        // Incomplete request.
-        return std::nullopt;
-    }
+RespReplyBuilder& RespReplyBuilder::append_bulk_string(const std::string_view &str) {
+    // $size\r\nstr\r\n
+    auto len_size = uint_size(str.size());
+    auto *ptr = _extend(1 + len_size + 2 + str.size() + 2);
+    *ptr++ = '$';
+    ptr = write_uint(ptr, len_size, str.size());
+    ptr = write_crlf(ptr);
+    std::memcpy(ptr, str.data(), str.size());
+    write_crlf(ptr + str.size());
+
+    return *this;
+}
 
-    auto len = *num;
+RespReplyBuilder& RespReplyBuilder::append_bulk_integer(uint64_t num) {
+    // $size\r\nnum\r\n
+    auto num_size = uint_size(num);
+    auto len_size = uint_size(num_size);
+    auto *ptr = _extend(1 + len_size + 2 + num_size + 2);
+    *ptr++ = '$';
+    ptr = write_uint(ptr, len_size, num_size);
+    ptr = write_crlf(ptr);
+    ptr = write_uint(ptr, num_size, num);
+    write_crlf(ptr);
 
-    if (buffer.size() < len + 2) {
-        return std::nullopt;
-    }
+    return *this;
+}
 
-    auto *last = buffer.data() + len;
-    if (*last != '\r' || *(last + 1) != '\n') {
-        throw Error("expect '\\r\\n'");
+RespReplyBuilder& RespReplyBuilder::append_node(const std::string_view &type,
+        const Node &node,
+        bool append_status) {
+    char ip[IpAddress::MAX_STR_SIZE];
+    append_bulk_string(type)
+        .append_bulk_string(node.id.view())
+        .append_bulk_string(std::string_view(ip, node.ip.to_chars(ip)))
+        .append_bulk_integer(node.port)
+        .append_bulk_integer(node.version);
+
+    if (append_status) {
+        append_bulk_string(utils::status_str(node.status));
     }
 
-    std::string_view argv(buffer.data(), len);
+    return *this;
+}
 
-    buffer.remove_prefix(len + 2);
+void RespReplyBuilder::reserve(std::size_t size) {
+    if (in_place()) {
+        if (_ext_size + size <= _ext_capacity) {
+            return;
+        }
 
-    return argv;
+        _spill();
+    }
+
+    _buffer.reserve(_buffer.size() + size);
 }
 
-RespReplyBuilder& RespReplyBuilder::append_bulk_string(const std::string_view &str) {
+std::size_t RespReplyBuilder::integer_size(long long num) {
+    // :num\r\n
+    return 1 + (num < 0 ? 1 : 0) + uint_size(abs_value(num)) + 2;
+}
+
+std::size_t RespReplyBuilder::bulk_string_size(std::size_t len) {
     // $size\r\nstr\r\n
-    auto len = std::to_string(str.size());
-    std::string reply;
-    reply.reserve(1 + len.size() + 2 + str.size() + 2);
-    reply.push_back('$');
-    reply.insert(reply.end(), len.data(), len.data() + len.size());
-    reply += "\r\n";
-    reply.insert(reply.end(), str.data(), str.data() + str.size());
-    reply += "\r\n";
+    return 1 + uint_size(len) + 2 + len + 2;
+}
 
-    _buffer += reply;
+std::size_t RespReplyBuilder::node_size(const std::string_view &type,
+        const Node &node,
+        bool append_status) {
+    auto size = bulk_string_size(type.size())
+        + bulk_string_size(node.id.size())
+        + bulk_string_size(node.ip.str_size())
+        + bulk_string_size(uint_size(node.port))
+        + bulk_string_size(uint_size(node.version));
+
+    if (append_status) {
+        size += bulk_string_size(std::strlen(utils::status_str(node.status)));
+    }
 
-    return *this;
+    return size;
 }
 
 RespReplyBuilder& RespReplyBuilder::_append_string(char type, const std::string_view &str) {
-    std::string reply;
-    reply.reserve(1 + str.size() + 2);
-    reply.push_back(type);
-    reply.insert(reply.end(), str.data(), str.data() + str.size());
-    reply += "\r\n";
+    auto *ptr = _extend(1 + str.size() + 2);
+    *ptr++ = type;
+    std::memcpy(ptr, str.data(), str.size());
+    write_crlf(ptr + str.size());
 
-    _buffer += reply;
+    return *this;
+}
+
+RespReplyBuilder& RespReplyBuilder::_append_integer(char type, long long num) {
+    auto num_size = uint_size(abs_value(num));
+    auto *ptr = _extend(integer_size(num));
+    *ptr++ = type;
+    if (num < 0) {
+        *ptr++ = '-';
+    }
+    ptr = write_uint(ptr, num_size, abs_value(num));
+    write_crlf(ptr);
 
     return *this;
 }
 
+void RespReplyBuilder::_append(const std::string_view &str) {
+    std::memcpy(_extend(str.size()), str.data(), str.size());
+}
+
+char* RespReplyBuilder::_extend(std::size_t size) {
+    if (in_place()) {
+        if (_ext_size + size <= _ext_capacity) {
+            auto *ptr = _ext + _ext_size;
+            _ext_size += size;
+            return ptr;
+        }
+
+        _spill();
+    }
+
+    auto old_size = _buffer.size();
+    _buffer.resize(old_size + size);
+
+    return _buffer.data() + old_size;
+}
+
+void RespReplyBuilder::_spill() {
+    if (!in_place()) {
+        return;
+    }
+
+    _buffer.assign(_ext, _ext_size);
+    _ext = nullptr;
+    _ext_size = 0;
+    _ext_capacity = 0;
+}
+
 }
@@ -17,41 +17,126 @@
 #ifndef SW_GOSSIP_NET_RESP_H
 #define SW_GOSSIP_NET_RESP_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <string_view>
 #include <optional>
+#include "utils.h"
 
 namespace sw::gossip {
 
 struct RespRequest {
     std::string_view name;
 
-    using Args = std::vector<std::string_view>;
+    using Args = ArrayView<std::string_view>;
     Args args;
 };
 
+// Parse requests into an arena owned by the parser, which is reused across calls.
+// Once the arena is large enough for the typical message, parsing doesn't allocate.
+// NOT thread-safe.
 class RespRequestParser {
 public:
-    // @return pair<vector<request>, number of bytes parsed>
-    auto parse(std::string_view data) const
-        -> std::pair<std::vector<RespRequest>, std::size_t>;
+    using Requests = ArrayView<RespRequest>;
+
+    // Returned requests refer to both `data` and the arena, and they're only
+    // valid until the next call.
+    // @return pair<requests, number of bytes parsed>
+    auto parse(std::string_view data) -> std::pair<Requests, std::size_t>;
+
+    // Number of times the arena grows. It stays unchanged in steady state.
+    std::size_t grow_count() const {
+        return _grow_count;
+    }
 
 private:
-    std::optional<std::size_t> _parse_num(char c, std::string_view &data) const;
+    std::optional<std::size_t> _parse_num(char c, std::string_view &data) {
+        // Fast path: a complete token with a short number. Anything else, including
+        // errors and incomplete tokens, goes to the slow path.
+        if (data.size() > 1 && data.front() == c) {
+            auto *first = data.data() + 1;
+            auto *last = data.data() + data.size();
+            auto *end = first + std::min<std::ptrdiff_t>(last - first, MAX_FAST_DIGITS + 1);
+            std::size_t num = 0;
+            auto *ptr = first;
+            for ( ; ptr != end; ++ptr) {
+                auto digit = static_cast<unsigned char>(*ptr - '0');
+                if (digit > 9) {
+                    break;
+                }
+                num = num * 10 + digit;
+            }
+
+            if (ptr != first && ptr - first <= MAX_FAST_DIGITS
+                    && last - ptr >= 2 && ptr[0] == '\r' && ptr[1] == '\n') {
+                data.remove_prefix(ptr + 2 - data.data());
+                return num;
+            }
+        }
+
+        return _parse_num_slow(c, data);
+    }
+
+    std::optional<std::size_t> _parse_num_slow(char c, std::string_view &data);
 
-    std::optional<std::size_t> _parse_argc(std::string_view &data) const {
+    std::optional<std::size_t> _parse_argc(std::string_view &data) {
         // *n\r\n
         return _parse_num('*', data);
     }
 
-    std::optional<std::string_view> _parse_argv(std::string_view &data) const;
+    std::optional<std::string_view> _parse_argv(std::string_view &data) {
+        // $n\r\nxxxxx\r\n
+        auto num = _parse_num('$', data);
+        if (!num) {
+            // Incomplete request.
+            return std::nullopt;
+        }
+
+        auto len = *num;
+
+        if (len > data.size() || data.size() - len < 2) {
+            return std::nullopt;
+        }
+
+        auto *last = data.data() + len;
+        if (*last != '\r' || *(last + 1) != '\n') {
+            _throw_error("expect '\\r\\n'");
+        }
+
+        std::string_view argv(data.data(), len);
+
+        data.remove_prefix(len + 2);
+
+        return argv;
+    }
+
+    // Kept out of line, so that error paths don't bloat the hot parsing loop.
+    [[noreturn]] static void _throw_error(const char *msg);
+
+    // Numbers with at most so many digits cannot overflow std::size_t.
+    static constexpr std::ptrdiff_t MAX_FAST_DIGITS = 9;
+
+    // Args of all requests. Each request's args are stored consecutively.
+    std::vector<std::string_view> _args;
+
+    std::vector<RespRequest> _requests;
+
+    std::size_t _grow_count = 0;
 };
 
 class RespReplyBuilder {
 public:
+    RespReplyBuilder() = default;
+
+    // Build the reply in place with the given buffer. If the reply outgrows
+    // the buffer, it's copied to an internal string, which grows as needed.
+    RespReplyBuilder(char *buf, std::size_t capacity) : _ext(buf), _ext_capacity(capacity) {}
+
     RespReplyBuilder& append_ok() {
-        _buffer += "+OK\r\n";
+        _append("+OK\r\n");
         return *this;
     }
 
@@ -67,29 +152,85 @@ public:
 
     RespReplyBuilder& append_integer(long long num) {
         // :num\r\n
-        return _append_string(':', std::to_string(num));
+        return _append_integer(':', num);
     }
 
     RespReplyBuilder& append_bulk_string(const std::string_view &str);
 
+    // Append the number as a bulk string, without converting it to std::string.
+    RespReplyBuilder& append_bulk_integer(uint64_t num);
+
     RespReplyBuilder& append_nil() {
         // $-1\r\n
-        _buffer += "$-1\r\n";
+        _append("$-1\r\n");
         return *this;
     }
 
     RespReplyBuilder& append_array(long long size) {
         // *num\r\n
-        return _append_string('*', std::to_string(size));
+        return _append_integer('*', size);
     }
 
+    // Append 5 bulk strings: type id ip port version, and status if `append_status` is true.
+    RespReplyBuilder& append_node(const std::string_view &type,
+            const Node &node,
+            bool append_status = true);
+
+    // Make sure that `size` more bytes can be appended without reallocation.
+    // If they don't fit into the buffer passed to constructor, the reply is spilled.
+    void reserve(std::size_t size);
+
+    // Encoded sizes, with which the exact size of a reply can be computed before building it.
+    static std::size_t integer_size(long long num);
+
+    static std::size_t bulk_string_size(std::size_t len);
+
+    static std::size_t node_size(const std::string_view &type,
+            const Node &node,
+            bool append_status = true);
+
+    // Whether the reply is still in the buffer passed to constructor.
+    bool in_place() const {
+        return _ext != nullptr;
+    }
+
+    std::size_t size() const {
+        return in_place() ? _ext_size : _buffer.size();
+    }
+
+    std::string_view view() const {
+        if (in_place()) {
+            return {_ext, _ext_size};
+        }
+
+        return _buffer;
+    }
+
+    // If the reply is built in place, it's copied to the internal string.
     std::string& data() {
+        _spill();
         return _buffer;
     }
 
 private:
     RespReplyBuilder& _append_string(char type, const std::string_view &str);
 
+    RespReplyBuilder& _append_integer(char type, long long num);
+
+    void _append(const std::string_view &str);
+
+    // @return where to write the next `size` bytes, which are counted as appended.
+    char* _extend(std::size_t size);
+
+    void _spill();
+
+    // External buffer, and it's set to nullptr once the reply outgrows it.
+    char *_ext = nullptr;
+
+    std::size_t _ext_size = 0;
+
+    std::size_t _ext_capacity = 0;
+
     std::string _buffer;
 };
 
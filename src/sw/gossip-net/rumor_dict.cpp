@@ -0,0 +1,281 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "rumor_dict.h"
+#include <algorithm>
+#include <cassert>
+
+namespace sw::gossip {
+
+RumorDictionary::RumorDictionary(std::size_t capacity, uint64_t epoch) :
+    _capacity(std::min(capacity, MAX_CAPACITY)),
+    _epoch(epoch) {
+    // Epoch 0 means unknown.
+    if (_epoch == 0) {
+        _epoch = 1;
+    }
+}
+
+DictHeader RumorDictionary::begin_message() {
+    auto header = this->header();
+
+    ++_seq;
+    auto &pending = _pending[_seq % WINDOW];
+    // The previous message in this slot is out of the window, and its DEFINEs
+    // that have not been acked are sent again.
+    pending.seq = _seq;
+    pending.defines.clear();
+
+    return header;
+}
+
+RumorCode RumorDictionary::encode(const Node &node) {
+    std::optional<uint32_t> index;
+    auto iter = _index.find(node.id);
+    if (iter != _index.end()) {
+        auto &entry = _entries[iter->second];
+        if (entry.ip == node.ip && entry.port == node.port) {
+            if (entry.acked) {
+                return {RumorKind::REF, iter->second};
+            }
+
+            // Not acked yet, and the previous DEFINE might be lost.
+            index = iter->second;
+        } else {
+            // Address changed, and the old index cannot be reused right now, since
+            // the peer might still refer to the old address with it.
+            _release(iter->second);
+            _index.erase(iter);
+        }
+    }
+
+    if (!index) {
+        index = _allocate();
+        if (!index) {
+            return {RumorKind::FULL, 0};
+        }
+
+        auto &entry = _entries[*index];
+        entry.id = node.id;
+        entry.ip = node.ip;
+        entry.port = node.port;
+        entry.used = true;
+        entry.acked = false;
+
+        _index.emplace(node.id, *index);
+    }
+
+    auto &pending = _pending[_seq % WINDOW];
+    assert(pending.seq == _seq);
+    pending.defines.push_back(Define{*index, _entries[*index].generation});
+
+    return {RumorKind::DEFINE, *index};
+}
+
+std::size_t RumorDictionary::size(const Node &node) const {
+    auto iter = _index.find(node.id);
+    if (iter != _index.end()) {
+        const auto &entry = _entries[iter->second];
+        if (entry.ip == node.ip && entry.port == node.port) {
+            auto kind = entry.acked ? RumorKind::REF : RumorKind::DEFINE;
+            return binary::rumor_size(node, {kind, iter->second});
+        }
+    }
+
+    if (!_can_allocate()) {
+        return binary::rumor_size(node, {RumorKind::FULL, 0});
+    }
+
+    // Several new nodes might be added to a message, so take the largest index.
+    return binary::rumor_size(node, {RumorKind::DEFINE, _capacity - 1});
+}
+
+void RumorDictionary::remove(const NodeId &id) {
+    auto iter = _index.find(id);
+    if (iter == _index.end()) {
+        return;
+    }
+
+    _release(iter->second);
+    _index.erase(iter);
+}
+
+bool RumorDictionary::on_header(const DictHeader &header) {
+    if (header.epoch != _peer_epoch) {
+        if (_peer_epoch != 0) {
+            // Peer has created its dictionary again, and lost entries learned from us.
+            _reset_acks();
+        }
+
+        _peer_epoch = header.epoch;
+        _peer_entries.clear();
+        _peer_seq = 0;
+        _peer_bits = 0;
+    }
+
+    if (header.peer_epoch == _epoch) {
+        _on_ack(header.ack_seq, header.ack_bits);
+    }
+
+    return _receive(header.seq);
+}
+
+bool RumorDictionary::decode(Node &node, const RumorCode &code) {
+    switch (code.kind) {
+    case RumorKind::FULL:
+        return true;
+
+    case RumorKind::DEFINE:
+        if (!valid(code)) {
+            return false;
+        }
+
+        if (code.index >= _peer_entries.size()) {
+            _peer_entries.resize(code.index + 1);
+        }
+
+        _peer_entries[code.index] = PeerEntry{node.id, node.ip, node.port, true};
+
+        return true;
+
+    case RumorKind::REF: {
+        if (code.index >= _peer_entries.size() || !_peer_entries[code.index].valid) {
+            return false;
+        }
+
+        const auto &entry = _peer_entries[code.index];
+        node.id = entry.id;
+        node.ip = entry.ip;
+        node.port = entry.port;
+
+        return true;
+    }
+
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+std::optional<uint32_t> RumorDictionary::_allocate() {
+    if (!_free_list.empty() && _free_list.front().release_seq + WINDOW <= _acked_seq) {
+        // The peer has received WINDOW messages after the last one referring to
+        // the removed member, so that it treats those messages as stale.
+        auto index = _free_list.front().index;
+        _free_list.pop_front();
+
+        return index;
+    }
+
+    if (_entries.size() < _capacity) {
+        _entries.emplace_back();
+
+        return static_cast<uint32_t>(_entries.size() - 1);
+    }
+
+    return std::nullopt;
+}
+
+bool RumorDictionary::_can_allocate() const {
+    return (!_free_list.empty() && _free_list.front().release_seq + WINDOW <= _acked_seq)
+        || _entries.size() < _capacity;
+}
+
+void RumorDictionary::_release(uint32_t index) {
+    auto &entry = _entries[index];
+    assert(entry.used);
+
+    entry.used = false;
+    entry.acked = false;
+    ++entry.generation;
+
+    _free_list.push_back(FreeIndex{index, _seq});
+}
+
+void RumorDictionary::_on_ack(uint64_t ack_seq, uint32_t ack_bits) {
+    if (ack_seq == 0 || ack_seq > _seq) {
+        // Nothing received, or it's not a message we've sent.
+        return;
+    }
+
+    // Acks might be reordered, and acking a message twice is harmless.
+    _ack(ack_seq);
+    for (uint64_t bit = 0; bit != WINDOW && bit + 1 < ack_seq; ++bit) {
+        if ((ack_bits >> bit) & 1) {
+            _ack(ack_seq - 1 - bit);
+        }
+    }
+
+    _acked_seq = std::max(_acked_seq, ack_seq);
+}
+
+void RumorDictionary::_ack(uint64_t seq) {
+    auto &pending = _pending[seq % WINDOW];
+    if (pending.seq != seq) {
+        // Out of the window.
+        return;
+    }
+
+    for (const auto &define : pending.defines) {
+        auto &entry = _entries[define.index];
+        if (entry.used && entry.generation == define.generation) {
+            entry.acked = true;
+        }
+    }
+
+    pending.defines.clear();
+}
+
+void RumorDictionary::_reset_acks() {
+    for (auto &entry : _entries) {
+        entry.acked = false;
+    }
+
+    for (auto &pending : _pending) {
+        pending.defines.clear();
+    }
+}
+
+bool RumorDictionary::_receive(uint64_t seq) {
+    if (seq > _peer_seq) {
+        auto shift = seq - _peer_seq;
+        _peer_bits = shift < WINDOW ? _peer_bits << shift : 0;
+        if (_peer_seq != 0 && shift <= WINDOW) {
+            _peer_bits |= uint32_t(1) << (shift - 1);
+        }
+
+        _peer_seq = seq;
+
+        return true;
+    }
+
+    auto distance = _peer_seq - seq;
+    if (distance == 0) {
+        // Duplicate.
+        return true;
+    }
+
+    if (distance > WINDOW) {
+        return false;
+    }
+
+    // Reordered, but it's still in the window.
+    _peer_bits |= uint32_t(1) << (distance - 1);
+
+    return true;
+}
+
+}
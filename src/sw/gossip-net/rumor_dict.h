@@ -0,0 +1,189 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_RUMOR_DICT_H
+#define SW_GOSSIP_NET_RUMOR_DICT_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "binary_codec.h"
+#include "utils.h"
+
+namespace sw::gossip {
+
+// Dictionary coding of rumors exchanged with a peer. A member's id, ip and port are
+// sent once with an index, i.e. DEFINE, and once the peer has acked the message with
+// the DEFINE, later rumors about the member only carry the index, version and status,
+// i.e. REF.
+//
+// Messages are numbered, and each side acks the latest message it has received from
+// the other, and a bitmap of the WINDOW messages before it. So acks are per message,
+// and reordered or stale acks never revoke entries. Messages older than the window are
+// stale, and their REFs are dropped. An index of a removed member is reused only after
+// the peer has received WINDOW more messages, so that messages still referring to the
+// old member are stale by the time the index is defined again. If the peer loses the
+// dictionary, e.g. it restarts with a new epoch, all entries are defined again.
+// Indexes the peer defines are bounded by the local capacity, so that a peer cannot
+// make us hold more entries than configured.
+// NOT thread-safe, and should only be used in the event loop thread of the owner shard.
+class RumorDictionary {
+public:
+    // Max number of entries.
+    static constexpr std::size_t MAX_CAPACITY = 1 << 16;
+
+    // Number of messages before the latest one, whose receipt is acked.
+    static constexpr uint64_t WINDOW = 32;
+
+    RumorDictionary(std::size_t capacity, uint64_t epoch);
+
+    // Header of the next message sent to the peer, e.g. to estimate its size.
+    DictHeader header() const {
+        return {_epoch, _seq + 1, _peer_epoch, _peer_seq, _peer_bits};
+    }
+
+    // Start the next message sent to the peer. Rumors encoded after it belong to it.
+    // @return header of the message.
+    DictHeader begin_message();
+
+    // How to code the node in the current message. If the node is not in the
+    // dictionary, and there's room, an index is assigned to it.
+    RumorCode encode(const Node &node);
+
+    // Encoded size of the node, without assigning index.
+    std::size_t size(const Node &node) const;
+
+    // Remove the member, e.g. it has been reaped, so that its index can be reused.
+    void remove(const NodeId &id);
+
+    // Update with the header of a message received from the peer.
+    // @return false, if the message is stale. Then its REF rumors cannot be resolved,
+    //         and its DEFINE rumors should not be learned.
+    bool on_header(const DictHeader &header);
+
+    // Whether the index of a rumor received from the peer is within the capacity. A peer
+    // with a larger capacity might define indexes beyond it.
+    bool valid(const RumorCode &code) const {
+        return code.kind == RumorKind::FULL || code.index < _capacity;
+    }
+
+    // Resolve a rumor received from the peer in place, and learn DEFINE entries.
+    // @return false, if it's a REF whose index is unknown, i.e. a dictionary miss,
+    //         or the index is not valid.
+    bool decode(Node &node, const RumorCode &code);
+
+private:
+    // Own dictionary.
+    struct Entry {
+        NodeId id;
+
+        IpAddress ip;
+
+        uint16_t port = 0;
+
+        // Distinguish members reusing the same index, so that an ack of a DEFINE
+        // never acks the entry of another member.
+        uint32_t generation = 0;
+
+        bool used = false;
+
+        // Whether the peer has received a DEFINE of the entry.
+        bool acked = false;
+    };
+
+    struct Define {
+        uint32_t index;
+
+        uint32_t generation;
+    };
+
+    // DEFINE rumors of a message, which are acked with the message.
+    struct Pending {
+        uint64_t seq = 0;
+
+        std::vector<Define> defines;
+    };
+
+    struct FreeIndex {
+        uint32_t index;
+
+        // The last message that might refer to the removed member.
+        uint64_t release_seq;
+    };
+
+    std::optional<uint32_t> _allocate();
+
+    bool _can_allocate() const;
+
+    void _release(uint32_t index);
+
+    void _on_ack(uint64_t ack_seq, uint32_t ack_bits);
+
+    void _ack(uint64_t seq);
+
+    void _reset_acks();
+
+    // @return false, if the message is stale.
+    bool _receive(uint64_t seq);
+
+    std::size_t _capacity;
+
+    uint64_t _epoch;
+
+    std::vector<Entry> _entries;
+
+    std::unordered_map<NodeId, uint32_t> _index;
+
+    // Released indexes in order of release.
+    std::deque<FreeIndex> _free_list;
+
+    // Sequence number of the current message.
+    uint64_t _seq = 0;
+
+    // The latest message that the peer has received.
+    uint64_t _acked_seq = 0;
+
+    // Messages not acked yet, indexed by seq % WINDOW.
+    std::array<Pending, WINDOW> _pending;
+
+    // Peer's dictionary.
+    struct PeerEntry {
+        NodeId id;
+
+        IpAddress ip;
+
+        uint16_t port = 0;
+
+        bool valid = false;
+    };
+
+    uint64_t _peer_epoch = 0;
+
+    std::vector<PeerEntry> _peer_entries;
+
+    // The latest message received from the peer, and bit N of `_peer_bits` is set,
+    // if message `_peer_seq - 1 - N` has been received.
+    uint64_t _peer_seq = 0;
+
+    uint32_t _peer_bits = 0;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_RUMOR_DICT_H
@@ -0,0 +1,115 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_SPSC_QUEUE_H
+#define SW_GOSSIP_NET_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "errors.h"
+
+namespace sw::gossip {
+
+// Bounded lock-free ring buffer with a single producer and a single consumer.
+// Each side caches the other side's position, so that it touches the shared
+// cache line only when the cached position says the queue is full or empty.
+template <typename T>
+class SpscQueue {
+public:
+    // `capacity` is rounded up to power of 2.
+    explicit SpscQueue(std::size_t capacity) {
+        if (capacity == 0) {
+            throw Error("queue capacity should be positive");
+        }
+
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        _items = std::make_unique<T[]>(size);
+        _mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue& operator=(const SpscQueue &) = delete;
+
+    SpscQueue(SpscQueue &&) = delete;
+    SpscQueue& operator=(SpscQueue &&) = delete;
+
+    ~SpscQueue() = default;
+
+    // Producer only.
+    // @return false if queue is full, and `item` is NOT moved.
+    bool try_push(T &item) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head > _mask) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head > _mask) {
+                // Full.
+                return false;
+            }
+        }
+
+        _items[tail & _mask] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer only.
+    // @return false if queue is empty.
+    bool try_pop(T &item) {
+        auto head = _head.load(std::memory_order_relaxed);
+        if (head == _cached_tail) {
+            _cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _cached_tail) {
+                // Empty.
+                return false;
+            }
+        }
+
+        item = std::move(_items[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    std::size_t capacity() const {
+        return _mask + 1;
+    }
+
+private:
+    // Avoid false sharing between the producer and the consumer.
+    static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+    std::unique_ptr<T[]> _items;
+
+    std::size_t _mask = 0;
+
+    // Written by the consumer, and `_cached_tail` is its copy of `_tail`.
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> _head{0};
+    std::size_t _cached_tail = 0;
+
+    // Written by the producer, and `_cached_head` is its copy of `_head`.
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> _tail{0};
+    std::size_t _cached_head = 0;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_SPSC_QUEUE_H
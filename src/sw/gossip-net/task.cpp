@@ -15,16 +15,21 @@
  *************************************************************************/
 
 #include "task.h"
+#include "gossip_net.h"
 
 namespace sw::gossip {
 
-PingReqTask::PingReqTask(const std::string &dest, const Node &peer, GossipNet &net) :
-    Task(peer.id), _dest(dest), _peer(peer), _net(net) {}
+void ProbeTask::on_timeout() {
+    _net.ping_req(_node);
+}
 
-std::unique_ptr<Task> PingReqTask::run() const {
-    _net.ack(_dest, peer);
+void IndirectProbeTask::on_timeout() {
+    _net.suspect(_node);
+}
 
-    return nullptr;
+void PingReqTask::on_ack() {
+    // Ack as if it's sent by `dest`.
+    _net.ack(_requester, _dest);
 }
 
 }
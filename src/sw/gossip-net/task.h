@@ -22,41 +22,76 @@
 
 namespace sw::gossip {
 
-enum class TaskType {
-    PING = 0,
-    PING_REQ
-    SUSPECTED,
-    PASSIVE_PING
-};
+class GossipNet;
 
+// A task waiting for an ack from the node with the given id.
 class Task {
 public:
-    explicit Task(const std::string &id) : _id(id) {}
+    explicit Task(const NodeId &id) : _id(id) {}
 
     virtual ~Task() = default;
 
-    virtual std::unique_ptr<Task> run() const = 0;
+    // Called when an ack from the node is received.
+    virtual void on_ack() = 0;
+
+    // Called when no ack is received in time.
+    virtual void on_timeout() = 0;
 
-    const std::string& id() const {
+    const NodeId& id() const {
         return _id;
     }
 
 private:
-    std::string _id;
+    NodeId _id;
 };
 
 using TaskUPtr = std::unique_ptr<Task>;
 
+// Wait for an ack of the direct ping. If it's timed out, probe the node indirectly.
+class ProbeTask : public Task {
+public:
+    ProbeTask(const Node &node, GossipNet &net) : Task(node.id), _node(node), _net(net) {}
+
+    virtual void on_ack() override {}
+
+    virtual void on_timeout() override;
+
+private:
+    Node _node;
+
+    GossipNet &_net;
+};
+
+// Wait for an ack relayed by other members. If it's timed out, suspect the node.
+class IndirectProbeTask : public Task {
+public:
+    IndirectProbeTask(const Node &node, GossipNet &net) : Task(node.id), _node(node), _net(net) {}
+
+    virtual void on_ack() override {}
+
+    virtual void on_timeout() override;
+
+private:
+    Node _node;
+
+    GossipNet &_net;
+};
+
+// Ping `dest` on behalf of `requester`, and relay the ack back to it.
 class PingReqTask : public Task {
 public:
-    PingReqTask(const std::string &id, const Node &node, GossipNet &net);
+    PingReqTask(const Node &dest, const Node &requester, GossipNet &net) :
+        Task(dest.id), _dest(dest), _requester(requester), _net(net) {}
+
+    virtual void on_ack() override;
 
-    virtual std::unique_ptr<Task> run() const override;
+    // The requester will suspect the node, if no one relays the ack.
+    virtual void on_timeout() override {}
 
 private:
     Node _dest;
 
-    Node _peer;
+    Node _requester;
 
     GossipNet &_net;
 };
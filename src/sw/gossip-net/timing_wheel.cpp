@@ -0,0 +1,208 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "timing_wheel.h"
+#include <algorithm>
+#include <cassert>
+#include "errors.h"
+#include "logger.h"
+
+namespace sw::gossip {
+
+TimingWheel::TimingWheel(const std::chrono::milliseconds &tick, uint64_t now) {
+    if (tick.count() <= 0) {
+        throw Error("timer tick should be positive");
+    }
+
+    _tick = tick.count();
+    _current = _to_tick(now);
+
+    _slots.fill(INVALID_INDEX);
+}
+
+TimerHandle TimingWheel::schedule(const std::chrono::milliseconds &timeout,
+        std::function<void ()> callback) {
+    if (!callback) {
+        throw Error("null timer callback");
+    }
+
+    uint32_t index = 0;
+    if (!_free_list.empty()) {
+        index = _free_list.back();
+        _free_list.pop_back();
+    } else {
+        if (_timers.size() >= INVALID_INDEX) {
+            throw Error("too many timers");
+        }
+
+        index = static_cast<uint32_t>(_timers.size());
+        _timers.emplace_back();
+    }
+
+    auto ticks = (std::max<int64_t>(timeout.count(), 0) + _tick - 1) / _tick;
+
+    auto &timer = _timers[index];
+    timer.callback = std::move(callback);
+    // Expire at least one tick later, since the current tick has been processed.
+    timer.expire = _current + std::max<uint64_t>(ticks, 1);
+
+    _link(index);
+    ++_size;
+
+    return {index, timer.generation};
+}
+
+bool TimingWheel::cancel(const TimerHandle &handle) {
+    if (!handle.valid() || handle.index >= _timers.size()) {
+        return false;
+    }
+
+    auto &timer = _timers[handle.index];
+    if (timer.generation != handle.generation || timer.slot == INVALID_INDEX) {
+        return false;
+    }
+
+    _unlink(handle.index);
+    _release(handle.index);
+
+    return true;
+}
+
+void TimingWheel::advance(uint64_t now) {
+    auto target = _to_tick(now);
+    if (_size == 0) {
+        // Fast path for idle wheel.
+        _current = std::max(_current, target);
+        return;
+    }
+
+    while (_current < target) {
+        ++_current;
+
+        // Cascade timers from higher levels when lower levels wrap around.
+        for (std::size_t level = 1; level != LEVEL_NUM; ++level) {
+            if (((_current >> (SLOT_BITS * (level - 1))) & SLOT_MASK) != 0) {
+                break;
+            }
+
+            _cascade(level);
+        }
+
+        _expire();
+
+        if (_size == 0) {
+            _current = target;
+        }
+    }
+}
+
+void TimingWheel::_link(uint32_t index) {
+    auto &timer = _timers[index];
+    assert(timer.expire >= _current);
+
+    auto delta = std::min(timer.expire - _current, MAX_TICKS);
+    // Timers beyond the wheel are put into the farthest slot, and rescheduled from there.
+    auto expire = _current + delta;
+
+    std::size_t level = 0;
+    while (level + 1 < LEVEL_NUM && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+
+    auto slot = static_cast<uint32_t>(level * SLOT_NUM +
+            ((expire >> (SLOT_BITS * level)) & SLOT_MASK));
+
+    auto &head = _slots[slot];
+    timer.slot = slot;
+    timer.prev = INVALID_INDEX;
+    timer.next = head;
+    if (head != INVALID_INDEX) {
+        _timers[head].prev = index;
+    }
+    head = index;
+}
+
+void TimingWheel::_unlink(uint32_t index) {
+    auto &timer = _timers[index];
+    assert(timer.slot != INVALID_INDEX);
+
+    if (timer.prev != INVALID_INDEX) {
+        _timers[timer.prev].next = timer.next;
+    } else {
+        _slots[timer.slot] = timer.next;
+    }
+
+    if (timer.next != INVALID_INDEX) {
+        _timers[timer.next].prev = timer.prev;
+    }
+
+    timer.prev = timer.next = timer.slot = INVALID_INDEX;
+}
+
+void TimingWheel::_cascade(std::size_t level) {
+    auto slot = level * SLOT_NUM + ((_current >> (SLOT_BITS * level)) & SLOT_MASK);
+
+    auto index = _slots[slot];
+    _slots[slot] = INVALID_INDEX;
+    while (index != INVALID_INDEX) {
+        auto &timer = _timers[index];
+        auto next = timer.next;
+
+        timer.prev = timer.next = timer.slot = INVALID_INDEX;
+        // If it expires on the current tick, it's linked to the current slot
+        // of level 0, and runs right after cascading.
+        _link(index);
+
+        index = next;
+    }
+}
+
+void TimingWheel::_expire() {
+    auto slot = _current & SLOT_MASK;
+    while (_slots[slot] != INVALID_INDEX) {
+        auto index = _slots[slot];
+        auto &timer = _timers[index];
+        _unlink(index);
+
+        if (timer.expire > _current) {
+            // It's beyond the wheel when scheduled, reschedule it.
+            _link(index);
+            continue;
+        }
+
+        auto callback = std::move(timer.callback);
+        _release(index);
+
+        try {
+            callback();
+        } catch (const Error &err) {
+            SW_GOSSIP_LOG_ERROR_RL("failed to run timer: %s", err.what());
+        }
+    }
+}
+
+void TimingWheel::_release(uint32_t index) {
+    auto &timer = _timers[index];
+    timer.callback = nullptr;
+    // Invalidate outstanding handles.
+    ++timer.generation;
+    _free_list.push_back(index);
+
+    assert(_size > 0);
+    --_size;
+}
+
+}
@@ -0,0 +1,141 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_TIMING_WHEEL_H
+#define SW_GOSSIP_NET_TIMING_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace sw::gossip {
+
+// Handle of a timer scheduled in TimingWheel.
+struct TimerHandle {
+    static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+    uint32_t index = INVALID_INDEX;
+
+    // Distinguish timers reusing the same slot, so that canceling a fired
+    // or canceled timer never cancels another one.
+    uint32_t generation = 0;
+
+    bool valid() const {
+        return index != INVALID_INDEX;
+    }
+};
+
+// Hierarchical timing wheel with LEVEL_NUM levels of SLOT_NUM slots. A slot of level N
+// covers SLOT_NUM^N ticks, and timers are cascaded to lower levels when time goes by.
+// Timers are kept in a slab and linked into slots with intrusive lists, so that both
+// scheduling and canceling are O(1). NOT thread-safe.
+class TimingWheel {
+public:
+    // `now` is the current time in milliseconds, e.g. uv_now.
+    TimingWheel(const std::chrono::milliseconds &tick, uint64_t now);
+
+    TimingWheel(const TimingWheel &) = delete;
+    TimingWheel& operator=(const TimingWheel &) = delete;
+
+    TimingWheel(TimingWheel &&) = delete;
+    TimingWheel& operator=(TimingWheel &&) = delete;
+
+    ~TimingWheel() = default;
+
+    // Run `callback` once after `timeout`. The timeout is rounded up to ticks.
+    TimerHandle schedule(const std::chrono::milliseconds &timeout, std::function<void ()> callback);
+
+    // @return false, if the timer has already fired or been canceled.
+    bool cancel(const TimerHandle &handle);
+
+    // Run callbacks of expired timers. Callbacks might schedule or cancel timers.
+    void advance(uint64_t now);
+
+    // Number of outstanding timers.
+    std::size_t size() const {
+        return _size;
+    }
+
+    std::chrono::milliseconds tick() const {
+        return std::chrono::milliseconds(_tick);
+    }
+
+private:
+    static constexpr uint32_t INVALID_INDEX = TimerHandle::INVALID_INDEX;
+
+    static constexpr std::size_t SLOT_BITS = 6;
+
+    static constexpr std::size_t SLOT_NUM = 1 << SLOT_BITS;
+
+    static constexpr std::size_t SLOT_MASK = SLOT_NUM - 1;
+
+    // With 10ms ticks, it covers about 4.6 hours. Longer timers are rescheduled
+    // when they reach the end of the wheel.
+    static constexpr std::size_t LEVEL_NUM = 4;
+
+    static constexpr uint64_t MAX_TICKS = (uint64_t(1) << (SLOT_BITS * LEVEL_NUM)) - 1;
+
+    struct Timer {
+        std::function<void ()> callback;
+
+        // Tick on which the timer expires.
+        uint64_t expire = 0;
+
+        uint32_t prev = INVALID_INDEX;
+
+        uint32_t next = INVALID_INDEX;
+
+        // Index in `_slots`, or INVALID_INDEX if the timer is not scheduled.
+        uint32_t slot = INVALID_INDEX;
+
+        uint32_t generation = 0;
+    };
+
+    uint64_t _to_tick(uint64_t ms) const {
+        return ms / _tick;
+    }
+
+    void _link(uint32_t index);
+
+    void _unlink(uint32_t index);
+
+    void _cascade(std::size_t level);
+
+    void _expire();
+
+    void _release(uint32_t index);
+
+    uint64_t _tick;
+
+    // The last tick that has been processed.
+    uint64_t _current;
+
+    std::vector<Timer> _timers;
+
+    std::vector<uint32_t> _free_list;
+
+    // Heads of timer lists.
+    std::array<uint32_t, SLOT_NUM * LEVEL_NUM> _slots;
+
+    std::size_t _size = 0;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_TIMING_WHEEL_H
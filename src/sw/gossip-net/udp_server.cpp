@@ -15,53 +15,108 @@
  *************************************************************************/
 
 #include "udp_server.h"
+#include <algorithm>
 #include <cassert>
-#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include "binary_codec.h"
+#include "compression.h"
+#include "logger.h"
 
 namespace sw::gossip {
 
+namespace {
+
+// libuv splits a recvmmsg buffer into chunks of 64KB, i.e. max UDP datagram size,
+// and receives at most 20 datagrams per call.
+constexpr std::size_t UV_UDP_DGRAM_MAX_SIZE = 64 * 1024;
+constexpr std::size_t UV_UDP_MMSG_MAX_WIDTH = 20;
+
+// Max number of messages that the kernel accepts with a single sendmmsg call, i.e. UIO_MAXIOV.
+constexpr std::size_t SENDMMSG_MAX_WIDTH = 1024;
+
+// Max size of a decompressed datagram, which guards against decompression bombs.
+constexpr std::size_t MAX_DECOMPRESSED_SIZE = 16 * UV_UDP_DGRAM_MAX_SIZE;
+
+std::size_t recv_batch_size(const UdpServerOptions &opts) {
+    return std::min(opts.recv_batch_size, UV_UDP_MMSG_MAX_WIDTH);
+}
+
+std::size_t recv_buffer_size(const UdpServerOptions &opts) {
+    auto batch_size = recv_batch_size(opts);
+    if (batch_size > 1) {
+        return batch_size * UV_UDP_DGRAM_MAX_SIZE;
+    }
+
+    return opts.buffer_size;
+}
+
+}
+
 void UdpServer::_on_alloc(uv_handle_t *handle, size_t /*suggested_size*/, uv_buf_t *buf) {
     assert(handle != nullptr && buf != nullptr);
 
     auto *server = uv::get_data<UdpServer>(handle);
     assert(server != nullptr);
 
-    buf->base = server->_buffer.data();
-    buf->len = server->_buffer.size();
+    auto &pool = server->_recv_buffers;
+    auto *buffer = pool.acquire();
+    if (buffer == nullptr) {
+        // All buffers are in use, libuv will call _on_read with UV_ENOBUFS.
+        buf->base = nullptr;
+        buf->len = 0;
+    } else {
+        buf->base = buffer;
+        buf->len = pool.buffer_size();
+    }
 }
 
 void UdpServer::_on_read(uv_udp_t *req, ssize_t nread,
-        const uv_buf_t *buf, const sockaddr *addr, unsigned /*flags*/) {
-    assert(req != nullptr);
+        const uv_buf_t *buf, [[maybe_unused]] const sockaddr *addr, unsigned flags) {
+    assert(req != nullptr && buf != nullptr);
 
     auto *server = uv::get_data<UdpServer>(req);
     assert(server != nullptr);
 
-    if (nread == 0) {
-        return;
+    if (nread > 0) {
+        SW_GOSSIP_LOG_TRACE("on read: %.*s", static_cast<int>(nread), buf->base);
+        assert(buf->base != nullptr && addr != nullptr);
+
+        // With recvmmsg, each datagram is a chunk of the slab, and handled in place.
+        server->_handle(std::string_view(buf->base, nread));
+    } else if (nread == UV_ENOBUFS) {
+        SW_GOSSIP_LOG_ERROR_RL("read error: no receive buffer available");
     } else if (nread < 0) {
-        std::cerr << "read error: " << uv::err_msg(nread) << std::endl;
+        SW_GOSSIP_LOG_ERROR("read error: %s", uv_strerror(static_cast<int>(nread)));
         uv::handle_close(req, nullptr);
         // TODO: recreate udp socket
-    } else {
-        std::cout << "on read: " << std::string(buf->base, nread) << std::endl;
-        assert(buf != nullptr && buf->base != nullptr && addr != nullptr);
+    }
 
-        server->_handle(std::string_view(buf->base, nread));
+    // All datagrams received by a single recvmmsg call share the same slab, and
+    // libuv marks them with UV_UDP_MMSG_CHUNK. The slab can only be released
+    // with the last callback, i.e. the one without this flag.
+    if ((flags & UV_UDP_MMSG_CHUNK) == 0) {
+        server->_recv_buffers.release(buf->base);
     }
 }
 
 void UdpServer::_on_send(uv_udp_send_t *req, int status) {
     assert(req != nullptr);
 
+    auto *server = uv::get_data<UdpServer>(req->handle);
+    assert(server != nullptr);
+
     if (status != 0) {
-        std::cerr << "failed to do send: " << uv::err_msg(status) << std::endl;
+        SW_GOSSIP_LOG_ERROR_RL("failed to do send: %s", uv_strerror(status));
+
+        server->_stats.send_errors.fetch_add(1, std::memory_order_relaxed);
     }
 
     auto *ctx = uv::get_data<SendContext>(req);
+    assert(ctx != nullptr);
 
-    delete ctx;
-    delete req;
+    server->_release(ctx->datagram);
+    server->_send_contexts.release(ctx);
 }
 
 void UdpServer::_on_event(uv_async_t *handle) {
@@ -70,24 +125,78 @@ void UdpServer::_on_event(uv_async_t *handle) {
     auto *server = uv::get_data<UdpServer>(handle);
     assert(server != nullptr);
 
-    std::vector<Event> events;
-    {
-        std::lock_guard<std::mutex> lock(server->_mtx);
-        events.swap(server->_events);
+    server->_run_tasks();
+    server->_drain_events();
+
+    if (server->_stopping.load(std::memory_order_acquire)) {
+        uv_stop(server->_loop.get());
+    }
+}
+
+void UdpServer::_on_check(uv_check_t *handle) {
+    assert(handle != nullptr);
+
+    auto *server = uv::get_data<UdpServer>(handle);
+    assert(server != nullptr);
+
+    server->_flush();
+}
+
+void UdpServer::_on_idle(uv_idle_t *handle) {
+    assert(handle != nullptr);
+
+    auto *server = uv::get_data<UdpServer>(handle);
+    assert(server != nullptr);
+
+    // Tasks deferred by these tasks run in the next iteration.
+    std::vector<std::function<void ()>> tasks;
+    tasks.swap(server->_deferred);
+    for (auto &task : tasks) {
+        task();
     }
 
-    for (auto &event : events) {
-        server->_send(std::move(event));
+    if (server->_deferred.empty()) {
+        uv_idle_stop(handle);
+    }
+}
+
+void UdpServer::_on_tick(uv_timer_t *handle) {
+    assert(handle != nullptr);
+
+    auto *server = uv::get_data<UdpServer>(handle);
+    assert(server != nullptr);
+
+    auto &timers = server->_timers;
+    timers.advance(uv_now(server->_loop.get()));
+
+    if (timers.size() == 0) {
+        uv_timer_stop(handle);
     }
 }
 
 UdpServer::UdpServer(const UdpServerOptions &opts) :
     _loop(uv::make_loop()),
-    _buffer(opts.buffer_size) {
-    UdpOptions udp_opts = {opts.ip, opts.port};
+    _timers(opts.timer_tick, uv_now(_loop.get())),
+    _recv_buffers(recv_buffer_size(opts), std::max<std::size_t>(opts.recv_buffer_num, 1)),
+    _events(opts.send_queue_size),
+    _tasks(opts.task_queue_size),
+    _overflow_policy(opts.send_overflow_policy),
+    _send_buffers(opts.send_buffer_size, opts.send_buffer_num),
+    _send_contexts(opts.send_context_num) {
+    UdpOptions udp_opts = {opts.ip, opts.port, recv_batch_size(opts) > 1, opts.reuseport};
 
     _server = uv::make_udp_server(*_loop, udp_opts, this);
     _async = uv::make_async(*_loop, _on_event, this);
+    _check = uv::make_check(*_loop, _on_check, this);
+    _idle = uv::make_idle(*_loop, this);
+
+    _ticker = uv::make_timer(*_loop, _on_tick, opts.timer_tick, opts.timer_tick, this);
+    uv_timer_stop(_ticker.get());
+}
+
+UdpServer::~UdpServer() {
+    // Handles are members, so close them while they're still alive.
+    uv::close_handles(*_loop);
 }
 
 void UdpServer::register_command(CommandUPtr command) {
@@ -96,31 +205,194 @@ void UdpServer::register_command(CommandUPtr command) {
     }
 
     auto name = command->name();
+    auto type = command_type(name);
+    if (type != CommandType::UNKNOWN) {
+        auto &builtin = _builtin_commands[static_cast<std::size_t>(type)];
+        if (builtin) {
+            throw Error(name + " has already been registered");
+        }
+
+        builtin = std::move(command);
+        return;
+    }
+
     if (!_commands.emplace(name, std::move(command)).second) {
         throw Error(name + " has already been registered");
     }
 }
 
+void UdpServer::register_binary_handler(std::function<void (const std::string_view &)> handler) {
+    if (!handler) {
+        throw Error("null binary handler");
+    }
+
+    _binary_handler = std::move(handler);
+}
+
 void UdpServer::start() {
+    _loop_thread_id.store(std::this_thread::get_id(), std::memory_order_release);
+
     uv_udp_recv_start(_server.get(), _on_alloc, _on_read);
 
     uv_run(_loop.get(), UV_RUN_DEFAULT);
 }
 
-void UdpServer::send(const std::string &ip, int port, std::string data) {
-    Event event = {ip, port, std::move(data)};
+void UdpServer::stop() {
+    _stopping.store(true, std::memory_order_release);
+
+    // Signal it even if a wakeup is pending, since the pending one might have
+    // already checked the flag.
+    uv_async_send(_async.get());
+}
 
-    {
-        std::lock_guard<std::mutex> lock(_mtx);
-        _events.push_back(std::move(event));
+TimerHandle UdpServer::register_timer(const std::chrono::milliseconds &timeout,
+        std::function<void ()> callback) {
+    if (_timers.size() == 0) {
+        // The wheel has been idle, catch up with the loop time before scheduling.
+        uv_update_time(_loop.get());
+        _timers.advance(uv_now(_loop.get()));
     }
 
-    uv_async_send(_async.get());
+    auto timer = _timers.schedule(timeout, std::move(callback));
+
+    if (uv_is_active(uv::to_handle(_ticker.get())) == 0) {
+        auto tick = _timers.tick().count();
+        auto err = uv_timer_start(_ticker.get(), _on_tick, tick, tick);
+        if (err != 0) {
+            _timers.cancel(timer);
+            throw UvError(err, "failed to start timer");
+        }
+    }
+
+    return timer;
 }
 
-void UdpServer::_handle(const std::string_view &buf) {
+void UdpServer::send(const PeerHandle &peer, std::string data) {
+    Event event = {peer, std::move(data)};
+
+    while (!_events.try_push(event)) {
+        switch (_overflow_policy) {
+        case OverflowPolicy::BLOCK:
+            if (in_loop_thread()) {
+                // Nobody else will drain the queue, do it ourselves.
+                _drain_events();
+            } else {
+                std::this_thread::yield();
+            }
+            break;
+
+        case OverflowPolicy::DROP_NEWEST:
+            _stats.send_drops.fetch_add(1, std::memory_order_relaxed);
+            return;
+
+        case OverflowPolicy::DROP_OLDEST: {
+            Event oldest;
+            if (_events.try_pop(oldest)) {
+                _stats.send_drops.fetch_add(1, std::memory_order_relaxed);
+            }
+            break;
+        }
+
+        default:
+            assert(false);
+        }
+    }
+
+    _wakeup();
+}
+
+void UdpServer::post(std::function<void ()> task) {
+    while (!_tasks.try_push(task)) {
+        if (in_loop_thread()) {
+            // Nobody else will run the queued tasks, and tasks should keep their order.
+            _run_tasks();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    _wakeup();
+}
+
+void UdpServer::defer(std::function<void ()> task) {
+    assert(in_loop_thread());
+
+    if (_deferred.empty()) {
+        uv_idle_start(_idle.get(), _on_idle);
+    }
+
+    _deferred.push_back(std::move(task));
+}
+
+SendBuffer UdpServer::acquire_send_buffer() {
+    auto *data = _send_buffers.acquire();
+    if (data == nullptr) {
+        _send_buffers.expand();
+        _stats.send_slab_allocs.fetch_add(1, std::memory_order_relaxed);
+
+        data = _send_buffers.acquire();
+        assert(data != nullptr);
+    }
+
+    SendBuffer buf;
+    buf.data = data;
+    buf.capacity = _send_buffers.buffer_size();
+
+    return buf;
+}
+
+void UdpServer::release_send_buffer(SendBuffer &buf) {
+    _send_buffers.release(buf.data);
+    buf = SendBuffer{};
+}
+
+void UdpServer::send(const PeerHandle &peer, SendBuffer buf) {
+    assert(buf.data != nullptr && buf.size <= buf.capacity);
+
+    Datagram datagram;
+    datagram.peer = peer;
+    datagram.buf = buf;
+    _sending.push_back(std::move(datagram));
+
+    if (_sending.size() >= SENDMMSG_MAX_WIDTH) {
+        _flush();
+    }
+}
+
+UdpServerStats UdpServer::stats() const {
+    return _stats.snapshot();
+}
+
+int UdpServer::_fileno() const {
+    int fd = -1;
+    auto err = uv_fileno(uv::to_handle(_server.get()), &fd);
+    if (err != 0) {
+        SW_GOSSIP_LOG_ERROR("failed to get udp socket: %s", uv_strerror(err));
+        return -1;
+    }
+
+    return fd;
+}
+
+void UdpServer::_handle(const std::string_view &data) {
     try {
-        auto [requests, bytes_parsed] = RespRequestParser{}.parse(buf);
+        auto buf = data;
+        if (lz::is_compressed(buf)) {
+            lz::decompress(buf, _decompressed, MAX_DECOMPRESSED_SIZE);
+            buf = _decompressed;
+        }
+
+        if (binary::is_binary(buf)) {
+            if (!_binary_handler) {
+                SW_GOSSIP_LOG_ERROR_RL("no binary handler");
+                return;
+            }
+
+            _binary_handler(buf);
+            return;
+        }
+
+        auto [requests, bytes_parsed] = _parser.parse(buf);
         if (requests.empty()) {
             // TODO: should we reply with error?
             return;
@@ -128,34 +400,250 @@ void UdpServer::_handle(const std::string_view &buf) {
 
         // In fact, there's only a single requests so far
         for (const auto &request : requests) {
-            auto iter = _commands.find(std::string(request.name));
-            if (iter == _commands.end()) {
-                std::cerr << "no match command: " << request.name << std::endl;
+            auto *command = _command(request.name);
+            if (command == nullptr) {
+                SW_GOSSIP_LOG_ERROR_RL("no match command: %.*s",
+                        static_cast<int>(request.name.size()), request.name.data());
                 // TODO: reply with error
                 continue;
             }
-            auto &command = iter->second;
-            assert(command);
             command->run(request.args);
         }
     } catch (const Error &err) {
-        std::cerr << "failed to handle request: " << err.what() << std::endl;
+        SW_GOSSIP_LOG_ERROR_RL("failed to handle request: %s", err.what());
     }
 }
 
-void UdpServer::_send(Event event) {
-    SockAddr addr(event.ip, event.port);
-    auto req = std::make_unique<uv_udp_send_t>();
-    auto ctx = std::make_unique<SendContext>(std::move(event.data));
-    auto err = uv_udp_send(req.get(), _server.get(),
-            &(ctx->buf), 1, addr.addr(), _on_send);
+Command* UdpServer::_command(const std::string_view &name) {
+    auto type = command_type(name);
+    if (type != CommandType::UNKNOWN) {
+        return _builtin_commands[static_cast<std::size_t>(type)].get();
+    }
+
+    auto iter = _commands.find(name);
+    if (iter == _commands.end()) {
+        return nullptr;
+    }
+
+    return iter->second.get();
+}
+
+void UdpServer::_send(Datagram &datagram) {
+    const auto *peer = _peers.get(datagram.peer);
+    if (peer == nullptr) {
+        SW_GOSSIP_LOG_ERROR_RL("failed to do send: unknown peer");
+        _stats.send_errors.fetch_add(1, std::memory_order_relaxed);
+        _release(datagram);
+        return;
+    }
+
+    auto *ctx = _send_contexts.acquire();
+    auto slab_num = _send_contexts.slab_num();
+    ctx->datagram = std::move(datagram);
+    datagram = Datagram{};
+
+    auto payload = ctx->datagram.payload();
+    // libuv copies the uv_buf_t array, so it's fine to pass a temporary one.
+    auto buf = uv_buf_init(const_cast<char *>(payload.data()), payload.size());
+    auto err = uv_udp_send(&(ctx->req), _server.get(),
+            &buf, 1, reinterpret_cast<const sockaddr *>(&peer->addr), _on_send);
+    _stats.send_calls.fetch_add(1, std::memory_order_relaxed);
+    if (slab_num != _send_contexts.slab_num()) {
+        _stats.send_slab_allocs.fetch_add(1, std::memory_order_relaxed);
+    }
+
     if (err != 0) {
-        std::cerr << "failed to do send: " << uv::err_msg(err) << std::endl;
+        SW_GOSSIP_LOG_ERROR_RL("failed to do send: %s", uv_strerror(err));
+        _stats.send_errors.fetch_add(1, std::memory_order_relaxed);
         // TODO: should we close handle?
+        _release(ctx->datagram);
+        _send_contexts.release(ctx);
         return;
-    } else {
-        uv::set_data(req.release(), ctx.release());
     }
+
+    uv::set_data(&(ctx->req), ctx);
+}
+
+void UdpServer::_wakeup() {
+    // Only the first push after the event loop drained the queues needs a wakeup.
+    if (!_wakeup_pending.exchange(true, std::memory_order_acq_rel)) {
+        uv_async_send(_async.get());
+    }
+}
+
+void UdpServer::_run_tasks() {
+    // Clear the flag before draining, so that any task pushed after that
+    // is either run by this call, or triggers another wakeup.
+    _wakeup_pending.exchange(false, std::memory_order_acq_rel);
+
+    auto max_num = _tasks.capacity();
+    std::size_t num = 0;
+    std::function<void ()> task;
+    while (num < max_num && _tasks.try_pop(task)) {
+        ++num;
+        try {
+            task();
+        } catch (const Error &err) {
+            SW_GOSSIP_LOG_ERROR_RL("failed to run task: %s", err.what());
+        }
+    }
+
+    if (num == max_num) {
+        // There might be more tasks, schedule another round.
+        _wakeup();
+    }
+}
+
+void UdpServer::_drain_events() {
+    // Clear the flag before draining, so that any event pushed after that
+    // is either drained by this call, or triggers another wakeup.
+    _wakeup_pending.exchange(false, std::memory_order_acq_rel);
+
+    // Limit the batch size, so that producers cannot starve the event loop.
+    auto max_num = _events.capacity();
+    std::size_t num = 0;
+    Event event;
+    while (num < max_num && _events.try_pop(event)) {
+        Datagram datagram;
+        datagram.peer = event.peer;
+        datagram.data = std::move(event.data);
+        _sending.push_back(std::move(datagram));
+        ++num;
+    }
+
+    if (num == max_num) {
+        // There might be more events, schedule another round.
+        _wakeup();
+    }
+
+    _flush();
+}
+
+void UdpServer::_flush() {
+    if (_sending.empty()) {
+        return;
+    }
+
+    _send_batch(_sending);
+
+    for (auto &datagram : _sending) {
+        _release(datagram);
+    }
+
+    _sending.clear();
+}
+
+void UdpServer::_release(Datagram &datagram) {
+    if (datagram.buf.data != nullptr) {
+        _send_buffers.release(datagram.buf.data);
+        datagram.buf = SendBuffer{};
+    }
+
+    datagram.data.clear();
+}
+
+void UdpServer::_send_batch(std::vector<Datagram> &datagrams) {
+    _stats.send_batches.fetch_add(1, std::memory_order_relaxed);
+    _stats.send_msgs.fetch_add(datagrams.size(), std::memory_order_relaxed);
+
+    auto num = _prepare_batch(datagrams);
+    if (num == 0) {
+        return;
+    }
+
+    auto fd = _fileno();
+    if (fd < 0) {
+        _stats.send_errors.fetch_add(num, std::memory_order_relaxed);
+        return;
+    }
+
+    std::size_t sent = 0;
+    while (sent < num) {
+        auto width = std::min(num - sent, SENDMMSG_MAX_WIDTH);
+        auto res = ::sendmmsg(fd, _msgs.data() + sent, width, 0);
+        _stats.send_calls.fetch_add(1, std::memory_order_relaxed);
+        if (res >= 0) {
+            sent += res;
+            continue;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Socket send buffer is full. Queue the remaining datagrams to libuv,
+            // which sends them once the socket becomes writable.
+            for (auto idx = sent; idx != num; ++idx) {
+                _send(datagrams[idx]);
+            }
+            break;
+        }
+
+        // sendmmsg reports the error of the first unsent message, skip it and go on.
+        SW_GOSSIP_LOG_ERROR_RL("failed to do send: %s", std::strerror(errno));
+        _stats.send_errors.fetch_add(1, std::memory_order_relaxed);
+        ++sent;
+    }
+}
+
+std::size_t UdpServer::_prepare_batch(std::vector<Datagram> &datagrams) {
+    // Move datagrams with stale peer handle to the end, so that
+    // the i-th msghdr always corresponds to the i-th datagram.
+    std::size_t num = 0;
+    for (auto &datagram : datagrams) {
+        if (_peers.get(datagram.peer) == nullptr) {
+            SW_GOSSIP_LOG_ERROR_RL("failed to do send: unknown peer");
+            _stats.send_errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (datagram.buf.data == nullptr) {
+            _stats.send_heap_msgs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (&datagram != &datagrams[num]) {
+            // Swap instead of move, so that the pooled buffer of the stale one is still released.
+            std::swap(datagram, datagrams[num]);
+        }
+        ++num;
+    }
+
+    _msgs.resize(num);
+    _iovs.resize(num);
+    for (auto idx = 0U; idx != num; ++idx) {
+        auto &datagram = datagrams[idx];
+        auto payload = datagram.payload();
+        auto &iov = _iovs[idx];
+        iov.iov_base = const_cast<char *>(payload.data());
+        iov.iov_len = payload.size();
+
+        // The peer table is not modified during the batch, so the address stays valid.
+        const auto *peer = _peers.get(datagram.peer);
+        assert(peer != nullptr);
+
+        auto &msg = _msgs[idx];
+        msg = mmsghdr{};
+        msg.msg_hdr.msg_name = const_cast<sockaddr_storage *>(&peer->addr);
+        msg.msg_hdr.msg_namelen = peer->addr_len;
+        msg.msg_hdr.msg_iov = &iov;
+        msg.msg_hdr.msg_iovlen = 1;
+    }
+
+    return num;
+}
+
+UdpServerStats UdpServer::Stats::snapshot() const {
+    UdpServerStats stats;
+    stats.send_batches = send_batches.load(std::memory_order_relaxed);
+    stats.send_msgs = send_msgs.load(std::memory_order_relaxed);
+    stats.send_calls = send_calls.load(std::memory_order_relaxed);
+    stats.send_errors = send_errors.load(std::memory_order_relaxed);
+    stats.send_drops = send_drops.load(std::memory_order_relaxed);
+    stats.send_slab_allocs = send_slab_allocs.load(std::memory_order_relaxed);
+    stats.send_heap_msgs = send_heap_msgs.load(std::memory_order_relaxed);
+
+    return stats;
 }
 
 }
@@ -17,12 +17,22 @@
 #ifndef SW_GOSSIP_NET_UDP_SERVER_H
 #define SW_GOSSIP_NET_UDP_SERVER_H
 
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <mutex>
+#include <functional>
+#include <map>
 #include <string>
 #include <string_view>
-#include <unordered_map>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
 #include "uv_utils.h"
+#include "buffer_pool.h"
+#include "mpsc_queue.h"
+#include "object_pool.h"
+#include "peer_table.h"
+#include "timing_wheel.h"
 #include "resp.h"
 #include "command.h"
 
@@ -31,64 +41,280 @@ namespace sw::gossip {
 struct UdpServerOptions {
     std::string ip;
     int port;
+
+    // Size of each receive buffer, i.e. max datagram size, when recvmmsg is disabled.
     std::size_t buffer_size;
+
+    // Max number of datagrams received with a single recvmmsg call.
+    // 0 or 1 disables recvmmsg, i.e. receive one datagram per syscall.
+    // libuv receives at most 20 datagrams per call, so larger values are clamped.
+    std::size_t recv_batch_size = 0;
+
+    // Number of pre-allocated receive buffers (slabs). When recvmmsg is enabled,
+    // each slab holds `recv_batch_size` datagrams.
+    std::size_t recv_buffer_num = 1;
+
+    // Capacity of the outbound queue, rounded up to power of 2.
+    std::size_t send_queue_size = 4096;
+
+    // What to do when `UdpServer::send` finds the outbound queue full.
+    OverflowPolicy send_overflow_policy = OverflowPolicy::BLOCK;
+
+    // Size of each pooled send buffer. By default, it's the max UDP payload
+    // that fits in a 1500 bytes Ethernet MTU without IP fragmentation.
+    std::size_t send_buffer_size = 1472;
+
+    // Number of send buffers per slab. The pool allocates another slab when
+    // all buffers are in use.
+    std::size_t send_buffer_num = 256;
+
+    // Number of send contexts per slab, which are used when the socket is not writable.
+    std::size_t send_context_num = 64;
+
+    // Capacity of the queue of tasks posted from other threads, rounded up to power of 2.
+    std::size_t task_queue_size = 4096;
+
+    // Bind with SO_REUSEPORT, so that multiple servers, each with its own
+    // event loop, can share the same port.
+    bool reuseport = false;
+
+    // Resolution of timers registered with `UdpServer::register_timer`.
+    std::chrono::milliseconds timer_tick{10};
+};
+
+// A fixed-size buffer from UdpServer's send buffer pool.
+struct SendBuffer {
+    char *data = nullptr;
+
+    // Number of bytes written.
+    std::size_t size = 0;
+
+    std::size_t capacity = 0;
+};
+
+struct UdpServerStats {
+    // Number of event batches drained from the send queue.
+    std::size_t send_batches = 0;
+
+    // Number of datagrams in all drained batches.
+    std::size_t send_msgs = 0;
+
+    // Number of send syscalls, i.e. sendmmsg or uv_udp_send.
+    std::size_t send_calls = 0;
+
+    // Number of datagrams that failed to be sent.
+    std::size_t send_errors = 0;
+
+    // Number of datagrams dropped because the outbound queue is full.
+    std::size_t send_drops = 0;
+
+    // Number of slabs allocated by send buffer pool and send context pool,
+    // excluding the initial ones. It stays unchanged in steady state.
+    std::size_t send_slab_allocs = 0;
+
+    // Number of datagrams sent from heap allocated strings instead of pooled buffers.
+    std::size_t send_heap_msgs = 0;
+
+    double avg_batch_size() const {
+        if (send_batches == 0) {
+            return 0;
+        }
+
+        return static_cast<double>(send_msgs) / send_batches;
+    }
 };
 
 class UdpServer {
 public:
     explicit UdpServer(const UdpServerOptions &opts);
 
-    /*
-    template <typename T>
-    void register_timer(const std::chrono::milliseconds &timeout,
-            const std::chrono::milliseconds &repeat,
-            uv_timer_cb callback,
-            T *data,
-            bool own_data) {
-        try {
-            auto timer = std::make_unique<>();
-        } catch () {
-        }
+    ~UdpServer();
+
+    // Event loop thread only. Run `callback` once after `timeout`, which is rounded up
+    // to timer ticks. All timers are driven by a single uv timer, which only runs
+    // when there're outstanding timers.
+    TimerHandle register_timer(const std::chrono::milliseconds &timeout,
+            std::function<void ()> callback);
+
+    // Event loop thread only.
+    // @return false, if the timer has already fired or been canceled.
+    bool cancel_timer(const TimerHandle &timer) {
+        return _timers.cancel(timer);
     }
-    */
 
+    // Built-in commands, i.e. those with a CommandType, are dispatched with a table,
+    // and others are looked up by name.
     void register_command(CommandUPtr command);
 
+    // Handle messages in binary format, i.e. starting with binary::MAGIC.
+    // It runs in the event loop thread of this server.
+    void register_binary_handler(std::function<void (const std::string_view &)> handler);
+
+    // Run the event loop in the calling thread, until `stop` is called.
     void start();
 
-    void stop() {} // TODO: stop the server
+    // Thread-safe. Stop the event loop, so that `start` returns. Once stopped, the
+    // server cannot be restarted, and pending datagrams and tasks are discarded.
+    void stop();
+
+    // Thread-safe. Only wakes up the event loop if no wakeup is pending.
+    // The handle is resolved in the event loop thread, and the datagram is
+    // dropped if the peer has been removed before that.
+    void send(const PeerHandle &peer, std::string data);
+
+    // Event loop thread only. Acquire an empty buffer from the send buffer pool.
+    SendBuffer acquire_send_buffer();
+
+    // Event loop thread only. Return a buffer that won't be sent.
+    void release_send_buffer(SendBuffer &buf);
+
+    // Event loop thread only. Send without copy, and the buffer goes back to the pool
+    // once it's sent. Datagrams are coalesced, and sent at the end of the loop iteration.
+    void send(const PeerHandle &peer, SendBuffer buf);
+
+    // Cache the resolved address of a peer. Event loop thread only.
+    PeerHandle add_peer(const NodeId &id, const IpAddress &ip, uint16_t port) {
+        return _peers.add(id, ip, port);
+    }
+
+    // Event loop thread only.
+    void remove_peer(const NodeId &id) {
+        _peers.remove(id);
+    }
+
+    // Event loop thread only.
+    PeerHandle find_peer(const NodeId &id) const {
+        return _peers.find(id);
+    }
+
+    // Event loop thread only.
+    WireFormat peer_format(const PeerHandle &peer) const {
+        return _peers.format(peer);
+    }
+
+    // Event loop thread only.
+    void set_peer_format(const PeerHandle &peer, WireFormat format) {
+        _peers.set_format(peer, format);
+    }
+
+    // Event loop thread only.
+    Negotiation* peer_negotiation(const PeerHandle &peer) {
+        return _peers.negotiation(peer);
+    }
+
+    // Thread-safe. Run the task in the event loop thread. If the task queue is full,
+    // wait until there's free space, or run the task inline in the event loop thread.
+    void post(std::function<void ()> task);
+
+    // Event loop thread only. Run the task in the next loop iteration, never inline,
+    // so that I/O and timers are handled between tasks that defer each other.
+    void defer(std::function<void ()> task);
+
+    bool in_loop_thread() const {
+        return std::this_thread::get_id() == _loop_thread_id.load(std::memory_order_acquire);
+    }
+
+    // The event loop, on which other handles, e.g. timers and TCP connections,
+    // can be registered before `start`. Handles should only be used in the event loop thread.
+    uv_loop_t& loop() {
+        return *_loop;
+    }
 
-    void send(const std::string &ip, int port, std::string data);
+    // Thread-safe.
+    UdpServerStats stats() const;
 
 private:
+    // Benchmarks drive private members of an unstarted instance.
+    friend class UdpServerAccess;
+
     static void _on_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf);
 
     static void _on_read(uv_udp_t *req, ssize_t nread,
             const uv_buf_t *buf, const sockaddr *addr, unsigned flags);
 
-    struct SendContext {
-        explicit SendContext(std::string req_) : req(std::move(req_)) {
-            buf.base = req.data();
-            buf.len = req.size();
-        }
-
-        std::string req;
-        uv_buf_t buf;
-    };
-
     static void _on_send(uv_udp_send_t *req, int status);
 
     static void _on_event(uv_async_t *handle);
 
-    void _handle(const std::string_view &buf);
+    static void _on_check(uv_check_t *handle);
+
+    static void _on_idle(uv_idle_t *handle);
+
+    static void _on_tick(uv_timer_t *handle);
+
+    // Decompress the message if it's compressed, and dispatch it to commands
+    // or the binary handler.
+    void _handle(const std::string_view &data);
+
+    Command* _command(const std::string_view &name);
+
+    int _fileno() const;
+
+    // Drain at most one queue capacity of events and send them.
+    void _drain_events();
+
+    // Run at most one queue capacity of posted tasks.
+    void _run_tasks();
+
+    void _wakeup();
 
     struct Event {
-        std::string ip;
-        int port;
+        PeerHandle peer;
         std::string data;
     };
 
-    void _send(Event event);
+    // A datagram to be sent in the event loop thread.
+    struct Datagram {
+        PeerHandle peer;
+
+        // Pooled buffer. If it's empty, `data` is sent instead.
+        SendBuffer buf;
+
+        std::string data;
+
+        std::string_view payload() const {
+            if (buf.data != nullptr) {
+                return {buf.data, buf.size};
+            }
+
+            return data;
+        }
+    };
+
+    // Used when the datagram cannot be sent with sendmmsg immediately.
+    struct SendContext {
+        uv_udp_send_t req;
+
+        Datagram datagram;
+    };
+
+    // Send datagram with the queued uv_udp_send.
+    void _send(Datagram &datagram);
+
+    // Send all pending datagrams.
+    void _flush();
+
+    // Send a batch of datagrams with as few syscalls as possible.
+    void _send_batch(std::vector<Datagram> &datagrams);
+
+    // Drop datagrams with stale peer handle, and fill the msghdr for the remaining ones.
+    // @return number of datagrams to be sent.
+    std::size_t _prepare_batch(std::vector<Datagram> &datagrams);
+
+    // Return the pooled buffer, if any, and reset the datagram.
+    void _release(Datagram &datagram);
+
+    struct Stats {
+        UdpServerStats snapshot() const;
+
+        std::atomic<std::size_t> send_batches{0};
+        std::atomic<std::size_t> send_msgs{0};
+        std::atomic<std::size_t> send_calls{0};
+        std::atomic<std::size_t> send_errors{0};
+        std::atomic<std::size_t> send_drops{0};
+        std::atomic<std::size_t> send_slab_allocs{0};
+        std::atomic<std::size_t> send_heap_msgs{0};
+    };
 
     LoopUPtr _loop;
 
@@ -96,13 +322,64 @@ private:
 
     AsyncUPtr _async;
 
-    std::vector<char> _buffer;
+    // Flush datagrams sent during the loop iteration.
+    CheckUPtr _check;
+
+    // Run deferred tasks, and it's stopped when there's no deferred task.
+    IdleUPtr _idle;
+
+    std::vector<std::function<void ()>> _deferred;
+
+    // Tick of `_timers`, and it's stopped when there's no timer.
+    TimerUPtr _ticker;
+
+    TimingWheel _timers;
+
+    BufferPool _recv_buffers;
+
+    std::array<CommandUPtr, BUILTIN_COMMAND_NUM> _builtin_commands;
+
+    // Extension commands. std::less<> enables lookup with std::string_view.
+    std::map<std::string, CommandUPtr, std::less<>> _commands;
+
+    std::function<void (const std::string_view &)> _binary_handler;
+
+    // Reused for all received requests, so that parsing doesn't allocate in steady state.
+    RespRequestParser _parser;
+
+    // Reused to decompress received messages.
+    std::string _decompressed;
+
+    PeerTable _peers;
+
+    MpscQueue<Event> _events;
+
+    MpscQueue<std::function<void ()>> _tasks;
+
+    OverflowPolicy _overflow_policy;
+
+    // Whether `_async` has been signaled, and the event loop has not drained
+    // `_events` and `_tasks` yet.
+    std::atomic<bool> _wakeup_pending{false};
+
+    // Set by `stop`, and checked by the event loop on wakeup.
+    std::atomic<bool> _stopping{false};
+
+    // Written by `start`, and read by any thread calling `post`.
+    std::atomic<std::thread::id> _loop_thread_id{};
+
+    // Datagrams to be sent, only accessed in the event loop thread.
+    std::vector<Datagram> _sending;
+
+    BufferPool _send_buffers;
 
-    std::unordered_map<std::string, CommandUPtr> _commands;
+    ObjectPool<SendContext> _send_contexts;
 
-    std::vector<Event> _events;
+    // Scratch space for sendmmsg, reused across batches.
+    std::vector<mmsghdr> _msgs;
+    std::vector<iovec> _iovs;
 
-    std::mutex _mtx;
+    Stats _stats;
 };
 
 }
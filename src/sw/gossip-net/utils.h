@@ -18,41 +18,193 @@
 #define SW_GOSSIP_NET_UTILS_H
 
 #include <charconv>
+#include <cstdint>
+#include <functional>
 #include <iterator>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 #include <string_view>
 #include "errors.h"
 
 namespace sw::gossip {
 
-enum class NodeStatus {
+// Non-owning view of consecutive items.
+template <typename T>
+class ArrayView {
+public:
+    ArrayView() = default;
+
+    ArrayView(const T *data, std::size_t size) : _data(data), _size(size) {}
+
+    const T* begin() const {
+        return _data;
+    }
+
+    const T* end() const {
+        return _data + _size;
+    }
+
+    const T& operator[](std::size_t idx) const {
+        return _data[idx];
+    }
+
+    const T& front() const {
+        return _data[0];
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+private:
+    const T *_data = nullptr;
+
+    std::size_t _size = 0;
+};
+
+enum class NodeStatus : uint8_t {
     ALIVE = 0,
     SUSPECTED,
     FAILED,
     UNKNOWN
 };
 
+// Node id stored inline, so that Node is trivially copyable. Ids longer than
+// MAX_SIZE are not part of the protocol, and a message carrying one is rejected
+// as invalid.
+class NodeId {
+public:
+    // Long enough for a UUID string.
+    static constexpr std::size_t MAX_SIZE = 36;
+
+    NodeId() = default;
+
+    // Throw Error if the id is longer than MAX_SIZE.
+    explicit NodeId(const std::string_view &id) {
+        assign(id);
+    }
+
+    // Throw Error if the id is longer than MAX_SIZE.
+    void assign(const std::string_view &id);
+
+    std::string_view view() const {
+        return std::string_view(_data, _size);
+    }
+
+    std::string str() const {
+        return std::string(_data, _size);
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+private:
+    uint8_t _size = 0;
+
+    char _data[MAX_SIZE] = {};
+};
+
+inline bool operator==(const NodeId &lhs, const NodeId &rhs) {
+    return lhs.view() == rhs.view();
+}
+
+inline bool operator!=(const NodeId &lhs, const NodeId &rhs) {
+    return !(lhs == rhs);
+}
+
+// IPv4 or IPv6 address in binary, and IPv4 address is stored as IPv4-mapped IPv6
+// address. It's parsed once on receive, and formatted only when it's encoded.
+class IpAddress {
+public:
+    static constexpr std::size_t SIZE = 16;
+
+    // Max length of the text form, i.e. INET6_ADDRSTRLEN without the trailing '\0'.
+    static constexpr std::size_t MAX_STR_SIZE = 45;
+
+    IpAddress() = default;
+
+    // Throw Error if it's not a valid IPv4 or IPv6 address.
+    explicit IpAddress(const std::string_view &ip) {
+        assign(ip);
+    }
+
+    // Throw Error if it's not a valid IPv4 or IPv6 address.
+    void assign(const std::string_view &ip);
+
+    // Assign the address in network byte order, i.e. 4 bytes for IPv4, or 16 bytes
+    // for IPv6. Throw Error if `len` is neither.
+    void assign(const uint8_t *bytes, std::size_t len);
+
+    bool is_v4() const;
+
+    const uint8_t* data() const {
+        return _bytes;
+    }
+
+    // The address in network byte order, i.e. 4 bytes for IPv4, or 16 bytes for IPv6.
+    const uint8_t* bytes() const;
+
+    // Size of `bytes()`.
+    std::size_t size() const;
+
+    // Write the text form into `buf`, which should hold at least MAX_STR_SIZE bytes.
+    // @return length of the text form.
+    std::size_t to_chars(char *buf) const;
+
+    // Length of the text form.
+    std::size_t str_size() const;
+
+    std::string str() const;
+
+private:
+    uint8_t _bytes[SIZE] = {};
+};
+
+bool operator==(const IpAddress &lhs, const IpAddress &rhs);
+
+inline bool operator!=(const IpAddress &lhs, const IpAddress &rhs) {
+    return !(lhs == rhs);
+}
+
+// Fields are ordered to pack the node into a cache line without padding.
 struct Node {
-    std::string id;
-    std::string ip;
-    int port;
-    uint64_t version = 0;
+    NodeId id;
+    IpAddress ip;
     NodeStatus status = NodeStatus::ALIVE;
+    uint16_t port = 0;
+    uint64_t version = 0;
 };
 
+static_assert(std::is_trivially_copyable_v<Node> && sizeof(Node) == 64,
+        "Node should be a trivially copyable cache line");
+
 bool operator<(const Node &lhs, const Node &rhs);
 
+// Whether info of the same node with `lhs_status` and `lhs_version` should be
+// overridden by the one with `rhs_status` and `rhs_version`.
+bool outdated(NodeStatus lhs_status, uint64_t lhs_version,
+        NodeStatus rhs_status, uint64_t rhs_version);
+
+// Encoded size of a node in a message, with which rumors are packed into a byte budget.
+using NodeSize = std::function<std::size_t (const Node &)>;
+
 namespace utils {
 
 constexpr auto *ALIVE = "ALIVE";
 constexpr auto *SUSPECTED = "SUSPECTED";
 constexpr auto *FAILED = "FAILED";
 
-inline void to_str(const std::string_view &sv, std::string &s) {
-    s.assign(sv.data(), sv.size());
-}
-
 template <typename Num>
 inline void to_num(const std::string_view &sv, Num &num) {
     auto [ptr, err] = std::from_chars(sv.data(), sv.data() + sv.size(), num);
@@ -63,6 +215,8 @@ inline void to_num(const std::string_view &sv, Num &num) {
 
 NodeStatus parse_status(const std::string_view &sv);
 
+const char* status_str(NodeStatus status);
+
 template <typename T>
 auto parse_node(const std::string_view &type, T first, T last) {
     auto dist = std::distance(first, last);
@@ -75,16 +229,16 @@ auto parse_node(const std::string_view &type, T first, T last) {
     }
 
     Node node;
-    to_str(*first++, node.id);
-    to_str(*first++, node.ip);
+    node.id.assign(*first++);
+    node.ip.assign(*first++);
     to_num(*first++, node.port);
     to_num(*first++, node.version);
 
     if (dist > 5) {
-        auto status = parse_status(*(first + 1));
+        // Status is optional, and the next item might be the type of the next node.
+        auto status = parse_status(*first);
         if (status != NodeStatus::UNKNOWN) {
             node.status = status;
-        } else {
             ++first;
         }
     }
@@ -108,4 +262,15 @@ auto parse_rumors(T first, T last) {
 
 }
 
+namespace std {
+
+template <>
+struct hash<sw::gossip::NodeId> {
+    std::size_t operator()(const sw::gossip::NodeId &id) const noexcept {
+        return std::hash<std::string_view>()(id.view());
+    }
+};
+
+}
+
 #endif // end SW_GOSSIP_NET_UTILS_H
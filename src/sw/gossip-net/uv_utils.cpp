@@ -34,34 +34,43 @@ void LoopDeleter::operator()(uv_loop_t *loop) const {
         return;
     }
 
-    uv_walk(loop,
+    uv::close_handles(*loop);
+
+    uv_loop_close(loop);
+
+    delete loop;
+}
+
+namespace uv {
+
+void close_handles(uv_loop_t &loop) {
+    uv_walk(&loop,
             [](uv_handle_t *handle, void *) {
-                if (handle != nullptr) {
+                // Handles being closed by their owners are skipped, since closing twice aborts.
+                if (handle != nullptr && uv_is_closing(handle) == 0) {
                     // We don't need to release handle's memory in close callback,
-                    // since we'll release the memory in EventLoop's destructor.
+                    // since owners release it after this call.
                     uv_close(handle, nullptr);
                 }
             },
             nullptr);
 
-    // Ensure uv_walk's callback to be called.
-    uv_run(loop, UV_RUN_DEFAULT);
-
-    uv_loop_close(loop);
-
-    delete loop;
+    // Ensure close callbacks to be called.
+    uv_run(&loop, UV_RUN_DEFAULT);
 }
 
-namespace uv {
-
 namespace detail {
 
 TcpUPtr make_tcp_server(uv_loop_t &loop, bool is_ipv6);
 
 bool is_ipv6(const std::string &ip);
 
+void enable_reuseport(uv_handle_t &handle);
+
 void enable_reuseport(uv_tcp_t &server);
 
+void enable_reuseport(uv_udp_t &server);
+
 void enable_nodelay(uv_tcp_t &server);
 
 void bind_server(uv_tcp_t &server, const SockAddr &addr);
@@ -92,6 +101,35 @@ AsyncUPtr make_async(uv_loop_t &loop, uv_async_cb callback, void *data) {
     return uv_async;
 }
 
+CheckUPtr make_check(uv_loop_t &loop, uv_check_cb callback, void *data) {
+    auto check = std::make_unique<uv_check_t>();
+    auto err = uv_check_init(&loop, check.get());
+    if (err != 0) {
+        throw UvError(err, "failed to make uv check");
+    }
+
+    err = uv_check_start(check.get(), callback);
+    if (err != 0) {
+        throw UvError(err, "failed to start uv check");
+    }
+
+    set_data(check.get(), data);
+
+    return check;
+}
+
+IdleUPtr make_idle(uv_loop_t &loop, void *data) {
+    auto idle = std::make_unique<uv_idle_t>();
+    auto err = uv_idle_init(&loop, idle.get());
+    if (err != 0) {
+        throw UvError(err, "failed to make uv idle");
+    }
+
+    set_data(idle.get(), data);
+
+    return idle;
+}
+
 TimerUPtr make_timer(uv_loop_t &loop,
         uv_timer_cb callback,
         const std::chrono::milliseconds &timeout,
@@ -158,12 +196,26 @@ WriteUPtr make_write(uv_loop_t &loop, void *data) {
 UdpUPtr make_udp_server(uv_loop_t &loop,
         const UdpOptions &options,
         void *data) {
+    unsigned int flags = AF_UNSPEC;
+    if (options.reuseport) {
+        // Create the socket with init, since SO_REUSEPORT must be set before bind.
+        flags = detail::is_ipv6(options.ip) ? AF_INET6 : AF_INET;
+    }
+
+    if (options.recvmmsg) {
+        flags |= UV_UDP_RECVMMSG;
+    }
+
     auto server = std::make_unique<uv_udp_t>();
-    auto err = uv_udp_init(&loop, server.get());
+    auto err = uv_udp_init_ex(&loop, server.get(), flags);
     if (err != 0) {
         throw UvError(err, "failed to initialize udp server");
     }
 
+    if (options.reuseport) {
+        detail::enable_reuseport(*server);
+    }
+
     detail::bind_server(*server, SockAddr(options.ip, options.port));
 
     set_data(server.get(), data);
@@ -190,8 +242,16 @@ bool is_ipv6(const std::string &ip) {
 }
 
 void enable_reuseport(uv_tcp_t &server) {
+    enable_reuseport(*to_handle(&server));
+}
+
+void enable_reuseport(uv_udp_t &server) {
+    enable_reuseport(*to_handle(&server));
+}
+
+void enable_reuseport(uv_handle_t &handle) {
     int fd = 0;
-    auto err = uv_fileno(to_handle(&server), &fd);
+    auto err = uv_fileno(&handle, &fd);
     if (err != 0) {
         throw UvError(err, "failed to get underlying socket");
     }
@@ -255,4 +315,12 @@ const sockaddr* SockAddr::addr() const {
     }
 }
 
+socklen_t SockAddr::len() const {
+    if (std::holds_alternative<sockaddr_in>(_addr)) {
+        return sizeof(sockaddr_in);
+    } else {
+        return sizeof(sockaddr_in6);
+    }
+}
+
 }
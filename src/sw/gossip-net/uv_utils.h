@@ -17,6 +17,7 @@
 #ifndef SW_GOSSIP_NET_UV_UTILS_H
 #define SW_GOSSIP_NET_UV_UTILS_H
 
+#include <cassert>
 #include <type_traits>
 #include <memory>
 #include <chrono>
@@ -48,6 +49,10 @@ using WriteUPtr = std::unique_ptr<uv_write_t>;
 
 using TimerUPtr = std::unique_ptr<uv_timer_t>;
 
+using CheckUPtr = std::unique_ptr<uv_check_t>;
+
+using IdleUPtr = std::unique_ptr<uv_idle_t>;
+
 struct TcpOptions {
     std::string ip;
     int port;
@@ -59,6 +64,13 @@ struct TcpOptions {
 struct UdpOptions {
     std::string ip;
     int port;
+
+    // Receive multiple datagrams with a single recvmmsg call.
+    bool recvmmsg = false;
+
+    // Set SO_REUSEPORT, so that multiple sockets can bind to the same port,
+    // and the kernel distributes incoming datagrams among them.
+    bool reuseport = false;
 };
 
 class SockAddr {
@@ -67,6 +79,8 @@ public:
 
     const sockaddr* addr() const;
 
+    socklen_t len() const;
+
 private:
     std::variant<sockaddr_in, sockaddr_in6> _addr;
 };
@@ -79,7 +93,10 @@ inline uv_handle_t* to_handle(Handle *handle) noexcept {
             std::is_same_v<Handle, uv_stream_t> ||
             std::is_same_v<Handle, uv_tcp_t> ||
             std::is_same_v<Handle, uv_udp_t> ||
-            std::is_same_v<Handle, uv_async_t>);
+            std::is_same_v<Handle, uv_async_t> ||
+            std::is_same_v<Handle, uv_timer_t> ||
+            std::is_same_v<Handle, uv_check_t> ||
+            std::is_same_v<Handle, uv_idle_t>);
     return reinterpret_cast<uv_handle_t *>(handle);
 }
 
@@ -117,8 +134,19 @@ inline std::string err_msg(int err) {
 
 LoopUPtr make_loop();
 
+// Close all handles of a stopped loop, and run it until pending close callbacks are called.
+// Handles are released by their owners, so it should be called before they're destroyed.
+void close_handles(uv_loop_t &loop);
+
 AsyncUPtr make_async(uv_loop_t &loop, uv_async_cb callback, void *data = nullptr);
 
+// Make a check handle, which runs the callback once per loop iteration, right after polling for I/O.
+CheckUPtr make_check(uv_loop_t &loop, uv_check_cb callback, void *data = nullptr);
+
+// Make an idle handle. It's not started. Once started, it runs the callback once per
+// loop iteration, before polling for I/O, and the loop polls without blocking.
+IdleUPtr make_idle(uv_loop_t &loop, void *data = nullptr);
+
 TimerUPtr make_timer(uv_loop_t &loop,
         uv_timer_cb callback,
         const std::chrono::milliseconds &timeout,
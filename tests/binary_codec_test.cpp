@@ -0,0 +1,214 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/errors.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+TEST(BinaryCodecTest, Varint) {
+    for (uint64_t num : {0ULL, 1ULL, 127ULL, 128ULL, 16383ULL, 16384ULL, ~0ULL}) {
+        BinaryEncoder encoder;
+        encoder.append_varint(num);
+        EXPECT_EQ(encoder.size(), binary::varint_size(num));
+    }
+
+    EXPECT_EQ(binary::varint_size(~0ULL), binary::MAX_VARINT_SIZE);
+}
+
+TEST(BinaryCodecTest, RoundTrip) {
+    auto self = test::make_node(0, 3);
+    auto peer = test::make_node(1, 5, NodeStatus::SUSPECTED);
+    std::vector<Node> rumors = {
+        test::make_node(2, 0),
+        test::make_node(3, 1ULL << 40, NodeStatus::FAILED),
+        test::make_node(4, 7, NodeStatus::SUSPECTED),
+    };
+
+    for (auto type : {MessageType::PING, MessageType::ACK, MessageType::PING_REQ}) {
+        BinaryEncoder encoder;
+        encoder.append_header(type).append_node(self);
+        if (type == MessageType::PING_REQ) {
+            encoder.append_node(peer);
+        }
+
+        encoder.append_varint(rumors.size());
+        std::size_t size = 3 + binary::node_size(self) + 1;
+        for (const auto &rumor : rumors) {
+            encoder.append_node(rumor);
+            size += binary::node_size(rumor);
+        }
+
+        if (type == MessageType::PING_REQ) {
+            size += binary::node_size(peer);
+        }
+        EXPECT_EQ(encoder.size(), size);
+
+        auto data = encoder.data();
+        ASSERT_TRUE(binary::is_binary(data));
+
+        auto msg = binary::decode(data);
+        EXPECT_EQ(msg.type, type);
+        EXPECT_FALSE(msg.dict);
+        test::expect_node_eq(msg.self, self);
+        if (type == MessageType::PING_REQ) {
+            test::expect_node_eq(msg.peer, peer);
+        }
+
+        ASSERT_EQ(msg.rumors.size(), rumors.size());
+        for (std::size_t idx = 0; idx != rumors.size(); ++idx) {
+            test::expect_node_eq(msg.rumors[idx], rumors[idx]);
+        }
+    }
+}
+
+TEST(BinaryCodecTest, DictRoundTrip) {
+    auto self = test::make_node(0);
+    auto define = test::make_node(1, 2);
+    auto ref = test::make_node(2, 9, NodeStatus::SUSPECTED);
+    auto full = test::make_node(3, 4);
+
+    DictHeader header;
+    header.epoch = 12345;
+    header.seq = 1ULL << 40;
+    header.peer_epoch = 1ULL << 63;
+    header.ack_seq = 300;
+    header.ack_bits = 0x80000001;
+
+    std::vector<std::pair<Node, RumorCode>> rumors = {
+        {define, {RumorKind::DEFINE, 7}},
+        {ref, {RumorKind::REF, 300}},
+        {full, {RumorKind::FULL, 0}},
+    };
+
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::ACK, header).append_node(self);
+    encoder.append_varint(rumors.size());
+    std::size_t size = 3 + binary::dict_header_size(header) + binary::node_size(self) + 1;
+    for (const auto &[node, code] : rumors) {
+        encoder.append_rumor(node, code);
+        size += binary::rumor_size(node, code);
+    }
+    EXPECT_EQ(encoder.size(), size);
+
+    auto msg = binary::decode(encoder.data());
+    EXPECT_EQ(msg.type, MessageType::ACK);
+    ASSERT_TRUE(msg.dict);
+    EXPECT_EQ(msg.dict_header.epoch, header.epoch);
+    EXPECT_EQ(msg.dict_header.seq, header.seq);
+    EXPECT_EQ(msg.dict_header.peer_epoch, header.peer_epoch);
+    EXPECT_EQ(msg.dict_header.ack_seq, header.ack_seq);
+    EXPECT_EQ(msg.dict_header.ack_bits, header.ack_bits);
+    test::expect_node_eq(msg.self, self);
+
+    ASSERT_EQ(msg.rumors.size(), rumors.size());
+    ASSERT_EQ(msg.codes.size(), rumors.size());
+    for (std::size_t idx = 0; idx != rumors.size(); ++idx) {
+        const auto &[node, code] = rumors[idx];
+        EXPECT_EQ(msg.codes[idx].kind, code.kind);
+        EXPECT_EQ(msg.codes[idx].index, code.index);
+        if (code.kind == RumorKind::REF) {
+            // Id, ip and port are resolved with the dictionary.
+            EXPECT_EQ(msg.rumors[idx].version, node.version);
+            EXPECT_EQ(msg.rumors[idx].status, node.status);
+        } else {
+            test::expect_node_eq(msg.rumors[idx], node);
+        }
+    }
+}
+
+TEST(BinaryCodecTest, RawIp) {
+    auto v4 = test::make_node(0);
+    v4.ip.assign("10.0.0.1");
+    auto v6 = test::make_node(1);
+    v6.ip.assign("2001:db8::1");
+
+    for (const auto &node : {v4, v6}) {
+        BinaryEncoder encoder;
+        encoder.append_node(node);
+        EXPECT_EQ(encoder.size(), binary::node_size(node));
+
+        // Length prefix and raw bytes of the address.
+        auto data = encoder.data();
+        auto ip_offset = 1 + node.id.size();
+        EXPECT_EQ(static_cast<std::size_t>(data[ip_offset]), node.ip.size());
+        EXPECT_EQ(std::memcmp(data.data() + ip_offset + 1, node.ip.bytes(), node.ip.size()), 0);
+    }
+
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::PING).append_node(v4).append_varint(1).append_node(v6);
+    auto msg = binary::decode(encoder.data());
+    test::expect_node_eq(msg.self, v4);
+    ASSERT_EQ(msg.rumors.size(), 1U);
+    test::expect_node_eq(msg.rumors[0], v6);
+
+    // An address is either 4 or 16 bytes.
+    BinaryEncoder bad_ip;
+    bad_ip.append_header(MessageType::PING).append_string(v4.id.view());
+    bad_ip.append_string("10.0.0.1").append_varint(v4.port).append_varint(0).append_varint(0);
+    EXPECT_THROW(binary::decode(bad_ip.data()), Error);
+}
+
+TEST(BinaryCodecTest, SpillOutOfPlace) {
+    std::string buf(8, '\0');
+    BinaryEncoder encoder(buf.data(), buf.size());
+    encoder.append_header(MessageType::PING).append_node(test::make_node(0)).append_varint(0);
+    EXPECT_GT(encoder.size(), buf.size());
+
+    auto msg = binary::decode(encoder.data());
+    test::expect_node_eq(msg.self, test::make_node(0));
+    EXPECT_TRUE(msg.rumors.empty());
+}
+
+TEST(BinaryCodecTest, Truncated) {
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::PING).append_node(test::make_node(0));
+    encoder.append_varint(1).append_node(test::make_node(1));
+    auto data = encoder.data();
+
+    binary::decode(data);
+    for (std::size_t len = 0; len != data.size(); ++len) {
+        EXPECT_THROW(binary::decode(std::string_view(data.data(), len)), Error) << "length " << len;
+    }
+}
+
+TEST(BinaryCodecTest, Invalid) {
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::PING).append_node(test::make_node(0)).append_varint(0);
+    auto data = encoder.data();
+
+    auto bad_version = data;
+    bad_version[1] = static_cast<char>(binary::DICT_VERSION + 1);
+    EXPECT_THROW(binary::decode(bad_version), Error);
+
+    auto bad_type = data;
+    bad_type[2] = 0;
+    EXPECT_THROW(binary::decode(bad_type), Error);
+
+    // More rumors than the message holds.
+    auto bad_num = data;
+    bad_num.back() = 100;
+    EXPECT_THROW(binary::decode(bad_num), Error);
+}
+
+}
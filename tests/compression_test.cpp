@@ -0,0 +1,152 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <random>
+#include <string>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/compression.h>
+#include <sw/gossip-net/errors.h>
+#include <sw/gossip-net/resp.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+// Full state encoded as push-pull does.
+std::string make_state(std::size_t num) {
+    RespReplyBuilder builder;
+    builder.append_array(1 + num * 6);
+    builder.append_bulk_string("push-pull");
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        builder.append_node("rumor", test::make_node(idx, idx % 7));
+    }
+
+    return builder.data();
+}
+
+// @return compressed data, or empty string if it's not compressed.
+std::string compress(const std::string &src) {
+    std::string dst(lz::max_compressed_size(src.size()), '\0');
+    auto len = lz::compress(src, dst.data(), dst.size());
+    dst.resize(len);
+
+    return dst;
+}
+
+void expect_round_trip(const std::string &src) {
+    auto compressed = compress(src);
+    ASSERT_FALSE(compressed.empty()) << "size " << src.size();
+    EXPECT_LT(compressed.size(), src.size());
+    EXPECT_TRUE(lz::is_compressed(compressed));
+
+    std::string out = "garbage";
+    lz::decompress(compressed, out, src.size());
+    EXPECT_EQ(out, src);
+}
+
+TEST(CompressionTest, FullState) {
+    for (auto num : {10, 100, 1000}) {
+        auto state = make_state(num);
+        expect_round_trip(state);
+    }
+
+    auto state = make_state(1000);
+    EXPECT_LT(compress(state).size(), state.size() / 2);
+}
+
+TEST(CompressionTest, LongRunsAndLiterals) {
+    std::mt19937 rng(1);
+    for (std::size_t len : {16, 19, 20, 100, 270, 271, 1000, 70000}) {
+        // Literals longer than 15 bytes, matches longer than 19 bytes, and
+        // offsets close to the 64KB limit.
+        std::string literals;
+        for (std::size_t idx = 0; idx != len; ++idx) {
+            literals.push_back(static_cast<char>(rng()));
+        }
+
+        expect_round_trip(literals + literals + std::string(len, 'x') + literals);
+    }
+}
+
+TEST(CompressionTest, Incompressible) {
+    std::mt19937 rng(2);
+    std::string data;
+    for (int idx = 0; idx != 4096; ++idx) {
+        data.push_back(static_cast<char>(rng()));
+    }
+
+    EXPECT_TRUE(compress(data).empty());
+    EXPECT_TRUE(compress("").empty());
+}
+
+TEST(CompressionTest, SmallCapacity) {
+    auto state = make_state(100);
+    auto compressed = compress(state);
+    ASSERT_FALSE(compressed.empty());
+
+    std::string dst(compressed.size() - 1, '\0');
+    EXPECT_EQ(lz::compress(state, dst.data(), dst.size()), 0U);
+}
+
+TEST(CompressionTest, MaxSize) {
+    auto state = make_state(100);
+    auto compressed = compress(state);
+
+    std::string out;
+    EXPECT_THROW(lz::decompress(compressed, out, state.size() - 1), Error);
+}
+
+TEST(CompressionTest, DeclaredSizeBeyondExpansion) {
+    // A run of a single byte expands the most.
+    std::string run(1024 * 1024, 'a');
+    auto compressed = compress(run);
+    ASSERT_FALSE(compressed.empty());
+    std::string out;
+    lz::decompress(compressed, out, run.size());
+    EXPECT_EQ(out, run);
+
+    // Magic, a 64MB size, and a single literal.
+    std::string bomb = {static_cast<char>(lz::MAGIC), '\x80', '\x80', '\x80', '\x20',
+        '\x10', 'a'};
+    std::string bomb_out;
+    EXPECT_THROW(lz::decompress(bomb, bomb_out, std::size_t(1) << 30), Error);
+    EXPECT_LT(bomb_out.capacity(), 1024U);
+}
+
+TEST(CompressionTest, Corrupted) {
+    auto state = make_state(50);
+    auto compressed = compress(state);
+
+    std::string out;
+    for (std::size_t len = 0; len != compressed.size(); ++len) {
+        EXPECT_THROW(lz::decompress(std::string_view(compressed.data(), len), out, state.size()),
+                Error) << "length " << len;
+    }
+
+    // Mutated data is either rejected, or decompressed into data of the declared size.
+    std::mt19937 rng(3);
+    for (int round = 0; round != 10000; ++round) {
+        auto data = compressed;
+        data[1 + rng() % (data.size() - 1)] = static_cast<char>(rng());
+        try {
+            lz::decompress(data, out, state.size() * 2);
+        } catch (const Error &) {
+        }
+    }
+}
+
+}
@@ -0,0 +1,256 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/gossip_net.h>
+#include <sw/gossip-net/resp.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr int BASE_PORT = 47200;
+
+std::string node_id(std::size_t idx) {
+    return "node-" + std::to_string(idx);
+}
+
+int node_port(std::size_t idx) {
+    return BASE_PORT + static_cast<int>(idx);
+}
+
+GossipNetOptions options(std::size_t idx) {
+    GossipNetOptions opts;
+    opts.id = node_id(idx);
+    opts.server_options.ip = "127.0.0.1";
+    opts.server_options.port = node_port(idx);
+    opts.server_options.buffer_size = 64 * 1024;
+    opts.server_options.timer_tick = std::chrono::milliseconds(5);
+    opts.lambda = 3;
+    opts.max_rumor_num = 20;
+    opts.protocol_period = std::chrono::milliseconds(50);
+    opts.ping_timeout = std::chrono::milliseconds(20);
+    opts.suspicion_timeout = std::chrono::milliseconds(300);
+    opts.snapshot_interval = std::chrono::milliseconds(10);
+    opts.push_pull_options.interval = std::chrono::milliseconds(0);
+
+    return opts;
+}
+
+// Status of the node in the latest membership snapshot of `net`, or UNKNOWN if it's not there.
+NodeStatus status_of(const GossipNet &net, std::size_t idx) {
+    auto snapshot = net.membership();
+    const auto *node = snapshot->find(NodeId(node_id(idx)));
+
+    return node == nullptr ? NodeStatus::UNKNOWN : node->status;
+}
+
+bool knows(const GossipNet &net, std::size_t idx) {
+    return status_of(net, idx) == NodeStatus::ALIVE;
+}
+
+class GossipNetTest : public ::testing::Test {
+protected:
+    GossipNet& add(GossipNetOptions opts) {
+        _nets.push_back(std::make_unique<GossipNet>(opts));
+
+        return *_nets.back();
+    }
+
+    GossipNet& add(std::size_t idx) {
+        return add(options(idx));
+    }
+
+    // The first node joins nobody, and each of the others joins the previous one.
+    void make_cluster(const std::vector<GossipNetOptions> &opts) {
+        for (std::size_t idx = 0; idx != opts.size(); ++idx) {
+            auto &net = add(opts[idx]);
+            net.start();
+            if (idx > 0) {
+                net.join("127.0.0.1", opts[idx - 1].server_options.port);
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<GossipNet>> _nets;
+};
+
+TEST_F(GossipNetTest, SelfIsInState) {
+    auto &net = add(0);
+    ASSERT_TRUE(knows(net, 0));
+
+    const auto *self = net.membership()->find(NodeId(node_id(0)));
+    ASSERT_NE(self, nullptr);
+    EXPECT_EQ(self->ip.str(), "127.0.0.1");
+    EXPECT_EQ(self->port, node_port(0));
+}
+
+TEST_F(GossipNetTest, JoinLearnsFullView) {
+    auto &a = add(0);
+    auto &b = add(1);
+    auto &c = add(2);
+    a.start();
+    b.start();
+    c.start();
+
+    c.join("127.0.0.1", node_port(1));
+    ASSERT_TRUE(test::wait_until([&]() { return knows(c, 1) && knows(b, 2); }));
+
+    // A single push-pull with b tells a about c.
+    a.join("127.0.0.1", node_port(1));
+    ASSERT_TRUE(test::wait_until([&]() { return knows(a, 1) && knows(a, 2) && knows(b, 0); }));
+}
+
+TEST_F(GossipNetTest, RumorsSpreadWithPings) {
+    make_cluster({options(0), options(1), options(2)});
+
+    // 0 and 2 never push-pull with each other, and learn each other from rumors.
+    ASSERT_TRUE(test::wait_until([this]() {
+                    return knows(*_nets[0], 2) && knows(*_nets[2], 0);
+                }));
+}
+
+TEST_F(GossipNetTest, BinaryWithDictionary) {
+    std::vector<GossipNetOptions> opts;
+    for (std::size_t idx = 0; idx != 4; ++idx) {
+        opts.push_back(options(idx));
+        opts.back().rumor_dictionary_size = 16;
+    }
+    make_cluster(opts);
+
+    ASSERT_TRUE(test::wait_until([this]() {
+                    for (const auto &net : _nets) {
+                        for (std::size_t idx = 0; idx != _nets.size(); ++idx) {
+                            if (!knows(*net, idx)) {
+                                return false;
+                            }
+                        }
+                    }
+                    return true;
+                }));
+
+    // Rumors about known members are eventually sent as dictionary index.
+    EXPECT_TRUE(test::wait_until([this]() { return _nets[0]->stats().dictionary_refs > 0; }));
+}
+
+TEST_F(GossipNetTest, FailedMemberIsDetected) {
+    std::mutex mtx;
+    std::vector<MembershipEvent> events;
+    auto &a = add(0);
+    a.subscribe([&](const std::vector<MembershipEvent> &batch) {
+                std::lock_guard<std::mutex> lock(mtx);
+                events.insert(events.end(), batch.begin(), batch.end());
+            });
+    a.start();
+
+    auto &b = add(1);
+    b.start();
+    b.join("127.0.0.1", node_port(0));
+    ASSERT_TRUE(test::wait_until([&]() { return knows(a, 1); }));
+
+    _nets.pop_back();
+
+    // It's suspected by a failed probe, and declared failed after the suspicion timeout.
+    ASSERT_TRUE(test::wait_until([&]() { return status_of(a, 1) != NodeStatus::ALIVE; }));
+    ASSERT_TRUE(test::wait_until([&]() {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    return !events.empty() && events.back().type == MembershipEventType::FAILED;
+                }));
+
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(events.front().type, MembershipEventType::JOIN);
+    for (const auto &event : events) {
+        EXPECT_EQ(event.node.id.view(), node_id(1));
+    }
+}
+
+TEST_F(GossipNetTest, AckRespPing) {
+    auto &net = add(0);
+    net.start();
+
+    test::UdpSocket client;
+    Node self;
+    self.id.assign("client");
+    self.ip.assign("127.0.0.1");
+    self.port = client.port();
+
+    RespReplyBuilder builder;
+    builder.append_array(1 + 5);
+    builder.append_bulk_string("ping");
+    builder.append_node("self", self, false);
+    client.send_to(node_port(0), builder.data());
+
+    // Capabilities might be advertised before the ack.
+    std::string reply;
+    for (auto idx = 0; idx != 3 && reply.find("ack") == std::string::npos; ++idx) {
+        reply = client.recv();
+    }
+    EXPECT_NE(reply.find("ack"), std::string::npos);
+    EXPECT_NE(reply.find(node_id(0)), std::string::npos);
+
+    EXPECT_TRUE(test::wait_until([&net]() {
+                    const auto *node = net.membership()->find(NodeId("client"));
+                    return node != nullptr && node->status == NodeStatus::ALIVE;
+                }));
+}
+
+TEST_F(GossipNetTest, ShardsHandOverMessages) {
+    auto opts = options(0);
+    opts.shard_num = 4;
+    // Small enough that shards wait for the owner shard to drain it.
+    opts.message_queue_size = 2;
+    auto &net = add(opts);
+    net.start();
+
+    // Each client has its own source port, so that they're spread among shards.
+    constexpr std::size_t NUM = 8;
+    std::vector<std::unique_ptr<test::UdpSocket>> clients;
+    for (std::size_t idx = 0; idx != NUM; ++idx) {
+        clients.push_back(std::make_unique<test::UdpSocket>());
+
+        Node self;
+        self.id.assign("client-" + std::to_string(idx));
+        self.ip.assign("127.0.0.1");
+        self.port = clients.back()->port();
+
+        BinaryEncoder encoder;
+        encoder.append_header(MessageType::PING).append_node(self).append_varint(0);
+        for (auto num = 0; num != 10; ++num) {
+            clients.back()->send_to(node_port(0), encoder.data());
+        }
+    }
+
+    for (auto &client : clients) {
+        EXPECT_FALSE(client->recv().empty());
+    }
+
+    EXPECT_TRUE(test::wait_until([&net]() { return net.membership()->size() == NUM + 1; }));
+}
+
+TEST_F(GossipNetTest, StopIsIdempotent) {
+    auto &net = add(0);
+    net.start();
+    net.stop();
+    net.stop();
+}
+
+}
@@ -0,0 +1,257 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <map>
+#include <set>
+#include <string>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/member_set.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+std::set<std::string> ids(const std::vector<Node> &nodes) {
+    std::set<std::string> result;
+    for (const auto &node : nodes) {
+        result.emplace(node.id.view());
+    }
+
+    return result;
+}
+
+// Whether `node` is a stable member, i.e. an outdated update is rejected.
+bool contains(MemberSet &members, const Node &node) {
+    std::optional<NodeStatus> prev;
+    auto stale = node;
+    stale.status = NodeStatus::ALIVE;
+    stale.version = 0;
+
+    return !members.try_update(stale, prev) && !prev;
+}
+
+MemberSet make_members(std::size_t num) {
+    MemberSet members;
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        members.add(test::make_node(idx, 1));
+    }
+
+    return members;
+}
+
+TEST(MemberSetTest, TryUpdate) {
+    MemberSet members;
+    std::optional<NodeStatus> prev = NodeStatus::FAILED;
+    auto updated = members.try_update(test::make_node(0, 1), prev);
+    ASSERT_TRUE(updated);
+    EXPECT_FALSE(prev);
+    test::expect_node_eq(*updated, test::make_node(0, 1));
+
+    EXPECT_FALSE(members.contains(test::make_node(0).id));
+    members.add(test::make_node(0, 1));
+    EXPECT_EQ(members.size(), 1U);
+    EXPECT_TRUE(members.contains(test::make_node(0).id));
+    EXPECT_FALSE(members.contains(test::make_node(1).id));
+
+    // Outdated updates are rejected, and the member is kept.
+    EXPECT_FALSE(members.try_update(test::make_node(0, 0), prev));
+    EXPECT_FALSE(members.try_update(test::make_node(0, 1), prev));
+    EXPECT_EQ(members.size(), 1U);
+
+    // A newer update removes it from the stable set.
+    updated = members.try_update(test::make_node(0, 1, NodeStatus::SUSPECTED), prev);
+    ASSERT_TRUE(updated);
+    ASSERT_TRUE(prev);
+    EXPECT_EQ(*prev, NodeStatus::ALIVE);
+    EXPECT_EQ(updated->status, NodeStatus::SUSPECTED);
+    EXPECT_EQ(members.size(), 0U);
+    EXPECT_TRUE(members.all().empty());
+    EXPECT_FALSE(members.contains(test::make_node(0).id));
+
+    members.add(test::make_node(0, 1, NodeStatus::SUSPECTED));
+    updated = members.try_update(test::make_node(0, 0, NodeStatus::FAILED), prev);
+    ASSERT_TRUE(updated);
+    EXPECT_EQ(*prev, NodeStatus::SUSPECTED);
+}
+
+TEST(MemberSetTest, AddAndRemove) {
+    const std::size_t num = 1000;
+    auto members = make_members(num);
+    ASSERT_EQ(members.size(), num);
+
+    std::map<std::string, Node> expected;
+    for (const auto &node : members.all()) {
+        expected.emplace(node.id.view(), node);
+    }
+    ASSERT_EQ(expected.size(), num);
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        auto node = test::make_node(idx, 1);
+        auto iter = expected.find(std::string(node.id.view()));
+        ASSERT_NE(iter, expected.end());
+        test::expect_node_eq(iter->second, node);
+    }
+
+    // Remove the even ones, and add them back with reused indexes.
+    std::optional<NodeStatus> prev;
+    for (std::size_t idx = 0; idx < num; idx += 2) {
+        ASSERT_TRUE(members.try_update(test::make_node(idx, 2), prev));
+    }
+    EXPECT_EQ(members.size(), num / 2);
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        EXPECT_EQ(contains(members, test::make_node(idx)), idx % 2 == 1) << idx;
+    }
+
+    for (std::size_t idx = 0; idx < num; idx += 2) {
+        members.add(test::make_node(idx, 2));
+    }
+    EXPECT_EQ(members.size(), num);
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        EXPECT_TRUE(contains(members, test::make_node(idx))) << idx;
+    }
+
+    for (const auto &node : members.all()) {
+        auto idx = std::stoul(std::string(node.id.view().substr(5)));
+        test::expect_node_eq(node, test::make_node(idx, idx % 2 == 0 ? 2 : 1));
+    }
+}
+
+TEST(MemberSetTest, ProbeRoundRobin) {
+    MemberSet empty;
+    EXPECT_FALSE(empty.probe());
+
+    const std::size_t num = 100;
+    auto members = make_members(num);
+    for (int round = 0; round != 3; ++round) {
+        std::vector<Node> probed;
+        for (std::size_t idx = 0; idx != num; ++idx) {
+            auto node = members.probe();
+            ASSERT_TRUE(node);
+            probed.push_back(*node);
+        }
+
+        // Each member is probed exactly once per round.
+        EXPECT_EQ(ids(probed).size(), num);
+    }
+}
+
+TEST(MemberSetTest, ProbeWithChangesInRound) {
+    const std::size_t num = 100;
+    auto members = make_members(num);
+
+    std::vector<Node> probed;
+    for (std::size_t idx = 0; idx != num / 2; ++idx) {
+        probed.push_back(*members.probe());
+    }
+
+    // Remove some probed and some unprobed members, and add new ones in the middle of a round.
+    std::optional<NodeStatus> prev;
+    std::set<std::string> removed;
+    for (std::size_t idx = 0; idx < num; idx += 10) {
+        auto node = test::make_node(idx, 2);
+        ASSERT_TRUE(members.try_update(node, prev));
+        removed.emplace(node.id.view());
+    }
+
+    for (std::size_t idx = num; idx != num + 10; ++idx) {
+        members.add(test::make_node(idx, 1));
+    }
+
+    auto rest = members.size();
+    for (const auto &node : probed) {
+        if (removed.count(std::string(node.id.view())) == 0) {
+            --rest;
+        }
+    }
+
+    // New members and unprobed members are probed in this round, exactly once.
+    for (std::size_t idx = 0; idx != rest; ++idx) {
+        probed.push_back(*members.probe());
+    }
+
+    auto probed_ids = ids(probed);
+    EXPECT_EQ(probed_ids.size(), probed.size());
+    for (const auto &node : members.all()) {
+        EXPECT_EQ(probed_ids.count(std::string(node.id.view())), 1U) << node.id.view();
+    }
+}
+
+TEST(MemberSetTest, Fetch) {
+    const std::size_t num = 10;
+    auto members = make_members(num);
+
+    EXPECT_TRUE(members.fetch(0).empty());
+    EXPECT_EQ(ids(members.fetch(num)).size(), num);
+    EXPECT_EQ(ids(members.fetch(num * 2)).size(), num);
+
+    // Fetches walk members in round robin.
+    std::vector<Node> fetched;
+    for (int idx = 0; idx != 5; ++idx) {
+        auto nodes = members.fetch(2);
+        ASSERT_EQ(nodes.size(), 2U);
+        fetched.insert(fetched.end(), nodes.begin(), nodes.end());
+    }
+    EXPECT_EQ(ids(fetched).size(), num);
+}
+
+TEST(MemberSetTest, FetchWithBudget) {
+    MemberSet members;
+    // Members with ids of size 6 (node-0 ~ node-9) and 7 (node-10 ~ node-19).
+    for (std::size_t idx = 0; idx != 20; ++idx) {
+        members.add(test::make_node(idx));
+    }
+
+    NodeSize id_size = [](const Node &node) { return node.id.view().size(); };
+
+    std::size_t budget = 0;
+    EXPECT_TRUE(members.fetch(5, budget, id_size).empty());
+
+    budget = 1000;
+    EXPECT_TRUE(members.fetch(0, budget, id_size).empty());
+    EXPECT_EQ(budget, 1000U);
+
+    auto nodes = members.fetch(5, budget, id_size);
+    EXPECT_EQ(nodes.size(), 5U);
+    std::size_t total = 0;
+    for (const auto &node : nodes) {
+        total += node.id.view().size();
+    }
+    EXPECT_EQ(budget, 1000 - total);
+
+    // Only short ids fit, and longer ones are skipped.
+    NodeSize huge_long_id = [](const Node &node) {
+        return node.id.view().size() == 6 ? 1 : 100;
+    };
+    budget = 3;
+    nodes = members.fetch(20, budget, huge_long_id);
+    EXPECT_EQ(nodes.size(), 3U);
+    EXPECT_EQ(budget, 0U);
+    for (const auto &node : nodes) {
+        EXPECT_EQ(node.id.view().size(), 6U);
+    }
+
+    // Each member is visited at most once.
+    budget = 1000;
+    nodes = members.fetch(100, budget, id_size);
+    EXPECT_EQ(ids(nodes).size(), 20U);
+
+    // Give up after skipping `num` members.
+    budget = 5;
+    EXPECT_TRUE(members.fetch(3, budget, id_size).empty());
+    EXPECT_EQ(budget, 5U);
+}
+
+}
@@ -0,0 +1,290 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/membership_events.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+using Type = MembershipEventType;
+
+// Same as condition_variable::wait(), which might be missing in the libstdc++ runtime
+// shipped with gtest, see MembershipEventStream::_consume().
+template <typename Pred>
+void wait_until(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, Pred pred) {
+    while (!cv.wait_for(lock, std::chrono::milliseconds(100), pred)) {}
+}
+
+// Batches delivered to a listener. Queued batches are delivered before the stream
+// is destroyed, and the consumer thread is joined, so that they can be read safely.
+std::vector<std::vector<MembershipEvent>> deliver_batches(
+        const std::vector<std::pair<Type, Node>> &events) {
+    std::vector<std::vector<MembershipEvent>> batches;
+    {
+        MembershipEventStream stream(4);
+        stream.subscribe([&batches](const std::vector<MembershipEvent> &batch) {
+                    batches.push_back(batch);
+                });
+
+        for (const auto &[type, node] : events) {
+            stream.add(type, node);
+        }
+        stream.flush();
+    }
+
+    return batches;
+}
+
+std::vector<MembershipEvent> deliver(const std::vector<std::pair<Type, Node>> &events) {
+    auto batches = deliver_batches(events);
+    EXPECT_LE(batches.size(), 1U);
+
+    return batches.empty() ? std::vector<MembershipEvent>{} : batches.front();
+}
+
+TEST(MembershipEventsTest, EventType) {
+    EXPECT_EQ(membership_event(std::nullopt, NodeStatus::ALIVE), Type::JOIN);
+    EXPECT_EQ(membership_event(std::nullopt, NodeStatus::SUSPECTED), Type::JOIN);
+    EXPECT_EQ(membership_event(std::nullopt, NodeStatus::FAILED), std::nullopt);
+
+    EXPECT_EQ(membership_event(NodeStatus::SUSPECTED, NodeStatus::ALIVE), Type::ALIVE);
+    EXPECT_EQ(membership_event(NodeStatus::ALIVE, NodeStatus::ALIVE), std::nullopt);
+    EXPECT_EQ(membership_event(NodeStatus::ALIVE, NodeStatus::SUSPECTED), Type::SUSPECT);
+    EXPECT_EQ(membership_event(NodeStatus::SUSPECTED, NodeStatus::SUSPECTED), std::nullopt);
+    EXPECT_EQ(membership_event(NodeStatus::ALIVE, NodeStatus::FAILED), Type::FAILED);
+    EXPECT_EQ(membership_event(NodeStatus::SUSPECTED, NodeStatus::FAILED), Type::FAILED);
+    EXPECT_EQ(membership_event(NodeStatus::FAILED, NodeStatus::FAILED), std::nullopt);
+}
+
+TEST(MembershipEventsTest, Cancel) {
+    auto node = test::make_node(0, 1);
+    auto suspected = test::make_node(0, 1, NodeStatus::SUSPECTED);
+    auto failed = test::make_node(0, 1, NodeStatus::FAILED);
+    auto alive = test::make_node(0, 2);
+
+    // The member ends up in the status before the batch.
+    EXPECT_TRUE(deliver({{Type::JOIN, node}, {Type::LEAVE, failed}}).empty());
+    EXPECT_TRUE(deliver({{Type::JOIN, node}, {Type::FAILED, failed}, {Type::LEAVE, failed}}).empty());
+    EXPECT_TRUE(deliver({{Type::SUSPECT, suspected}, {Type::ALIVE, alive}}).empty());
+    EXPECT_TRUE(deliver({{Type::ALIVE, alive}, {Type::SUSPECT, suspected}}).empty());
+    EXPECT_TRUE(deliver({{Type::LEAVE, failed}, {Type::JOIN, node}, {Type::FAILED, failed}}).empty());
+
+    // Otherwise, it's not cancelled, even if some events cancel each other.
+    auto events = deliver({{Type::JOIN, node}, {Type::FAILED, failed}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::JOIN);
+    test::expect_node_eq(events[0].node, failed);
+
+    events = deliver({{Type::SUSPECT, suspected}, {Type::ALIVE, alive}, {Type::SUSPECT, suspected}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::SUSPECT);
+}
+
+TEST(MembershipEventsTest, RefutedAgainAfterDelivery) {
+    auto suspected = test::make_node(0, 1, NodeStatus::SUSPECTED);
+    auto alive = test::make_node(0, 2);
+    auto suspected_again = test::make_node(0, 2, NodeStatus::SUSPECTED);
+    auto alive_again = test::make_node(0, 3);
+
+    std::vector<std::vector<MembershipEvent>> batches;
+    {
+        MembershipEventStream stream(4);
+        stream.subscribe([&batches](const std::vector<MembershipEvent> &batch) {
+                    batches.push_back(batch);
+                });
+
+        stream.add(Type::SUSPECT, suspected);
+        stream.flush();
+
+        stream.add(Type::ALIVE, alive);
+        stream.add(Type::SUSPECT, suspected_again);
+        stream.add(Type::ALIVE, alive_again);
+        stream.flush();
+    }
+
+    // Listeners have seen it suspected, and must see it alive again.
+    ASSERT_EQ(batches.size(), 2U);
+    ASSERT_EQ(batches[0].size(), 1U);
+    EXPECT_EQ(batches[0][0].type, Type::SUSPECT);
+    ASSERT_EQ(batches[1].size(), 1U);
+    EXPECT_EQ(batches[1][0].type, Type::ALIVE);
+    test::expect_node_eq(batches[1][0].node, alive_again);
+}
+
+TEST(MembershipEventsTest, Merge) {
+    auto node = test::make_node(0, 1);
+    auto suspected = test::make_node(0, 1, NodeStatus::SUSPECTED);
+    auto failed = test::make_node(0, 1, NodeStatus::FAILED);
+    auto alive = test::make_node(0, 2);
+
+    // Listeners haven't seen the member joined yet.
+    auto events = deliver({{Type::JOIN, node}, {Type::SUSPECT, suspected}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::JOIN);
+    test::expect_node_eq(events[0].node, suspected);
+
+    events = deliver({{Type::JOIN, node}, {Type::SUSPECT, suspected}, {Type::ALIVE, alive}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::JOIN);
+    test::expect_node_eq(events[0].node, alive);
+
+    // Otherwise, the latest event wins.
+    events = deliver({{Type::SUSPECT, suspected}, {Type::FAILED, failed}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::FAILED);
+    test::expect_node_eq(events[0].node, failed);
+
+    events = deliver({{Type::ALIVE, node}, {Type::SUSPECT, suspected}, {Type::FAILED, failed}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::FAILED);
+
+    events = deliver({{Type::FAILED, failed}, {Type::LEAVE, failed}});
+    ASSERT_EQ(events.size(), 1U);
+    EXPECT_EQ(events[0].type, Type::LEAVE);
+}
+
+TEST(MembershipEventsTest, CancelKeepsOthers) {
+    std::vector<std::pair<Type, Node>> events;
+    for (std::size_t idx = 0; idx != 5; ++idx) {
+        events.emplace_back(Type::JOIN, test::make_node(idx));
+    }
+
+    // Cancel the first one, and the last one is moved to its place.
+    events.emplace_back(Type::LEAVE, test::make_node(0, 0, NodeStatus::FAILED));
+    events.emplace_back(Type::SUSPECT, test::make_node(4, 0, NodeStatus::SUSPECTED));
+    events.emplace_back(Type::LEAVE, test::make_node(2, 0, NodeStatus::FAILED));
+
+    std::vector<std::string> ids;
+    for (const auto &event : deliver(events)) {
+        EXPECT_EQ(event.type, Type::JOIN);
+        ids.emplace_back(event.node.id.view());
+    }
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, (std::vector<std::string>{"node-1", "node-3", "node-4"}));
+}
+
+TEST(MembershipEventsTest, Coalesced) {
+    MembershipEventStream stream(4);
+    stream.add(Type::JOIN, test::make_node(0));
+    stream.add(Type::SUSPECT, test::make_node(0, 0, NodeStatus::SUSPECTED));
+    stream.add(Type::LEAVE, test::make_node(1, 0, NodeStatus::FAILED));
+    EXPECT_EQ(stream.coalesced(), 1U);
+
+    stream.add(Type::FAILED, test::make_node(0, 0, NodeStatus::FAILED));
+    EXPECT_EQ(stream.coalesced(), 2U);
+
+    // All events of the member are cancelled.
+    stream.add(Type::LEAVE, test::make_node(0, 0, NodeStatus::FAILED));
+    EXPECT_EQ(stream.coalesced(), 4U);
+}
+
+TEST(MembershipEventsTest, EveryEventIsCounted) {
+    std::mt19937 rng(7);
+    const Type types[] = {Type::JOIN, Type::ALIVE, Type::SUSPECT, Type::FAILED, Type::LEAVE};
+    const NodeStatus statuses[] = {NodeStatus::ALIVE, NodeStatus::ALIVE, NodeStatus::SUSPECTED,
+        NodeStatus::FAILED, NodeStatus::FAILED};
+
+    std::size_t added = 0;
+    std::size_t delivered = 0;
+    std::size_t coalesced = 0;
+    std::size_t dropped = 0;
+    {
+        MembershipEventStream stream(2);
+        stream.subscribe([&delivered](const std::vector<MembershipEvent> &events) {
+                    delivered += events.size();
+                });
+
+        for (std::size_t round = 0; round != 100; ++round) {
+            for (std::size_t idx = 0; idx != 50; ++idx) {
+                auto kind = rng() % 5;
+                stream.add(types[kind], test::make_node(rng() % 10, round, statuses[kind]));
+                ++added;
+            }
+            stream.flush();
+        }
+
+        coalesced = stream.coalesced();
+        dropped = stream.dropped();
+    }
+
+    EXPECT_EQ(delivered + coalesced + dropped, added);
+}
+
+TEST(MembershipEventsTest, DrainOnDestruction) {
+    std::size_t delivered = 0;
+    {
+        MembershipEventStream stream(64);
+        stream.subscribe([&delivered](const std::vector<MembershipEvent> &events) {
+                    delivered += events.size();
+                });
+
+        for (std::size_t idx = 0; idx != 50; ++idx) {
+            stream.add(Type::JOIN, test::make_node(idx));
+            stream.flush();
+        }
+    }
+
+    EXPECT_EQ(delivered, 50U);
+}
+
+TEST(MembershipEventsTest, DropWhenFull) {
+    MembershipEventStream stream(1);
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool entered = false;
+    bool released = false;
+    stream.subscribe([&](const std::vector<MembershipEvent> &) {
+                std::unique_lock<std::mutex> lock(mtx);
+                if (!entered) {
+                    entered = true;
+                    cv.notify_all();
+                    wait_until(cv, lock, [&released]() { return released; });
+                }
+            });
+
+    // Block the consumer in the listener.
+    stream.add(Type::JOIN, test::make_node(0));
+    stream.flush();
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        wait_until(cv, lock, [&entered]() { return entered; });
+    }
+
+    stream.add(Type::JOIN, test::make_node(1));
+    stream.flush();
+    stream.add(Type::JOIN, test::make_node(2));
+    stream.add(Type::JOIN, test::make_node(3));
+    stream.flush();
+    EXPECT_EQ(stream.dropped(), 2U);
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        released = true;
+    }
+    cv.notify_all();
+}
+
+}
@@ -0,0 +1,113 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/membership.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+TEST(MembershipTest, Snapshot) {
+    std::vector<Node> nodes = {
+        test::make_node(0, 0, NodeStatus::FAILED),
+        test::make_node(1),
+        test::make_node(2, 0, NodeStatus::SUSPECTED),
+        test::make_node(3),
+    };
+    MembershipSnapshot snapshot(nodes, 7);
+    EXPECT_EQ(snapshot.version(), 7U);
+    EXPECT_EQ(snapshot.size(), nodes.size());
+
+    // Grouped by status.
+    auto alive = snapshot.members(NodeStatus::ALIVE);
+    ASSERT_EQ(alive.size(), 2U);
+    test::expect_node_eq(alive[0], nodes[1]);
+    test::expect_node_eq(alive[1], nodes[3]);
+    EXPECT_EQ(snapshot.members(NodeStatus::SUSPECTED).size(), 1U);
+    EXPECT_EQ(snapshot.members(NodeStatus::FAILED).size(), 1U);
+    EXPECT_TRUE(snapshot.members(NodeStatus::UNKNOWN).empty());
+    EXPECT_EQ(snapshot.all().size(), nodes.size());
+
+    for (const auto &node : nodes) {
+        auto *found = snapshot.find(node.id);
+        ASSERT_NE(found, nullptr);
+        test::expect_node_eq(*found, node);
+    }
+    EXPECT_EQ(snapshot.find(test::make_node(4).id), nullptr);
+}
+
+TEST(MembershipTest, Publish) {
+    MembershipPublisher publisher;
+    EXPECT_EQ(publisher.version(), 0U);
+    EXPECT_EQ(publisher.snapshot()->size(), 0U);
+
+    MembershipReader reader(publisher);
+    EXPECT_EQ(reader.acquire().size(), 0U);
+
+    auto old = publisher.snapshot();
+    publisher.publish({test::make_node(0)});
+    EXPECT_EQ(publisher.version(), 1U);
+    EXPECT_EQ(publisher.snapshot()->version(), 1U);
+    EXPECT_EQ(publisher.snapshot()->size(), 1U);
+
+    // Readers keep old snapshots alive, and pick up new ones.
+    EXPECT_EQ(old->size(), 0U);
+    EXPECT_EQ(reader.acquire().version(), 1U);
+    EXPECT_NE(reader.acquire().find(test::make_node(0).id), nullptr);
+}
+
+TEST(MembershipTest, ConcurrentReaders) {
+    MembershipPublisher publisher;
+    std::atomic<bool> stop{false};
+
+    std::vector<std::thread> readers;
+    for (int idx = 0; idx != 4; ++idx) {
+        readers.emplace_back([&publisher, &stop]() {
+                    MembershipReader reader(publisher);
+                    uint64_t version = 0;
+                    while (!stop.load()) {
+                        const auto &snapshot = reader.acquire();
+                        // Versions never go back, and a snapshot is always complete.
+                        EXPECT_GE(snapshot.version(), version);
+                        EXPECT_EQ(snapshot.size(), snapshot.version());
+                        version = snapshot.version();
+
+                        auto ptr = publisher.snapshot();
+                        EXPECT_EQ(ptr->size(), ptr->version());
+                    }
+                });
+    }
+
+    std::vector<Node> nodes;
+    for (std::size_t idx = 0; idx != 200; ++idx) {
+        nodes.push_back(test::make_node(idx));
+        publisher.publish(nodes);
+    }
+
+    stop = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(publisher.snapshot()->size(), 200U);
+}
+
+}
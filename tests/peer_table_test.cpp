@@ -0,0 +1,73 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <gtest/gtest.h>
+#include <sw/gossip-net/peer_table.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+TEST(PeerTableTest, AddAndRemove) {
+    PeerTable peers;
+    auto node = test::make_node(0);
+    auto handle = peers.add(node.id, node.ip, node.port);
+    ASSERT_TRUE(handle.valid());
+    EXPECT_NE(peers.get(handle), nullptr);
+    EXPECT_EQ(peers.find(node.id).index, handle.index);
+
+    // Same address, same handle.
+    auto again = peers.add(node.id, node.ip, node.port);
+    EXPECT_EQ(again.index, handle.index);
+    EXPECT_EQ(again.generation, handle.generation);
+
+    peers.remove(node.id);
+    EXPECT_EQ(peers.size(), 0U);
+    EXPECT_EQ(peers.get(handle), nullptr);
+    EXPECT_FALSE(peers.find(node.id).valid());
+}
+
+TEST(PeerTableTest, FormatAndNegotiation) {
+    PeerTable peers;
+    auto node = test::make_node(0);
+    auto handle = peers.add(node.id, node.ip, node.port);
+    EXPECT_EQ(peers.format(handle), WireFormat::UNKNOWN);
+
+    auto *negotiation = peers.negotiation(handle);
+    ASSERT_NE(negotiation, nullptr);
+    EXPECT_EQ(negotiation->attempts, 0U);
+    negotiation->attempts = 2;
+    negotiation->period = 10;
+    peers.set_format(handle, WireFormat::BINARY);
+    EXPECT_EQ(peers.format(handle), WireFormat::BINARY);
+
+    // A new peer reusing the slot starts negotiation from scratch.
+    peers.remove(node.id);
+    EXPECT_EQ(peers.negotiation(handle), nullptr);
+    EXPECT_EQ(peers.format(handle), WireFormat::UNKNOWN);
+
+    auto other = test::make_node(1);
+    auto reused = peers.add(other.id, other.ip, other.port);
+    EXPECT_EQ(reused.index, handle.index);
+    EXPECT_EQ(peers.format(reused), WireFormat::UNKNOWN);
+    negotiation = peers.negotiation(reused);
+    ASSERT_NE(negotiation, nullptr);
+    EXPECT_EQ(negotiation->attempts, 0U);
+    EXPECT_EQ(negotiation->period, 0U);
+}
+
+}
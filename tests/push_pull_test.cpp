@@ -0,0 +1,182 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/gossip_net.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr int BASE_PORT = 47300;
+
+// Push-pull runs in GossipNet, and probing is slowed down, so that only push-pull
+// changes the membership.
+GossipNetOptions options(std::size_t idx) {
+    GossipNetOptions opts;
+    opts.id = "peer-" + std::to_string(idx);
+    opts.server_options.ip = "127.0.0.1";
+    opts.server_options.port = BASE_PORT + static_cast<int>(idx);
+    opts.server_options.buffer_size = 64 * 1024;
+    opts.lambda = 3;
+    opts.max_rumor_num = 20;
+    opts.protocol_period = std::chrono::seconds(60);
+    opts.snapshot_interval = std::chrono::milliseconds(10);
+    opts.push_pull_options.interval = std::chrono::milliseconds(0);
+    opts.push_pull_options.merge_batch_size = 64;
+
+    return opts;
+}
+
+// Start the node, and add `num` members to it.
+void start(GossipNet &net, std::size_t num) {
+    net.start();
+
+    std::vector<Node> nodes;
+    for (std::size_t idx = 0; idx != num; ++idx) {
+        nodes.push_back(test::make_node(idx));
+    }
+
+    net.dispatch([&net, nodes = std::move(nodes)]() mutable {
+                net.update(std::move(nodes));
+            });
+
+    ASSERT_TRUE(test::wait_until([&net, num]() { return net.membership()->size() == num + 1; }));
+}
+
+// A TCP connection, which sends nothing, and keeps a push-pull exchange open.
+class IdleConnection {
+public:
+    explicit IdleConnection(int port) {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        EXPECT_GE(_fd, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        EXPECT_EQ(::connect(_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)), 0);
+    }
+
+    IdleConnection(const IdleConnection &) = delete;
+    IdleConnection& operator=(const IdleConnection &) = delete;
+
+    ~IdleConnection() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    // Whether the peer closes the connection in the given time.
+    bool closed(std::chrono::milliseconds timeout) {
+        pollfd fd = {_fd, POLLIN, 0};
+        if (::poll(&fd, 1, static_cast<int>(timeout.count())) <= 0) {
+            return false;
+        }
+
+        char c;
+        return ::recv(_fd, &c, 1, 0) <= 0;
+    }
+
+private:
+    int _fd = -1;
+};
+
+TEST(PushPullTest, LargeStateIsMergedInBatches) {
+    GossipNet a(options(0));
+    GossipNet b(options(1));
+    a.start();
+    start(b, 1000);
+
+    a.join("127.0.0.1", BASE_PORT + 1);
+
+    ASSERT_TRUE(test::wait_until([&a]() { return a.membership()->size() == 1002; }));
+    EXPECT_TRUE(test::wait_until([&b]() { return b.membership()->size() == 1002; }));
+
+    const auto *node = a.membership()->find(test::make_node(999).id);
+    ASSERT_NE(node, nullptr);
+    test::expect_node_eq(*node, test::make_node(999));
+}
+
+TEST(PushPullTest, CompressedState) {
+    auto a_opts = options(0);
+    auto b_opts = options(1);
+    a_opts.push_pull_options.compression_threshold = 1;
+    b_opts.push_pull_options.compression_threshold = 1;
+    GossipNet a(a_opts);
+    GossipNet b(b_opts);
+    a.start();
+    start(b, 500);
+
+    a.join("127.0.0.1", BASE_PORT + 1);
+
+    EXPECT_TRUE(test::wait_until([&a]() { return a.membership()->size() == 502; }));
+}
+
+TEST(PushPullTest, OversizedStateIsDropped) {
+    auto a_opts = options(0);
+    a_opts.push_pull_options.max_state_size = 1024;
+    GossipNet a(a_opts);
+    GossipNet b(options(1));
+    a.start();
+    start(b, 500);
+
+    a.join("127.0.0.1", BASE_PORT + 1);
+
+    // b merges the small state of a, while a drops the large one of b.
+    ASSERT_TRUE(test::wait_until([&b]() { return b.membership()->size() == 502; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(a.membership()->size(), 1U);
+}
+
+TEST(PushPullTest, RejectBeyondMaxConnections) {
+    auto opts = options(0);
+    opts.push_pull_options.max_connections = 2;
+    GossipNet net(opts);
+    net.start();
+
+    auto first = std::make_unique<IdleConnection>(BASE_PORT);
+    IdleConnection second(BASE_PORT);
+    IdleConnection third(BASE_PORT);
+    EXPECT_TRUE(third.closed(std::chrono::seconds(1)));
+    EXPECT_FALSE(first->closed(std::chrono::milliseconds(100)));
+    EXPECT_FALSE(second.closed(std::chrono::milliseconds(100)));
+
+    // Once an exchange ends, i.e. the empty state is rejected, a slot is freed.
+    first.reset();
+    ASSERT_TRUE(test::wait_until([]() {
+                    IdleConnection conn(BASE_PORT);
+                    return !conn.closed(std::chrono::milliseconds(100));
+                }));
+
+    // Exchanges started by this node are not limited.
+    GossipNet peer(options(1));
+    peer.start();
+    net.join("127.0.0.1", BASE_PORT + 1);
+    EXPECT_TRUE(test::wait_until([&net]() { return net.membership()->size() == 2; }));
+}
+
+}
@@ -0,0 +1,156 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <set>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/recently_updated_set.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+std::vector<std::string> ids(const std::vector<Node> &nodes) {
+    std::vector<std::string> result;
+    for (const auto &node : nodes) {
+        result.emplace_back(node.id.view());
+    }
+
+    return result;
+}
+
+std::vector<std::string> make_ids(std::initializer_list<std::size_t> indexes) {
+    std::vector<std::string> result;
+    for (auto idx : indexes) {
+        result.emplace_back(test::make_node(idx).id.view());
+    }
+
+    return result;
+}
+
+const NodeSize ID_SIZE = [](const Node &node) { return node.id.view().size(); };
+
+constexpr std::size_t MAX_SPREADED_NUM = 3;
+
+RecentlyUpdatedSet::FetchResult fetch(RecentlyUpdatedSet &recent, std::size_t n) {
+    std::size_t budget = 1000;
+    return recent.fetch(n, MAX_SPREADED_NUM, budget, ID_SIZE);
+}
+
+TEST(RecentlyUpdatedSetTest, Add) {
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    EXPECT_TRUE(recent.add(test::make_node(0, 1), prev));
+    EXPECT_FALSE(prev);
+    EXPECT_EQ(recent.size(), 1U);
+    EXPECT_TRUE(recent.contains(test::make_node(0).id));
+    EXPECT_FALSE(recent.contains(test::make_node(1).id));
+
+    // Not newer.
+    EXPECT_FALSE(recent.add(test::make_node(0, 1), prev));
+    EXPECT_FALSE(recent.add(test::make_node(0, 0), prev));
+    EXPECT_FALSE(prev);
+
+    EXPECT_TRUE(recent.add(test::make_node(0, 1, NodeStatus::SUSPECTED), prev));
+    ASSERT_TRUE(prev);
+    EXPECT_EQ(*prev, NodeStatus::ALIVE);
+    EXPECT_EQ(recent.size(), 1U);
+
+    auto all = recent.all();
+    ASSERT_EQ(all.size(), 1U);
+    test::expect_node_eq(all[0], test::make_node(0, 1, NodeStatus::SUSPECTED));
+}
+
+TEST(RecentlyUpdatedSetTest, FetchLeastSpreaded) {
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    for (std::size_t idx = 0; idx != 3; ++idx) {
+        recent.add(test::make_node(idx), prev);
+    }
+
+    std::size_t budget = 1000;
+    EXPECT_TRUE(std::get<0>(recent.fetch(0, MAX_SPREADED_NUM, budget, ID_SIZE)).empty());
+
+    // Least spreaded first, and in the order they're spreaded.
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 2))), make_ids({0, 1}));
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 2))), make_ids({2, 0}));
+    // A member is fetched at most once per call.
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 5))), make_ids({1, 2, 0}));
+
+    // An update resets the counter.
+    recent.add(test::make_node(2, 1), prev);
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 1))), make_ids({2}));
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 3))), make_ids({2, 1}));
+}
+
+TEST(RecentlyUpdatedSetTest, Stable) {
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    recent.add(test::make_node(0), prev);
+    recent.add(test::make_node(1, 0, NodeStatus::FAILED), prev);
+
+    for (std::size_t idx = 0; idx != MAX_SPREADED_NUM; ++idx) {
+        auto [recent_nodes, stable_nodes, reaped_nodes] = fetch(recent, 2);
+        EXPECT_EQ(recent_nodes.size(), 2U);
+        EXPECT_TRUE(stable_nodes.empty());
+        EXPECT_TRUE(reaped_nodes.empty());
+    }
+
+    recent.add(test::make_node(2), prev);
+
+    // node-0 and node-1 have been spreaded MAX_SPREADED_NUM times.
+    auto [recent_nodes, stable_nodes, reaped_nodes] = fetch(recent, 2);
+    EXPECT_EQ(ids(recent_nodes), make_ids({2}));
+    EXPECT_EQ(ids(stable_nodes), make_ids({0}));
+    ASSERT_EQ(reaped_nodes.size(), 1U);
+    test::expect_node_eq(reaped_nodes[0], test::make_node(1, 0, NodeStatus::FAILED));
+    EXPECT_EQ(recent.size(), 1U);
+
+    // A removed member is added back as a new one, reusing the slot.
+    EXPECT_TRUE(recent.add(test::make_node(0), prev));
+    EXPECT_EQ(recent.size(), 2U);
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 1))), make_ids({0}));
+}
+
+TEST(RecentlyUpdatedSetTest, Budget) {
+    RecentlyUpdatedSet recent;
+    std::optional<NodeStatus> prev;
+    // node-10 is much larger than node-1 and node-2.
+    NodeSize node_size = [](const Node &node) {
+        return node.id.view().size() == 6 ? 1 : 100;
+    };
+    for (auto idx : {10, 1, 2}) {
+        recent.add(test::make_node(idx), prev);
+    }
+
+    // node-10 doesn't fit, and it's skipped without increasing its counter.
+    std::size_t budget = 2;
+    auto recent_nodes = std::get<0>(recent.fetch(3, MAX_SPREADED_NUM, budget, node_size));
+    EXPECT_EQ(ids(recent_nodes), make_ids({1, 2}));
+    EXPECT_EQ(budget, 0U);
+
+    EXPECT_EQ(ids(std::get<0>(fetch(recent, 1))), make_ids({10}));
+
+    // Stop after skipping N members.
+    budget = 5;
+    recent_nodes = std::get<0>(recent.fetch(2, MAX_SPREADED_NUM, budget, ID_SIZE));
+    EXPECT_TRUE(recent_nodes.empty());
+    EXPECT_EQ(budget, 5U);
+}
+
+}
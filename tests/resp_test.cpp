@@ -0,0 +1,293 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <charconv>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/errors.h>
+#include <sw/gossip-net/resp.h>
+
+namespace {
+
+using namespace sw::gossip;
+
+// Parse result that can be compared: requests as name followed by args,
+// number of bytes parsed, and whether it throws.
+struct Result {
+    std::vector<std::vector<std::string>> requests;
+
+    std::size_t len = 0;
+
+    bool error = false;
+
+    bool operator==(const Result &other) const {
+        return requests == other.requests && len == other.len && error == other.error;
+    }
+};
+
+std::ostream& operator<<(std::ostream &os, const Result &result) {
+    os << "{requests: " << result.requests.size() << ", len: " << result.len
+        << ", error: " << result.error << "}";
+    return os;
+}
+
+Result parse(RespRequestParser &parser, std::string_view data) {
+    Result result;
+    try {
+        auto [requests, len] = parser.parse(data);
+        for (const auto &req : requests) {
+            std::vector<std::string> request = {std::string(req.name)};
+            for (const auto &arg : req.args) {
+                request.emplace_back(arg);
+            }
+            result.requests.push_back(std::move(request));
+        }
+        result.len = len;
+    } catch (const Error &) {
+        result = Result{};
+        result.error = true;
+    }
+
+    return result;
+}
+
+// A straightforward scalar parser, which scans each number with std::from_chars.
+// It's the reference of the optimized parser.
+class ReferenceParser {
+public:
+    Result parse(std::string_view data) {
+        Result result;
+        try {
+            auto *first = data.data();
+            while (true) {
+                auto argc = _parse_num('*', data);
+                if (!argc) {
+                    break;
+                }
+
+                if (*argc < 1) {
+                    throw Error("invalid request, no command name");
+                }
+
+                std::vector<std::string> request;
+                std::size_t idx = 0;
+                for ( ; idx != *argc; ++idx) {
+                    auto argv = _parse_argv(data);
+                    if (!argv) {
+                        break;
+                    }
+                    request.emplace_back(*argv);
+                }
+
+                if (idx < *argc) {
+                    break;
+                }
+
+                result.requests.push_back(std::move(request));
+                result.len = data.data() - first;
+            }
+        } catch (const Error &) {
+            result = Result{};
+            result.error = true;
+        }
+
+        return result;
+    }
+
+private:
+    std::optional<std::size_t> _parse_num(char c, std::string_view &data) {
+        if (data.empty()) {
+            return std::nullopt;
+        }
+
+        if (data.front() != c) {
+            throw Error("unexpected type");
+        }
+
+        data.remove_prefix(1);
+        if (data.empty()) {
+            return std::nullopt;
+        }
+
+        std::size_t num = 0;
+        auto *last = data.data() + data.size();
+        auto [ptr, err] = std::from_chars(data.data(), last, num);
+        if (err != std::errc()) {
+            throw Error("expect a positive integer");
+        }
+
+        if (ptr + 2 > last) {
+            return std::nullopt;
+        }
+
+        if (*ptr != '\r' || *(ptr + 1) != '\n') {
+            throw Error("expect '\\r\\n'");
+        }
+
+        data.remove_prefix(ptr + 2 - data.data());
+
+        return num;
+    }
+
+    std::optional<std::string_view> _parse_argv(std::string_view &data) {
+        auto len = _parse_num('$', data);
+        if (!len) {
+            return std::nullopt;
+        }
+
+        if (*len > data.size() || data.size() - *len < 2) {
+            return std::nullopt;
+        }
+
+        if (data[*len] != '\r' || data[*len + 1] != '\n') {
+            throw Error("expect '\\r\\n'");
+        }
+
+        auto argv = data.substr(0, *len);
+        data.remove_prefix(*len + 2);
+
+        return argv;
+    }
+};
+
+std::string encode(const std::vector<std::string> &request) {
+    std::string data = "*" + std::to_string(request.size()) + "\r\n";
+    for (const auto &arg : request) {
+        data += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+
+    return data;
+}
+
+TEST(RespRequestParserTest, Parse) {
+    RespRequestParser parser;
+    auto data = encode({"ping", "self", "node-1", "10.0.0.1", "7000", "3"})
+        + encode({"ack"});
+    auto result = parse(parser, data);
+    ASSERT_FALSE(result.error);
+    EXPECT_EQ(result.len, data.size());
+    ASSERT_EQ(result.requests.size(), 2U);
+    EXPECT_EQ(result.requests[0],
+            (std::vector<std::string>{"ping", "self", "node-1", "10.0.0.1", "7000", "3"}));
+    EXPECT_EQ(result.requests[1], (std::vector<std::string>{"ack"}));
+}
+
+TEST(RespRequestParserTest, BinarySafeArgs) {
+    RespRequestParser parser;
+    std::string arg("a\r\n$3\r\n*1\r\n\0b", 13);
+    auto data = encode({"set", arg, ""});
+    auto result = parse(parser, data);
+    ASSERT_EQ(result.requests.size(), 1U);
+    EXPECT_EQ(result.requests[0][1], arg);
+    EXPECT_EQ(result.requests[0][2], "");
+}
+
+TEST(RespRequestParserTest, Incomplete) {
+    RespRequestParser parser;
+    auto first = encode({"ping", "a"});
+    auto data = first + encode({"ping", "b"});
+    for (auto len = first.size(); len != data.size(); ++len) {
+        auto result = parse(parser, std::string_view(data.data(), len));
+        ASSERT_FALSE(result.error) << "length " << len;
+        EXPECT_EQ(result.len, first.size());
+        EXPECT_EQ(result.requests.size(), 1U);
+    }
+}
+
+TEST(RespRequestParserTest, Invalid) {
+    RespRequestParser parser;
+    for (const auto *data : {"+OK\r\n", "*0\r\n", "*-1\r\n", "*1\r\n+ping\r\n",
+            "*1\r\n$4\r\npingxx", "*1x\r\n", "*1\r\n$x\r\n", "*1\n$4\r\nping\r\n",
+            "*99999999999999999999999\r\n"}) {
+        EXPECT_TRUE(parse(parser, data).error) << data;
+    }
+}
+
+TEST(RespRequestParserTest, ArenaIsReused) {
+    RespRequestParser parser;
+    auto data = encode({"ping", "self", "node-1", "10.0.0.1", "7000", "3"});
+    parse(parser, data);
+    auto grow_count = parser.grow_count();
+    for (int idx = 0; idx != 100; ++idx) {
+        parse(parser, data);
+    }
+    EXPECT_EQ(parser.grow_count(), grow_count);
+}
+
+// Differential fuzzing against the reference parser, with valid requests that are
+// truncated and mutated with bytes that are meaningful in RESP.
+TEST(RespRequestParserTest, DifferentialFuzz) {
+    std::mt19937_64 rng(20211017);
+    auto random = [&rng](std::size_t max) {
+        return std::uniform_int_distribution<std::size_t>(0, max)(rng);
+    };
+
+    const std::string alphabet("*$\r\n0123456789-+ xa\0", 20);
+
+    RespRequestParser parser;
+    ReferenceParser reference;
+    for (int round = 0; round != 50000; ++round) {
+        std::string data;
+        auto request_num = 1 + random(3);
+        for (std::size_t req = 0; req != request_num; ++req) {
+            std::vector<std::string> request;
+            auto argc = 1 + random(6);
+            for (std::size_t idx = 0; idx != argc; ++idx) {
+                std::string arg;
+                auto len = random(3) == 0 ? random(20) : random(4);
+                for (std::size_t pos = 0; pos != len; ++pos) {
+                    arg.push_back(alphabet[random(alphabet.size() - 1)]);
+                }
+                request.push_back(std::move(arg));
+            }
+            data += encode(request);
+        }
+
+        switch (random(3)) {
+        case 0:
+            data.resize(random(data.size()));
+            break;
+
+        case 1: {
+            auto mutations = 1 + random(3);
+            for (std::size_t idx = 0; idx != mutations && !data.empty(); ++idx) {
+                data[random(data.size() - 1)] = alphabet[random(alphabet.size() - 1)];
+            }
+            break;
+        }
+
+        case 2:
+            if (!data.empty()) {
+                auto pos = random(data.size() - 1);
+                data.insert(pos, 1, alphabet[random(alphabet.size() - 1)]);
+                data.resize(random(data.size()));
+            }
+            break;
+
+        default:
+            // Valid input.
+            break;
+        }
+
+        ASSERT_EQ(parse(parser, data), reference.parse(data)) << "round " << round;
+    }
+}
+
+}
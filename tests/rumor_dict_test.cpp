@@ -0,0 +1,319 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/rumor_dict.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+// A message with dictionary coding, whose rumors are stripped as they're on the wire.
+struct Packet {
+    DictHeader header;
+
+    std::vector<Node> rumors;
+
+    std::vector<RumorCode> codes;
+};
+
+Packet send(RumorDictionary &dict, const std::vector<Node> &nodes = {}) {
+    Packet packet;
+    packet.header = dict.begin_message();
+    for (const auto &node : nodes) {
+        auto code = dict.encode(node);
+        auto rumor = node;
+        if (code.kind == RumorKind::REF) {
+            rumor = Node{};
+            rumor.version = node.version;
+            rumor.status = node.status;
+        }
+        packet.rumors.push_back(rumor);
+        packet.codes.push_back(code);
+    }
+
+    return packet;
+}
+
+struct Received {
+    bool fresh = false;
+
+    // std::nullopt for rumors that cannot be resolved.
+    std::vector<std::optional<Node>> rumors;
+};
+
+// Resolve the message as GossipNet does.
+Received receive(RumorDictionary &dict, Packet packet) {
+    Received received;
+    received.fresh = std::all_of(packet.codes.begin(), packet.codes.end(),
+            [&dict](const RumorCode &code) { return dict.valid(code); })
+        && dict.on_header(packet.header);
+    for (std::size_t idx = 0; idx != packet.rumors.size(); ++idx) {
+        auto &node = packet.rumors[idx];
+        const auto &code = packet.codes[idx];
+        if (received.fresh ? dict.decode(node, code) : code.kind != RumorKind::REF) {
+            received.rumors.push_back(node);
+        } else {
+            received.rumors.push_back(std::nullopt);
+        }
+    }
+
+    return received;
+}
+
+// Both sides exchange a message, so that each side acks the other.
+void exchange(RumorDictionary &lhs, RumorDictionary &rhs) {
+    receive(rhs, send(lhs));
+    receive(lhs, send(rhs));
+}
+
+class RumorDictionaryTest : public ::testing::Test {
+protected:
+    RumorDictionary _local{16, 100};
+
+    RumorDictionary _remote{16, 200};
+};
+
+TEST_F(RumorDictionaryTest, DefineThenRef) {
+    auto node = test::make_node(1, 3);
+    auto packet = send(_local, {node});
+    EXPECT_EQ(packet.codes[0].kind, RumorKind::DEFINE);
+    EXPECT_EQ(_local.size(node), binary::rumor_size(node, packet.codes[0]));
+
+    auto received = receive(_remote, packet);
+    ASSERT_TRUE(received.fresh);
+    ASSERT_TRUE(received.rumors[0]);
+    test::expect_node_eq(*received.rumors[0], node);
+
+    // Not acked yet.
+    EXPECT_EQ(send(_local, {node}).codes[0].kind, RumorKind::DEFINE);
+
+    receive(_local, send(_remote));
+
+    node.version = 4;
+    packet = send(_local, {node});
+    EXPECT_EQ(packet.codes[0].kind, RumorKind::REF);
+    EXPECT_LT(binary::rumor_size(node, packet.codes[0]), binary::node_size(node));
+
+    received = receive(_remote, packet);
+    ASSERT_TRUE(received.rumors[0]);
+    test::expect_node_eq(*received.rumors[0], node);
+}
+
+TEST_F(RumorDictionaryTest, LostDefineIsSentAgain) {
+    auto node = test::make_node(1);
+    // Lost.
+    send(_local, {node});
+
+    exchange(_local, _remote);
+    EXPECT_EQ(send(_local, {node}).codes[0].kind, RumorKind::DEFINE);
+}
+
+TEST_F(RumorDictionaryTest, ReorderedAcks) {
+    auto first = test::make_node(1);
+    auto second = test::make_node(2);
+    receive(_remote, send(_local, {first}));
+    auto old_ack = send(_remote);
+    receive(_remote, send(_local, {second}));
+    auto new_ack = send(_remote);
+
+    auto epoch = _local.header().epoch;
+    receive(_local, new_ack);
+    // A stale ack never revokes entries, or rebuilds the dictionary.
+    receive(_local, old_ack);
+    EXPECT_EQ(_local.header().epoch, epoch);
+
+    auto packet = send(_local, {first, second});
+    EXPECT_EQ(packet.codes[0].kind, RumorKind::REF);
+    EXPECT_EQ(packet.codes[1].kind, RumorKind::REF);
+
+    auto received = receive(_remote, packet);
+    ASSERT_TRUE(received.rumors[0] && received.rumors[1]);
+    test::expect_node_eq(*received.rumors[0], first);
+    test::expect_node_eq(*received.rumors[1], second);
+}
+
+TEST_F(RumorDictionaryTest, ReorderedMessagesInWindow) {
+    auto first = test::make_node(1);
+    auto second = test::make_node(2);
+    auto old_packet = send(_local, {first});
+    auto new_packet = send(_local, {second});
+
+    EXPECT_TRUE(receive(_remote, new_packet).fresh);
+    EXPECT_TRUE(receive(_remote, old_packet).fresh);
+
+    // Both are acked with the bitmap.
+    receive(_local, send(_remote));
+    auto packet = send(_local, {first, second});
+    EXPECT_EQ(packet.codes[0].kind, RumorKind::REF);
+    EXPECT_EQ(packet.codes[1].kind, RumorKind::REF);
+
+    auto received = receive(_remote, packet);
+    ASSERT_TRUE(received.rumors[0] && received.rumors[1]);
+    test::expect_node_eq(*received.rumors[0], first);
+}
+
+TEST_F(RumorDictionaryTest, StaleMessage) {
+    auto node = test::make_node(1);
+    receive(_remote, send(_local, {node}));
+    receive(_local, send(_remote));
+
+    auto stale = send(_local, {node});
+    ASSERT_EQ(stale.codes[0].kind, RumorKind::REF);
+
+    // The last WINDOW messages before the latest one are still in the window.
+    for (uint64_t idx = 0; idx != RumorDictionary::WINDOW; ++idx) {
+        receive(_remote, send(_local));
+    }
+    auto received = receive(_remote, stale);
+    EXPECT_TRUE(received.fresh);
+
+    receive(_remote, send(_local));
+    received = receive(_remote, stale);
+    EXPECT_FALSE(received.fresh);
+    EXPECT_FALSE(received.rumors[0]);
+}
+
+TEST_F(RumorDictionaryTest, RemovedIndexIsReusedAfterWindow) {
+    RumorDictionary local(1, 100);
+    auto removed = test::make_node(1);
+    auto added = test::make_node(2);
+
+    receive(_remote, send(local, {removed}));
+    exchange(local, _remote);
+    auto old_ref = send(local, {removed});
+    ASSERT_EQ(old_ref.codes[0].kind, RumorKind::REF);
+
+    local.remove(removed.id);
+
+    // The peer might still receive messages referring to the removed member.
+    EXPECT_EQ(local.size(added), binary::rumor_size(added, {RumorKind::FULL, 0}));
+    EXPECT_EQ(send(local, {added}).codes[0].kind, RumorKind::FULL);
+
+    for (uint64_t idx = 0; idx != RumorDictionary::WINDOW; ++idx) {
+        exchange(local, _remote);
+    }
+
+    auto packet = send(local, {added});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::DEFINE);
+    EXPECT_EQ(packet.codes[0].index, old_ref.codes[0].index);
+    receive(_remote, packet);
+
+    // The old reference is stale, and never resolves to the new member.
+    auto received = receive(_remote, old_ref);
+    EXPECT_FALSE(received.fresh);
+    EXPECT_FALSE(received.rumors[0]);
+
+    receive(local, send(_remote));
+    packet = send(local, {added});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::REF);
+    received = receive(_remote, packet);
+    ASSERT_TRUE(received.rumors[0]);
+    test::expect_node_eq(*received.rumors[0], added);
+}
+
+TEST_F(RumorDictionaryTest, AddressChange) {
+    auto node = test::make_node(1);
+    receive(_remote, send(_local, {node}));
+    receive(_local, send(_remote));
+
+    auto moved = node;
+    moved.port = 9000;
+    auto packet = send(_local, {moved});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::DEFINE);
+
+    receive(_remote, packet);
+    receive(_local, send(_remote));
+
+    packet = send(_local, {moved});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::REF);
+    auto received = receive(_remote, packet);
+    ASSERT_TRUE(received.rumors[0]);
+    EXPECT_EQ(received.rumors[0]->port, 9000);
+}
+
+TEST_F(RumorDictionaryTest, PeerRestart) {
+    auto node = test::make_node(1);
+    receive(_remote, send(_local, {node}));
+    receive(_local, send(_remote));
+    ASSERT_EQ(send(_local, {node}).codes[0].kind, RumorKind::REF);
+
+    // The peer loses all entries learned from us.
+    RumorDictionary restarted(16, 300);
+    receive(_local, send(restarted));
+
+    auto packet = send(_local, {node});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::DEFINE);
+    auto received = receive(restarted, packet);
+    ASSERT_TRUE(received.rumors[0]);
+    test::expect_node_eq(*received.rumors[0], node);
+}
+
+TEST_F(RumorDictionaryTest, UnknownRefIsMiss) {
+    auto node = test::make_node(1);
+    receive(_remote, send(_local, {node}));
+    receive(_local, send(_remote));
+    auto packet = send(_local, {node});
+    ASSERT_EQ(packet.codes[0].kind, RumorKind::REF);
+
+    RumorDictionary other(16, 300);
+    auto received = receive(other, packet);
+    EXPECT_TRUE(received.fresh);
+    EXPECT_FALSE(received.rumors[0]);
+}
+
+TEST_F(RumorDictionaryTest, Capacity) {
+    RumorDictionary local(2, 100);
+    auto packet = send(local, {test::make_node(1), test::make_node(2), test::make_node(3)});
+    EXPECT_EQ(packet.codes[0].kind, RumorKind::DEFINE);
+    EXPECT_EQ(packet.codes[1].kind, RumorKind::DEFINE);
+    EXPECT_EQ(packet.codes[2].kind, RumorKind::FULL);
+    EXPECT_EQ(local.size(test::make_node(4)),
+            binary::rumor_size(test::make_node(4), {RumorKind::FULL, 0}));
+}
+
+TEST_F(RumorDictionaryTest, PeerWithLargerCapacity) {
+    RumorDictionary large(4, 300);
+    RumorDictionary small(2, 400);
+    std::vector<Node> nodes = {test::make_node(1), test::make_node(2), test::make_node(3)};
+    auto packet = send(large, nodes);
+    ASSERT_EQ(packet.codes[2].kind, RumorKind::DEFINE);
+    EXPECT_EQ(packet.codes[2].index, 2U);
+    EXPECT_FALSE(small.valid(packet.codes[2]));
+
+    auto node = nodes[2];
+    EXPECT_FALSE(small.decode(node, packet.codes[2]));
+
+    // Handled as stale, so that full rumors are kept, and nothing is acked.
+    auto received = receive(small, packet);
+    EXPECT_FALSE(received.fresh);
+    for (std::size_t idx = 0; idx != nodes.size(); ++idx) {
+        ASSERT_TRUE(received.rumors[idx]);
+        test::expect_node_eq(*received.rumors[idx], nodes[idx]);
+    }
+
+    receive(large, send(small));
+    packet = send(large, nodes);
+    for (const auto &code : packet.codes) {
+        EXPECT_EQ(code.kind, RumorKind::DEFINE);
+    }
+}
+
+}
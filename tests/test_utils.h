@@ -0,0 +1,134 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SW_GOSSIP_NET_TEST_UTILS_H
+#define SW_GOSSIP_NET_TEST_UTILS_H
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/utils.h>
+
+namespace sw::gossip::test {
+
+inline Node make_node(std::size_t idx,
+        uint64_t version = 0,
+        NodeStatus status = NodeStatus::ALIVE) {
+    Node node;
+    node.id.assign("node-" + std::to_string(idx));
+    node.ip.assign(idx % 2 == 0 ? "10.0.0." + std::to_string(idx % 256) : "fe80::" + std::to_string(idx));
+    node.port = static_cast<uint16_t>(7000 + idx);
+    node.version = version;
+    node.status = status;
+
+    return node;
+}
+
+inline void expect_node_eq(const Node &lhs, const Node &rhs) {
+    EXPECT_EQ(lhs.id.view(), rhs.id.view());
+    EXPECT_EQ(lhs.ip.str(), rhs.ip.str());
+    EXPECT_EQ(lhs.port, rhs.port);
+    EXPECT_EQ(lhs.version, rhs.version);
+    EXPECT_EQ(lhs.status, rhs.status);
+}
+
+// Poll until `pred` holds, since servers run in their own threads.
+// @return false, if it still doesn't hold after `timeout`.
+template <typename Pred>
+bool wait_until(Pred pred, std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    return true;
+}
+
+// A plain UDP socket bound to an ephemeral port of 127.0.0.1, which talks to servers under test.
+class UdpSocket {
+public:
+    UdpSocket() {
+        _fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        EXPECT_GE(_fd, 0);
+
+        sockaddr_in addr = _addr(0);
+        EXPECT_EQ(::bind(_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)), 0);
+
+        socklen_t len = sizeof(addr);
+        EXPECT_EQ(::getsockname(_fd, reinterpret_cast<sockaddr *>(&addr), &len), 0);
+        _port = ntohs(addr.sin_port);
+
+        timeval timeout = {1, 0};
+        ::setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    UdpSocket(const UdpSocket &) = delete;
+    UdpSocket& operator=(const UdpSocket &) = delete;
+
+    ~UdpSocket() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    uint16_t port() const {
+        return _port;
+    }
+
+    void send_to(uint16_t port, const std::string &data) {
+        auto addr = _addr(port);
+        auto len = ::sendto(_fd, data.data(), data.size(), 0,
+                reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+        EXPECT_EQ(len, static_cast<ssize_t>(data.size()));
+    }
+
+    // @return an empty string, if nothing is received in a second.
+    std::string recv() {
+        std::string buf(64 * 1024, '\0');
+        auto len = ::recv(_fd, buf.data(), buf.size(), 0);
+        buf.resize(len > 0 ? len : 0);
+
+        return buf;
+    }
+
+private:
+    static sockaddr_in _addr(uint16_t port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        return addr;
+    }
+
+    int _fd = -1;
+
+    uint16_t _port = 0;
+};
+
+}
+
+#endif // end SW_GOSSIP_NET_TEST_UTILS_H
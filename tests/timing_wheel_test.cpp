@@ -0,0 +1,138 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/errors.h>
+#include <sw/gossip-net/timing_wheel.h>
+
+namespace {
+
+using namespace sw::gossip;
+using std::chrono::milliseconds;
+
+TEST(TimingWheelTest, FireAfterTimeout) {
+    TimingWheel wheel(milliseconds(10), 0);
+    int fired = 0;
+    wheel.schedule(milliseconds(25), [&fired]() { ++fired; });
+    EXPECT_EQ(wheel.size(), 1U);
+
+    // Timeout is rounded up to 3 ticks.
+    wheel.advance(29);
+    EXPECT_EQ(fired, 0);
+
+    wheel.advance(30);
+    EXPECT_EQ(fired, 1);
+    EXPECT_EQ(wheel.size(), 0U);
+
+    wheel.advance(1000);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimingWheelTest, ZeroTimeoutFiresOnNextTick) {
+    TimingWheel wheel(milliseconds(10), 5);
+    int fired = 0;
+    wheel.schedule(milliseconds(0), [&fired]() { ++fired; });
+
+    wheel.advance(9);
+    EXPECT_EQ(fired, 0);
+
+    wheel.advance(10);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimingWheelTest, FireInOrderAcrossLevels) {
+    TimingWheel wheel(milliseconds(1), 0);
+    std::vector<int> order;
+    // Timeouts on level 0, 1, 2 and 3, and beyond the wheel.
+    const std::vector<int> timeouts = {50000, 3, 700, 20000000, 64, 4095, 300000};
+    for (auto timeout : timeouts) {
+        wheel.schedule(milliseconds(timeout), [&order, timeout]() {
+                    order.push_back(timeout);
+                });
+    }
+
+    std::vector<int> expected = timeouts;
+    std::sort(expected.begin(), expected.end());
+
+    for (auto timeout : expected) {
+        wheel.advance(timeout - 1);
+        EXPECT_TRUE(order.empty()) << "timer " << timeout << " fired early";
+
+        wheel.advance(timeout);
+        ASSERT_EQ(order.size(), 1U);
+        EXPECT_EQ(order.front(), timeout);
+        order.clear();
+    }
+
+    EXPECT_EQ(wheel.size(), 0U);
+}
+
+TEST(TimingWheelTest, Cancel) {
+    TimingWheel wheel(milliseconds(10), 0);
+    int fired = 0;
+    auto handle = wheel.schedule(milliseconds(100), [&fired]() { ++fired; });
+
+    EXPECT_TRUE(wheel.cancel(handle));
+    EXPECT_EQ(wheel.size(), 0U);
+    EXPECT_FALSE(wheel.cancel(handle));
+
+    wheel.advance(200);
+    EXPECT_EQ(fired, 0);
+
+    EXPECT_FALSE(wheel.cancel(TimerHandle{}));
+}
+
+TEST(TimingWheelTest, StaleHandleDoesNotCancelReusedSlot) {
+    TimingWheel wheel(milliseconds(10), 0);
+    int fired = 0;
+    auto stale = wheel.schedule(milliseconds(10), []() {});
+    wheel.advance(10);
+
+    // The new timer reuses the slot of the fired one.
+    auto handle = wheel.schedule(milliseconds(10), [&fired]() { ++fired; });
+    EXPECT_EQ(handle.index, stale.index);
+
+    EXPECT_FALSE(wheel.cancel(stale));
+    wheel.advance(20);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST(TimingWheelTest, CallbackSchedulesAndCancels) {
+    TimingWheel wheel(milliseconds(10), 0);
+    std::vector<int> fired;
+    TimerHandle victim;
+    wheel.schedule(milliseconds(10), [&]() {
+                fired.push_back(1);
+                EXPECT_TRUE(wheel.cancel(victim));
+                wheel.schedule(milliseconds(10), [&fired]() { fired.push_back(3); });
+            });
+    victim = wheel.schedule(milliseconds(20), [&fired]() { fired.push_back(2); });
+
+    wheel.advance(100);
+    EXPECT_EQ(fired, (std::vector<int>{1, 3}));
+    EXPECT_EQ(wheel.size(), 0U);
+}
+
+TEST(TimingWheelTest, InvalidArguments) {
+    EXPECT_THROW(TimingWheel(milliseconds(0), 0), Error);
+
+    TimingWheel wheel(milliseconds(10), 0);
+    EXPECT_THROW(wheel.schedule(milliseconds(10), nullptr), Error);
+}
+
+}
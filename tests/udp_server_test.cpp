@@ -0,0 +1,248 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/compression.h>
+#include <sw/gossip-net/udp_server.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+constexpr int PORT = 47100;
+
+UdpServerOptions options(std::size_t recv_batch_size = 0) {
+    UdpServerOptions opts;
+    opts.ip = "127.0.0.1";
+    opts.port = PORT;
+    opts.buffer_size = 64 * 1024;
+    opts.recv_batch_size = recv_batch_size;
+    opts.recv_buffer_num = 4;
+    opts.timer_tick = std::chrono::milliseconds(1);
+
+    return opts;
+}
+
+// A datagram dispatched to the binary handler.
+std::string binary_message(std::size_t idx) {
+    return std::string(1, static_cast<char>(binary::MAGIC)) + "message-" + std::to_string(idx);
+}
+
+// Run the server in a background thread, and stop it on destruction.
+class ServerThread {
+public:
+    explicit ServerThread(UdpServer &server) :
+        _server(server), _thread([&server]() { server.start(); }) {}
+
+    ~ServerThread() {
+        _server.stop();
+        _thread.join();
+    }
+
+private:
+    UdpServer &_server;
+
+    std::thread _thread;
+};
+
+// Datagrams received by the binary handler, which runs in the event loop thread.
+class Received {
+public:
+    explicit Received(UdpServer &server) {
+        server.register_binary_handler([this](const std::string_view &data) {
+                    std::lock_guard<std::mutex> lock(_mtx);
+                    _messages.emplace_back(data);
+                });
+    }
+
+    std::vector<std::string> wait(std::size_t num) {
+        EXPECT_TRUE(test::wait_until([this, num]() {
+                        std::lock_guard<std::mutex> lock(_mtx);
+                        return _messages.size() >= num;
+                    }));
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _messages;
+    }
+
+private:
+    std::mutex _mtx;
+
+    std::vector<std::string> _messages;
+};
+
+class UdpServerRecvTest : public ::testing::TestWithParam<std::size_t> {};
+
+TEST_P(UdpServerRecvTest, ReceiveBinary) {
+    UdpServer server(options(GetParam()));
+    Received received(server);
+    ServerThread thread(server);
+
+    constexpr std::size_t NUM = 200;
+    test::UdpSocket client;
+    std::vector<std::string> sent;
+    for (std::size_t idx = 0; idx != NUM; ++idx) {
+        sent.push_back(binary_message(idx));
+        client.send_to(PORT, sent.back());
+    }
+
+    auto messages = received.wait(NUM);
+    std::sort(messages.begin(), messages.end());
+    std::sort(sent.begin(), sent.end());
+    EXPECT_EQ(messages, sent);
+}
+
+INSTANTIATE_TEST_SUITE_P(RecvBatchSize, UdpServerRecvTest, ::testing::Values(0, 8));
+
+TEST(UdpServerTest, ReceiveCompressed) {
+    UdpServer server(options());
+    Received received(server);
+    ServerThread thread(server);
+
+    auto message = binary_message(0) + std::string(4096, 'x');
+    std::string compressed(lz::max_compressed_size(message.size()), '\0');
+    compressed.resize(lz::compress(message, compressed.data(), compressed.size()));
+    ASSERT_FALSE(compressed.empty());
+
+    test::UdpSocket client;
+    client.send_to(PORT, compressed);
+
+    auto messages = received.wait(1);
+    ASSERT_EQ(messages.size(), 1U);
+    EXPECT_EQ(messages[0], message);
+}
+
+TEST(UdpServerTest, Send) {
+    UdpServer server(options());
+    ServerThread thread(server);
+
+    test::UdpSocket client;
+    server.post([&server, port = client.port()]() {
+                auto peer = server.add_peer(NodeId("client"), IpAddress("127.0.0.1"), port);
+                server.send(peer, "from heap");
+
+                auto buf = server.acquire_send_buffer();
+                buf.size = std::strlen("from pool");
+                std::memcpy(buf.data, "from pool", buf.size);
+                server.send(peer, buf);
+            });
+
+    // Pooled buffers are sent at the end of the loop iteration, and might go first.
+    std::vector<std::string> replies = {client.recv(), client.recv()};
+    std::sort(replies.begin(), replies.end());
+    EXPECT_EQ(replies, (std::vector<std::string>{"from heap", "from pool"}));
+}
+
+TEST(UdpServerTest, SendToRemovedPeer) {
+    UdpServer server(options());
+    ServerThread thread(server);
+
+    test::UdpSocket client;
+    server.post([&server, port = client.port()]() {
+                auto peer = server.add_peer(NodeId("client"), IpAddress("127.0.0.1"), port);
+                server.remove_peer(NodeId("client"));
+                server.send(peer, "dropped");
+            });
+
+    EXPECT_TRUE(test::wait_until([&server]() { return server.stats().send_errors == 1; }));
+}
+
+TEST(UdpServerTest, PostRunsInOrderInLoopThread) {
+    UdpServerOptions opts = options();
+    // Small enough that posting blocks until the loop catches up.
+    opts.task_queue_size = 16;
+    UdpServer server(opts);
+    ServerThread thread(server);
+
+    constexpr std::size_t NUM = 1000;
+    std::vector<std::size_t> order;
+    std::atomic<bool> in_loop{true};
+    std::atomic<std::size_t> done{0};
+    for (std::size_t idx = 0; idx != NUM; ++idx) {
+        server.post([&, idx]() {
+                    if (!server.in_loop_thread()) {
+                        in_loop = false;
+                    }
+                    order.push_back(idx);
+                    done.fetch_add(1);
+                });
+    }
+
+    ASSERT_TRUE(test::wait_until([&done]() { return done.load() == NUM; }));
+    EXPECT_TRUE(in_loop.load());
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+    EXPECT_EQ(order.size(), NUM);
+}
+
+TEST(UdpServerTest, DeferRunsInNextIteration) {
+    UdpServer server(options());
+    ServerThread thread(server);
+
+    std::vector<int> order;
+    std::atomic<bool> done{false};
+    server.post([&]() {
+                server.defer([&]() {
+                            order.push_back(2);
+                            server.defer([&]() {
+                                        order.push_back(3);
+                                        done = true;
+                                    });
+                        });
+                order.push_back(1);
+            });
+
+    ASSERT_TRUE(test::wait_until([&done]() { return done.load(); }));
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(UdpServerTest, Timers) {
+    UdpServer server(options());
+    ServerThread thread(server);
+
+    std::atomic<bool> fired{false};
+    std::atomic<bool> canceled_fired{false};
+    server.post([&]() {
+                auto canceled = server.register_timer(std::chrono::milliseconds(10), [&]() {
+                            canceled_fired = true;
+                        });
+                server.register_timer(std::chrono::milliseconds(20), [&]() {
+                            fired = true;
+                        });
+                EXPECT_TRUE(server.cancel_timer(canceled));
+            });
+
+    ASSERT_TRUE(test::wait_until([&fired]() { return fired.load(); }));
+    EXPECT_FALSE(canceled_fired.load());
+}
+
+TEST(UdpServerTest, Stop) {
+    UdpServer server(options());
+
+    // Stopping before start, the loop exits once it starts.
+    server.stop();
+    server.start();
+}
+
+}
@@ -0,0 +1,100 @@
+/**************************************************************************
+   Copyright (c) 2021 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <sw/gossip-net/binary_codec.h>
+#include <sw/gossip-net/errors.h>
+#include <sw/gossip-net/utils.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace sw::gossip;
+
+TEST(NodeIdTest, Assign) {
+    NodeId empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.size(), 0U);
+
+    std::string uuid(NodeId::MAX_SIZE, 'a');
+    NodeId id(uuid);
+    EXPECT_EQ(id.view(), uuid);
+    EXPECT_EQ(id.size(), uuid.size());
+    EXPECT_EQ(id.str(), uuid);
+
+    // Reassign a short one.
+    id.assign("short");
+    EXPECT_EQ(id.view(), "short");
+
+    EXPECT_THROW(NodeId(std::string(NodeId::MAX_SIZE + 1, 'b')), Error);
+    EXPECT_THROW(id.assign(std::string(1000, 'b')), Error);
+    EXPECT_EQ(id.view(), "short");
+}
+
+TEST(IpAddressTest, Bytes) {
+    IpAddress v4("10.0.0.1");
+    ASSERT_EQ(v4.size(), 4U);
+    const uint8_t v4_bytes[] = {10, 0, 0, 1};
+    EXPECT_EQ(std::memcmp(v4.bytes(), v4_bytes, sizeof(v4_bytes)), 0);
+
+    IpAddress v6("fe80::1");
+    ASSERT_EQ(v6.size(), IpAddress::SIZE);
+    EXPECT_EQ(v6.bytes(), v6.data());
+
+    IpAddress ip;
+    ip.assign(v4.bytes(), v4.size());
+    EXPECT_EQ(ip, v4);
+    EXPECT_EQ(ip.str(), "10.0.0.1");
+
+    ip.assign(v6.bytes(), v6.size());
+    EXPECT_EQ(ip, v6);
+    EXPECT_EQ(ip.str(), "fe80::1");
+
+    EXPECT_THROW(ip.assign(v6.bytes(), 5), Error);
+    EXPECT_EQ(ip, v6);
+}
+
+TEST(NodeIdTest, LongIdInMessages) {
+    auto self = test::make_node(0);
+    self.id.assign(std::string(NodeId::MAX_SIZE, 's'));
+
+    BinaryEncoder encoder;
+    encoder.append_header(MessageType::PING).append_node(self);
+    encoder.append_varint(0);
+    std::string msg(encoder.data());
+    EXPECT_NO_THROW(binary::decode(msg));
+
+    // Make the id one byte longer. It follows the 3-byte header, with a 1-byte length.
+    ASSERT_EQ(static_cast<uint8_t>(msg[3]), NodeId::MAX_SIZE);
+    msg[3] = static_cast<char>(NodeId::MAX_SIZE + 1);
+    msg.insert(4, 1, 's');
+    EXPECT_THROW(binary::decode(msg), Error);
+
+    auto rumor = test::make_node(1, 3, NodeStatus::SUSPECTED);
+    std::vector<std::string> args = {"rumor", std::string(NodeId::MAX_SIZE + 1, 'r'),
+        rumor.ip.str(), std::to_string(rumor.port), std::to_string(rumor.version), "SUSPECTED"};
+    EXPECT_THROW(utils::parse_rumors(args.begin(), args.end()), Error);
+
+    args[1].pop_back();
+    auto rumors = utils::parse_rumors(args.begin(), args.end());
+    ASSERT_EQ(rumors.size(), 1U);
+    EXPECT_EQ(rumors[0].id.view(), args[1]);
+}
+
+}